@@ -32,6 +32,7 @@
  * \date   2/19/23
  */
 
+#include <cmath>
 #include <cstdlib>
 #include "INSATxGCSAction.hpp"
 
@@ -113,11 +114,62 @@ namespace ps
     opt_ = opt;
   }
 
-  TrajType INSATxGCSAction::optimize(const std::vector<StateVarsType> &ancestors,
-                    const StateVarsType& successor,
-                    int thread_id)
+  void INSATxGCSAction::SetCancellationToken(const CancellationToken* token)
+  {
+    /// The optimizers are shared by all actions of a planner, so the last token set wins
+    for (auto& opt : *opt_)
+    {
+      opt.SetCancellationToken(token);
+    }
+  }
+
+  thread_local bool INSATxGCSAction::in_solver_job_ = false;
+
+  void INSATxGCSAction::setSolverPool(std::shared_ptr<WorkStealingPool> pool, int first_thread_id)
+  {
+    /// The planner keeps optimizer 0 for itself
+    if (pool && (first_thread_id < 1 || first_thread_id + pool->NumWorkers() > static_cast<int>(opt_->size())))
+    {
+      throw std::runtime_error("Solver pool needs optimizers " + std::to_string(first_thread_id) + " to " +
+                               std::to_string(first_thread_id + pool->NumWorkers() - 1) + " of its own, there are " +
+                               std::to_string(opt_->size()) + "!!");
+    }
+    solver_pool_ = pool;
+    solver_first_id_ = first_thread_id;
+  }
+
+  void INSATxGCSAction::submitSolve(SolveJobType job)
   {
-    const auto& vivm = (*opt_)[thread_id].GetVertexIdToVertexMap();
+    if (solver_pool_)
+    {
+      const int first_id = solver_first_id_;
+      solver_pool_->Submit([job, first_id](int worker_id)
+      {
+        in_solver_job_ = true;
+        job(first_id + worker_id);
+        in_solver_job_ = false;
+      });
+    }
+    else
+    {
+      job(0);
+    }
+  }
+
+  INSATxGCSAction::OptType& INSATxGCSAction::optimizer(int thread_id)
+  {
+    if (solver_pool_ && (thread_id >= solver_first_id_) && !in_solver_job_)
+    {
+      throw std::runtime_error("Optimizer " + std::to_string(thread_id) + " belongs to the solver pool!!");
+    }
+    return (*opt_)[thread_id];
+  }
+
+  std::vector<VertexId> INSATxGCSAction::getPathVertexIds(const std::vector<StateVarsType> &ancestors,
+                                                          const StateVarsType& successor,
+                                                          int thread_id)
+  {
+    const auto& vivm = optimizer(thread_id).GetVertexIdToVertexMap();
     std::vector<VertexId> solve_vids;
     for (auto vid : ancestors) {
       auto it = vivm.find(static_cast<int>(vid[0]));
@@ -131,13 +183,33 @@ namespace ps
       throw std::runtime_error("State with VId:" + std::to_string(static_cast<int>(successor[0])) + " not found in GCS graph!!");
     }
     solve_vids.push_back(it->second->id());
+    return solve_vids;
+  }
 
-    auto soln = (*opt_)[thread_id].Solve(solve_vids);
+  TrajType INSATxGCSAction::optimize(const std::vector<StateVarsType> &ancestors,
+                    const StateVarsType& successor,
+                    int thread_id)
+  {
+    auto solve_vids = getPathVertexIds(ancestors, successor, thread_id);
+    auto soln = optimizer(thread_id).Solve(solve_vids);
+    return TrajType (soln.first, soln.second);
+  }
+
+  TrajType INSATxGCSAction::optimize(const TrajType& incoming_traj,
+                                     const std::vector<StateVarsType> &ancestors,
+                                     const StateVarsType& successor,
+                                     int thread_id)
+  {
+    if (!incoming_traj.isValid()) {
+      return optimize(ancestors, successor, thread_id);
+    }
+    auto solve_vids = getPathVertexIds(ancestors, successor, thread_id);
+    auto soln = optimizer(thread_id).WarmSolve(solve_vids, incoming_traj.traj_);
     return TrajType (soln.first, soln.second);
   }
 
   TrajType INSATxGCSAction::optimize(const std::vector<int> &gcs_nodes, int thread_id) {
-    const auto& vivm = (*opt_)[thread_id].GetVertexIdToVertexMap();
+    const auto& vivm = optimizer(thread_id).GetVertexIdToVertexMap();
     std::vector<VertexId> solve_vids;
     for (auto vid : gcs_nodes) {
       auto it = vivm.find(vid);
@@ -147,53 +219,32 @@ namespace ps
       solve_vids.push_back(it->second->id());
     }
 
-    auto soln = (*opt_)[thread_id].Solve(solve_vids);
+    auto soln = optimizer(thread_id).Solve(solve_vids);
     return TrajType (soln.first, soln.second);
   }
 
   double INSATxGCSAction::lowerboundCost(const std::vector<int> &gcs_nodes, int thread_id) {
-    return (*opt_)[thread_id].LowerboundSolve(gcs_nodes);
+    return optimizer(thread_id).LowerboundSolve(gcs_nodes);
 //    return lb_opt_.LowerboundSolve(gcs_nodes);
   }
 
   double INSATxGCSAction::getCost(const TrajType &traj, int thread_id) const
   {
-//    return traj.result_.get_optimal_cost();
-
-
-    if (traj.size() == 0) {
-      auto disc_traj = sampleTrajectory(traj.traj_, 1e-1);
-      return calculateCost(disc_traj)*path_length_weight_ +
-             traj.traj_.end_time()*time_weight_;
-    } else {
-      return calculateCost(traj.disc_traj_)*path_length_weight_ +
-              traj.traj_.end_time()*time_weight_;
-    }
-    return calculateCost(traj.disc_traj_)*path_length_weight_ +
+    /// The sampled disc_traj_ cuts corners, so the length always comes from the curve
+    return GCSOpt::PathLength(traj.traj_)*path_length_weight_ +
            traj.traj_.end_time()*time_weight_;
   }
 
   MatDf INSATxGCSAction::sampleTrajectory(const GCSTraj::TrajInstanceType &traj, double dt) const {
-    MatDf sampled_traj;
-    int i=0;
-    for (double t=0.0; t<=traj.end_time(); t+=dt)
+    const int num_samples = (traj.end_time() >= 0)? static_cast<int>(std::floor(traj.end_time()/dt + 1e-9)) + 1 : 0;
+    MatDf sampled_traj(traj.rows(), num_samples);
+    for (int i=0; i<num_samples; ++i)
     {
-      sampled_traj.conservativeResize(traj.rows(), sampled_traj.cols()+1);
-      sampled_traj.col(i) = traj.value(t);
-      ++i;
+      sampled_traj.col(i) = traj.value(i*dt);
     }
     return sampled_traj;
   }
 
-  double INSATxGCSAction::calculateCost(const MatDf &disc_traj) const {
-    double cost = 0;
-    for (int i=0; i<disc_traj.cols()-1; ++i)
-    {
-      cost += (disc_traj.col(i+1)-disc_traj.col(i)).norm();
-    }
-    return cost;
-  }
-
   std::unordered_map<int, std::vector<int>> INSATxGCSAction::getAdjacencyList() {return adjacency_list_;}
 
 }
@@ -39,6 +39,7 @@
 #include <random>
 #include <common/Types.hpp>
 #include <common/insat/InsatAction.hpp>
+#include <common/WorkStealingPool.hpp>
 #include <common/robots/Abb.hpp>
 #include "planners/insat/opt/GCSOpt.hpp"
 
@@ -76,6 +77,11 @@ namespace ps
 
     /// INSAT
     void setOpt(OptVecPtrType& opt);
+    void SetCancellationToken(const CancellationToken* token) override;
+    /// Pool running optimizeAsync solves, usually shared by all actions. Its worker i solves with
+    /// optimizer first_thread_id+i, which the planner threads may then no longer use.
+    void setSolverPool(std::shared_ptr<WorkStealingPool> pool, int first_thread_id=1);
+    void submitSolve(SolveJobType job) override;
     bool isFeasible(MatDf& traj, int thread_id) const override {}
     TrajType optimize(const StateVarsType& s1, const StateVarsType& s2, int thread_id) const override {}
     TrajType warmOptimize(const TrajType& t1, const TrajType& t2, int thread_id) const override {}
@@ -87,7 +93,7 @@ namespace ps
     TrajType optimize(const TrajType& incoming_traj,
                       const std::vector<StateVarsType> &ancestors,
                       const StateVarsType& successor,
-                      int thread_id) override {}
+                      int thread_id) override;
     TrajType optimize(const std::vector<StateVarsType> &ancestors,
                               const StateVarsType& successor,
                               int thread_id=0);
@@ -97,9 +103,15 @@ namespace ps
     std::unordered_map<int, std::vector<int>> getAdjacencyList();
 
     MatDf sampleTrajectory(const GCSTraj::TrajInstanceType &traj, double dt) const;
-    double calculateCost(const MatDf &disc_traj) const;
 
   protected:
+    std::vector<VertexId> getPathVertexIds(const std::vector<StateVarsType> &ancestors,
+                                           const StateVarsType& successor,
+                                           int thread_id);
+
+    /// Optimizer of thread_id, checking it is not one of the solver pool's
+    OptType& optimizer(int thread_id);
+
     LockType lock_;
 
     VecDf goal_;
@@ -109,6 +121,10 @@ namespace ps
     /// Optimizer stuff
     OptVecPtrType opt_;
     OptType lb_opt_;
+    std::shared_ptr<WorkStealingPool> solver_pool_;
+    int solver_first_id_ = 1;
+    /// Set on the thread running a job of the solver pool
+    static thread_local bool in_solver_job_;
     std::unordered_map<int, std::vector<int>> adjacency_list_;
     std::vector<GCSVertex*> gcs_vertices_;
 
@@ -35,6 +35,7 @@
 #include <iostream>
 #include <memory>
 #include <cstdlib>
+#include <thread>
 
 #include <common/insatxgcs/utils.hpp>
 #include <planners/insat/opt/LBGraph.hpp>
@@ -66,13 +67,14 @@ int main() {
   double hdot_min = 1e-6;
   bool smooth = false;
   bool verbose = false;
+  int num_threads = std::max(1u, std::thread::hardware_concurrency());
 
   LBGraph lbg(env_name, regions, *edges_bw_regions,
               order, continuity,
               path_len_weight, time_weight,
               vel_lb, vel_ub,
               h_min, h_max, hdot_min,
-              smooth, lbg_dir);
+              smooth, lbg_dir, verbose, num_threads);
 
   lbg.PrintLBGraphStats();
   auto graph = lbg.GetLBAdjacencyList();
@@ -44,7 +44,9 @@
 #include <planners/insat/pINSATxGCS.hpp>
 #include "INSATxGCSAction.hpp"
 #include <planners/insat/opt/GCSOpt.hpp>
+#include <planners/insat/opt/LBGraph.hpp>
 #include <common/insatxgcs/utils.hpp>
+#include <common/QueryScheduler.hpp>
 
 using namespace std;
 using namespace ps;
@@ -77,9 +79,16 @@ enum class PPMode
 
 namespace rm
 {
-  vector<double> goal;
-  Eigen::VectorXd goal_value;
-  std::unordered_map<int64_t, GCSVertex*> viv;
+  /// Goal and heuristic of the query a planner works on. Batch mode keeps one per worker.
+  struct Query
+  {
+    vector<double> goal;
+    Eigen::VectorXd goal_value;
+    /// Optimizer of the query, for the precomputed vertex geometry
+    const GCSOpt* opt = nullptr;
+    /// Set when an LB graph of the environment is available
+    std::shared_ptr<LBGHeuristic> lbg_h;
+  };
 
   int dof;
 
@@ -95,9 +104,9 @@ double roundOff(double value, unsigned char prec)
   return round(value * pow_10) / pow_10;
 }
 
-bool isGoalState(const StateVarsType& state_vars, double dist_thresh)
+bool isGoalState(const StateVarsType& state_vars, double dist_thresh, const rm::Query* query)
 {
-  return rm::goal[0] == state_vars[0];
+  return query->goal[0] == state_vars[0];
 }
 
 size_t StateKeyGenerator(const StateVarsType& state_vars)
@@ -127,13 +136,21 @@ double computeHeuristicStateToState(const StateVarsType& state_vars_1, const Sta
   return std::sqrt(dist);
 }
 
-double computeHeuristicStateToVec(const StateVarsType& state_vars_1, const Eigen::VectorXd& state_vars_2)
+/// Batched computeHeuristicStateToState for the independence check of pINSATxGCS
+void computeHeuristicStatesToState(const vector<StateVarsType>& states_vars, const StateVarsType& state_vars, vector<double>& h_vals)
 {
-  double dist = 0.0;
-  auto vtx = rm::viv[static_cast<int>(state_vars_1[0])];
-  auto vtx_pt = vtx->set().MaybeGetFeasiblePoint();
-  auto poi = vtx_pt.value().head(rm::dof);
-  return (state_vars_2-poi).norm();
+  Eigen::ArrayXd ids(states_vars.size());
+  for (int i=0; i<states_vars.size(); ++i)
+  {
+    ids(i) = states_vars[i][0];
+  }
+  h_vals.resize(states_vars.size());
+  Eigen::Map<Eigen::ArrayXd>(h_vals.data(), h_vals.size()) = (ids - state_vars[0]).abs();
+}
+
+double computeHeuristicStateToVec(const StateVarsType& state_vars_1, const Eigen::VectorXd& state_vars_2, const GCSOpt* opt)
+{
+  return opt->RepresentativeDistance(static_cast<int64_t>(state_vars_1[0]), state_vars_2);
 }
 
 double zeroHeuristic(const StateVarsType& state_vars)
@@ -141,9 +158,35 @@ double zeroHeuristic(const StateVarsType& state_vars)
   return 0.0;
 }
 
-double computeHeuristic(const StateVarsType& state_vars)
+double computeHeuristic(const StateVarsType& state_vars, const rm::Query* query)
+{
+  if (query->lbg_h) {
+    double h = (*query->lbg_h)(static_cast<int64_t>(state_vars[0]));
+    if (h < DINF) {
+      return h;
+    }
+  }
+  return computeHeuristicStateToVec(state_vars, query->goal_value, query->opt);
+}
+
+/// Points query at the goal vertex added to opt and runs its backward LB graph search.
+/// Regions are the first vertices of the optimizer.
+void setQueryGoal(rm::Query& query, const std::vector<HPolyhedron>& regions,
+                  const GCSOpt& opt, VertexId goal_vid, const Eigen::VectorXd& goal_vec)
 {
-  return computeHeuristicStateToVec(state_vars, rm::goal_value);
+  query.opt = &opt;
+  query.goal.assign(1, goal_vid.get_value()-1);
+  query.goal_value = goal_vec;
+
+  if (query.lbg_h)
+  {
+    int goal_region = 0;
+    while (goal_region < regions.size() && !regions[goal_region].PointInSet(goal_vec)) {
+      ++goal_region;
+    }
+    StateVarsType goal_state(goal_vec.data(), goal_vec.data()+goal_vec.size());
+    query.lbg_h->SetGoal(goal_state, goal_region, opt.GetRegionIdOffset());
+  }
 }
 
 void constructActions(vector<shared_ptr<Action>>& action_ptrs,
@@ -170,7 +213,8 @@ void constructActions(vector<shared_ptr<Action>>& action_ptrs,
 
 void constructPlanner(string planner_name, shared_ptr<Planner>& planner_ptr,
                       vector<shared_ptr<Action>>& action_ptrs,
-                      ParamsType& planner_params)
+                      ParamsType& planner_params,
+                      const rm::Query* query)
 {
   if (planner_name == "insatxgcs")
     planner_ptr = std::make_shared<INSATxGCS>(planner_params);
@@ -180,16 +224,17 @@ void constructPlanner(string planner_name, shared_ptr<Planner>& planner_ptr,
     throw runtime_error("Planner type not identified!");
 
   /// Heuristic
-  planner_ptr->SetHeuristicGenerator(bind(computeHeuristic, placeholders::_1));
+  planner_ptr->SetHeuristicGenerator(bind(computeHeuristic, placeholders::_1, query));
   planner_ptr->SetActions(action_ptrs);
   planner_ptr->SetStateMapKeyGenerator(bind(StateKeyGenerator, placeholders::_1));
   planner_ptr->SetEdgeKeyGenerator(bind(EdgeKeyGenerator, placeholders::_1));
   planner_ptr->SetStateToStateHeuristicGenerator(bind(computeHeuristicStateToState, placeholders::_1, placeholders::_2));
+  planner_ptr->SetStatesToStateHeuristicGenerator(bind(computeHeuristicStatesToState, placeholders::_1, placeholders::_2, placeholders::_3));
 
   /// Goal checker
   if (rm::goal_mode == GoalCheckerMode::CSPACE)
   {
-    planner_ptr->SetGoalChecker(bind(isGoalState, placeholders::_1, TERMINATION_DIST));
+    planner_ptr->SetGoalChecker(bind(isGoalState, placeholders::_1, TERMINATION_DIST, query));
   }
 }
 
@@ -233,30 +278,175 @@ void loadStartsAndGoalsFromFile(vector<vector<double>>& starts,
 
 MatDf sampleTrajectory(const drake::trajectories::CompositeTrajectory<double>& traj, double dt=1e-1)
 {
-  MatDf sampled_traj;
-  int i=0;
-  for (double t=0.0; t<=traj.end_time(); t+=dt)
+  const int num_samples = (traj.end_time() >= 0)? static_cast<int>(std::floor(traj.end_time()/dt + 1e-9)) + 1 : 0;
+  MatDf sampled_traj(rm::dof, num_samples);
+  for (int i=0; i<num_samples; ++i)
   {
-    sampled_traj.conservativeResize(rm::dof, sampled_traj.cols() + 1);
-    sampled_traj.col(i) = traj.value(t);
-    ++i;
+    sampled_traj.col(i) = traj.value(i*dt);
   }
   return sampled_traj;
 }
 
 
+/// Plans every start/goal pair with query level parallelism. Each worker runs a serial INSATxGCS
+/// planner on its own formulated optimizer. The regions and the LB graph are shared read only.
+void runBatch(int num_workers, ParamsType planner_params, ParamsType action_params,
+              const std::function<GCSOpt()>& make_opt, INSATxGCSAction::OptType& lb_opt,
+              const std::vector<HPolyhedron>& regions, const std::shared_ptr<LBGHeuristic>& lbg_h,
+              const vector<vector<double>>& starts, const vector<vector<double>>& goals,
+              ofstream& log_file)
+{
+  planner_params["num_threads"] = 1;
+  planner_params["parallel_successors"] = 0;
+  /// Warm solves use IPOPT, whose linear solver is not thread safe
+  if (num_workers > 1)
+  {
+    planner_params["warm_start"] = 0;
+  }
+
+  /// Optimizers share their graph with their copies, so every worker builds its own
+  struct Worker
+  {
+    INSATxGCSAction::OptVecPtrType opt;
+    std::vector<shared_ptr<Action>> action_ptrs;
+    std::vector<std::shared_ptr<INSATxGCSAction>> ixg_action_ptrs;
+    rm::Query query;
+    shared_ptr<Planner> planner_ptr;
+  };
+  std::vector<Worker> workers(num_workers);
+  for (auto& worker : workers)
+  {
+    worker.opt = std::make_shared<INSATxGCSAction::OptVecType>(1, make_opt());
+    if (lbg_h)
+    {
+      worker.query.lbg_h = std::make_shared<LBGHeuristic>(lbg_h->GetSearch());
+    }
+    constructActions(worker.action_ptrs, planner_params, action_params, worker.opt, lb_opt, 1);
+    for (auto& a : worker.action_ptrs)
+    {
+      worker.ixg_action_ptrs.emplace_back(std::dynamic_pointer_cast<INSATxGCSAction>(a));
+    }
+    /// Every worker's graph has its own vertex ids
+    planner_params["dense_state_offset"] = (*worker.opt)[0].GetRegionIdOffset();
+    planner_params["num_dense_states"] = regions.size();
+    constructPlanner("insatxgcs", worker.planner_ptr, worker.action_ptrs, planner_params, &worker.query);
+  }
+
+  struct QueryResult
+  {
+    PlannerStats planner_stats;
+    double exec_duration = -1;
+  };
+  std::vector<QueryResult> results(starts.size());
+
+  QueryScheduler scheduler(num_workers);
+  scheduler.Run(starts.size(), [&](int run, int worker_id)
+  {
+    auto& worker = workers[worker_id];
+    auto& opt = (*worker.opt)[0];
+
+    Eigen::VectorXd start_vec = Eigen::Map<const Eigen::VectorXd, Eigen::Unaligned>(starts[run].data(), starts[run].size());
+    Eigen::VectorXd goal_vec = Eigen::Map<const Eigen::VectorXd, Eigen::Unaligned>(goals[run].data(), goals[run].size());
+    VertexId start_vid = opt.AddStart(start_vec);
+    VertexId goal_vid = opt.AddGoal(goal_vec);
+    setQueryGoal(worker.query, regions, opt, goal_vid, goal_vec);
+    for (auto& ixg_act : worker.ixg_action_ptrs) {
+      ixg_act->UpdateStateToSuccs();
+    }
+
+    StateVarsType start(1, start_vid.get_value()-1);
+    worker.planner_ptr->SetStartState(start);
+    bool plan_found = worker.planner_ptr->Plan();
+
+    results[run].planner_stats = worker.planner_ptr->GetStats();
+    if (plan_found)
+    {
+      auto ixg_planner = std::dynamic_pointer_cast<INSATxGCS>(worker.planner_ptr);
+      results[run].exec_duration = ixg_planner->getSolutionTraj().traj_.end_time();
+    }
+
+    opt.CleanUp();
+    return plan_found;
+  });
+
+  const auto& query_stats = scheduler.GetQueryStats();
+  vector<double> time_vec, cost_vec;
+  for (int run = 0; run < results.size(); ++run)
+  {
+    const auto& planner_stats = results[run].planner_stats;
+    cout << "Query: " << run
+         << " | Worker: " << query_stats[run].worker_id_
+         << " | Success: " << query_stats[run].success_
+         << " | Time (s): " << planner_stats.total_time_
+         << " | Wall time (s): " << query_stats[run].time_
+         << " | Cost: " << planner_stats.path_cost_
+         << " | State expansions: " << planner_stats.num_state_expansions_
+         << " | Num eval edges: " << planner_stats.num_evaluated_edges_ << endl;
+
+    if (query_stats[run].success_)
+    {
+      time_vec.emplace_back(planner_stats.total_time_);
+      cost_vec.emplace_back(planner_stats.path_cost_);
+    }
+
+    log_file << run << " "
+             << planner_stats.total_time_ << " "
+             << planner_stats.path_cost_<< " "
+             << planner_stats.path_length_<< " "
+             << "-1 "   // num_regions_on_path
+             << planner_stats.num_state_expansions_<< " "
+             << planner_stats.num_evaluated_edges_<< " "
+             << planner_stats.num_threads_spawned_<< " "
+             << results[run].exec_duration<< " "   // aka trajectory duration
+             << "-1 "   // opt_prob_size
+             << "-1 "   // opt_num_costs
+             << "-1 "   // opt_num_constraints
+             << endl;
+  }
+
+  double busy_time = 0;
+  for (auto& stats : query_stats)
+  {
+    busy_time += stats.time_;
+  }
+
+  cout << endl << "************************" << endl;
+  cout << "Number of queries: " << results.size() << " | Workers: " << num_workers << endl;
+  cout << "Success rate: " << scheduler.NumSuccessful() << "/" << results.size() << endl;
+  cout << "Batch time (s): " << scheduler.GetTotalTime() << endl;
+  cout << "Throughput (queries/s): " << scheduler.GetThroughput() << endl;
+  cout << "Mean worker utilization: " << busy_time/(num_workers*scheduler.GetTotalTime()) << endl;
+  if (!time_vec.empty())
+  {
+    cout << "Mean time: " << accumulate(time_vec.begin(), time_vec.end(), 0.0)/time_vec.size() << endl;
+    cout << "Mean cost: " << accumulate(cost_vec.begin(), cost_vec.end(), 0.0)/cost_vec.size() << endl;
+  }
+}
+
 int main(int argc, char* argv[])
 {
-  setenv("MOSEKLM_LICENSE_FILE", "/home/gaussian/Documents/softwares/mosektoolslinux64x86/mosek.lic", true);
-  auto lic = drake::solvers::MosekSolver::AcquireLicense();
+  /// Default license location unless one is set. GCSOpt checks the license out only if MOSEK is used.
+  setenv("MOSEKLM_LICENSE_FILE", "/home/gaussian/Documents/softwares/mosektoolslinux64x86/mosek.lic", false);
 
   int num_threads;
 
-  if (!strcmp(argv[1], "insat") || !strcmp(argv[1], "insatxgcs") || !strcmp(argv[1], "wastar"))
+  if (!strcmp(argv[1], "insat") || !strcmp(argv[1], "wastar"))
   {
     if (argc != 2) throw runtime_error("Format: run_robot_nav_2d insat");
     num_threads = 1;
   }
+  else if (!strcmp(argv[1], "insatxgcs"))
+  {
+    /// Optional thread count optimizes the successors of each expansion in parallel
+    if (argc != 2 && argc != 3) throw runtime_error("Format: run_robot_nav_2d insatxgcs [num_threads]");
+    num_threads = (argc == 3)? atoi(argv[2]) : 1;
+  }
+  else if (!strcmp(argv[1], "batch"))
+  {
+    /// Queries are planned concurrently, one serial insatxgcs planner per worker
+    if (argc != 3) throw runtime_error("Format: run_robot_nav_2d batch [num_workers]");
+    num_threads = atoi(argv[2]);
+  }
   else if (!strcmp(argv[1], "pinsat") || !strcmp(argv[1], "pixg") || !strcmp(argv[1], "rrt") || !strcmp(argv[1], "rrtconnect") || !strcmp(argv[1], "epase") || !strcmp(argv[1], "gepase"))
   {
     if (argc != 3) throw runtime_error("Format: run_robot_nav_2d pinsat [num_threads]");
@@ -309,6 +499,19 @@ int main(int argc, char* argv[])
   planner_params["path_length_weight"] = path_len_weight;
   planner_params["time_weight"] = time_weight;
   planner_params["sampling_dt"] = 1e-2;
+  planner_params["warm_start"] = 0;
+  planner_params["gcs_solver"] = static_cast<int>(GCSSolverType::kMosek);
+  planner_params["lbg_heuristic"] = 1;
+  planner_params["parallel_successors"] = (planner_name == "insatxgcs") && (num_threads > 1);
+  // Relax successors as their solves complete instead of after the whole expansion
+  planner_params["pipelined_successors"] = 0;
+  if (planner_params["pipelined_successors"])
+  {
+    planner_params["parallel_successors"] = 0;
+  }
+  // The planner is reused for every query, so keep its worker threads between them
+  planner_params["persistent_pool"] = 1;
+  planner_params["pin_workers"] = 1;
 
   ofstream log_file;
   ofstream incom_edge_file;
@@ -385,6 +588,110 @@ int main(int argc, char* argv[])
 //    ixg_action_ptrs.emplace_back(ixg_action_ptr);
 //  }
 
+  /// Lower bound graph heuristic, built beforehand by lbg_test
+  std::string lbg_file = "../examples/insatxgcs/resources/" + env_name + "/lbg/" +
+                         LBGraph::FileName(env_name, order, continuity, path_len_weight, time_weight,
+                                           h_min, h_max);
+  rm::Query query;
+  if ((planner_params["lbg_heuristic"] == 1) && ifstream(lbg_file).good())
+  {
+    query.lbg_h = std::make_shared<LBGHeuristic>(lbg_file);
+  }
+  else
+  {
+    std::cout << "No lower bound graph at " << lbg_file << ". Using the Euclidean heuristic." << std::endl;
+  }
+
+  /// Set up optimizer. It is built and formulated once, queries only swap the start and goal.
+  /// The region geometry of the first one is shared by the rest.
+  std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry;
+  auto make_opt = [&]()
+  {
+    auto opt = GCSOpt(regions, *edges_bw_regions,
+                      order, h_min, h_max, path_len_weight, time_weight,
+                      vel_lb, vel_ub, verbose, region_geometry);
+    opt.SetSolverType(static_cast<GCSSolverType>(planner_params["gcs_solver"]));
+    opt.FormulateAndSetCostsAndConstraints();
+    region_geometry = opt.GetRegionGeometry();
+    return opt;
+  };
+  auto opt = make_opt();
+  /// Set up lower bound optimizer
+  auto lb_opt = GCSOpt(regions, *edges_bw_regions,
+                       (order==1)?order:order-1, h_min, h_max, 1, 0,
+                       vel_lb, vel_ub, 0, region_geometry);
+  lb_opt.SetSolverType(static_cast<GCSSolverType>(planner_params["gcs_solver"]));
+  lb_opt.FormulateAndSetCostsAndConstraints();
+
+  // Get GCS edges and calculate graph degree. Start and goal add up to two successors to a region.
+  const auto& gcs_edges = opt.GetGCS()->Edges();
+  std::unordered_map<int, std::vector<int>> state_id_to_succ_id_;
+  for (auto& e : gcs_edges) {
+    state_id_to_succ_id_[e->u().id().get_value()-1].push_back(e->v().id().get_value()-1);
+  }
+  int graph_degree = 0;
+  for (auto& sid : state_id_to_succ_id_) {
+    graph_degree = std::max(static_cast<int>(sid.second.size()), graph_degree);
+  }
+  std::cout << "Graph degree is: " << graph_degree << std::endl;
+
+  ParamsType action_params;
+  action_params["planner_type"] = planner_name=="insat" || planner_name=="pinsat"? 1: -1;
+  action_params["length"] = graph_degree+2;
+
+  if (planner_name == "batch")
+  {
+    runBatch(num_threads, planner_params, action_params, make_opt, lb_opt,
+             regions, query.lbg_h, starts, goals, log_file);
+    return 0;
+  }
+
+  /// Vectorize optimizer for multithreading
+  auto opt_vec_ptr = std::make_shared<INSATxGCSAction::OptVecType>(num_threads, opt);
+
+  /// Construct actions
+  std::vector<shared_ptr<Action>> action_ptrs;
+  constructActions(action_ptrs, planner_params, action_params,
+                   opt_vec_ptr, lb_opt, num_threads);
+
+  std::vector<std::shared_ptr<INSATxGCSAction>> ixg_action_ptrs;
+  for (auto& a : action_ptrs)
+  {
+    std::shared_ptr<INSATxGCSAction> ixg_action_ptr = std::dynamic_pointer_cast<INSATxGCSAction>(a);
+    ixg_action_ptrs.emplace_back(ixg_action_ptr);
+  }
+
+  /// Pipelined solves run on a pool shared by the actions. The search thread keeps copy 0.
+  if (planner_params["pipelined_successors"] && (num_threads > 1))
+  {
+    auto solver_pool = std::make_shared<WorkStealingPool>(num_threads-1);
+    solver_pool->SetWorkerInit([opt_vec_ptr](int worker_id)
+    {
+      auto& worker_opt = (*opt_vec_ptr)[worker_id+1];
+      worker_opt = GCSOpt(worker_opt);
+    });
+    for (auto& ixg_act : ixg_action_ptrs)
+    {
+      ixg_act->setSolverPool(solver_pool, 1);
+    }
+  }
+
+  /// Construct planner. Region states are indexed by vertex id.
+  planner_params["dense_state_offset"] = opt.GetRegionIdOffset();
+  planner_params["num_dense_states"] = regions.size();
+  shared_ptr<Planner> planner_ptr;
+  constructPlanner(planner_name, planner_ptr, action_ptrs, planner_params, &query);
+  /// Workers rebuild their optimizer copy on their own thread so it is allocated on their NUMA
+  /// node. Copy 0 also serves the heuristic on the search thread, so it stays where it is.
+  planner_ptr->SetThreadInitializer([opt_vec_ptr](int thread_id)
+  {
+    if (thread_id > 0)
+    {
+      auto& worker_opt = (*opt_vec_ptr)[thread_id];
+      worker_opt = GCSOpt(worker_opt);
+    }
+  });
+
   int num_success = 0;
   vector<vector<PlanElement>> plan_vec;
 
@@ -397,67 +704,24 @@ int main(int argc, char* argv[])
     Eigen::VectorXd start_vec = Eigen::Map<Eigen::VectorXd, Eigen::Unaligned>(starts[run].data(), starts[run].size());
     Eigen::VectorXd goal_vec = Eigen::Map<Eigen::VectorXd, Eigen::Unaligned>(goals[run].data(), goals[run].size());
 
-    /// Set up optimizer
-    auto opt = GCSOpt(regions, *edges_bw_regions,
-                      order, h_min, h_max, path_len_weight, time_weight,
-                      vel_lb, vel_ub, verbose);
-    // Add start and goals to optimizer
-    VertexId start_vid = opt.AddStart(start_vec);
-    VertexId goal_vid = opt.AddGoal(goal_vec);
-    opt.FormulateAndSetCostsAndConstraints();
-    /// Set up lower bound optimizer
-    auto lb_opt = GCSOpt(regions, *edges_bw_regions,
-                         (order==1)?order:order-1, h_min, h_max, 1, 0,
-                         vel_lb, vel_ub, 0);
-    // Add start and goals to optimizer
-    VertexId lb_start_vid = lb_opt.AddStart(start_vec);
-    VertexId lb_goal_vid = lb_opt.AddGoal(goal_vec);
-    lb_opt.FormulateAndSetCostsAndConstraints();
+    /// Add start and goal to the optimizer and share them with the per-thread copies
+    auto& main_opt = (*opt_vec_ptr)[0];
+    VertexId start_vid = main_opt.AddStart(start_vec);
+    VertexId goal_vid = main_opt.AddGoal(goal_vec);
+    for (int i=1; i<num_threads; ++i)
+    {
+      (*opt_vec_ptr)[i].AdoptTerminals(main_opt);
+    }
 
     StateVarsType start;
     start.push_back(start_vid.get_value()-1);
-    rm::goal.clear();
-    rm::goal.push_back(goal_vid.get_value()-1);
-    rm::goal_value = goal_vec;
-
-    // Get GCS edges and calculate graph degree
-    const auto& gcs_edges = opt.GetGCS()->Edges();
-    std::unordered_map<int, std::vector<int>> state_id_to_succ_id_;
-    for (auto& e : gcs_edges) {
-      state_id_to_succ_id_[e->u().id().get_value()-1].push_back(e->v().id().get_value()-1);
-    }
-    int graph_degree = 0;
-    for (auto& sid : state_id_to_succ_id_) {
-      graph_degree = std::max(static_cast<int>(sid.second.size()), graph_degree);
-    }
-    std::cout << "Graph degree is: " << graph_degree << std::endl;
-    /// Vectorize optimizer for multithreading
-    auto opt_vec_ptr = std::make_shared<INSATxGCSAction::OptVecType>(num_threads, opt);
-    rm::viv = (*opt_vec_ptr)[0].GetVertexIdToVertexMap();
-
-    /// Construct actions
-    ParamsType action_params;
-    action_params["planner_type"] = planner_name=="insat" || planner_name=="pinsat"? 1: -1;
-    action_params["length"] = graph_degree+1;
-    std::vector<shared_ptr<Action>> action_ptrs;
-    constructActions(action_ptrs, planner_params, action_params,
-                     opt_vec_ptr, lb_opt, num_threads);
-
-    std::vector<std::shared_ptr<INSATxGCSAction>> ixg_action_ptrs;
-    for (auto& a : action_ptrs)
-    {
-      std::shared_ptr<INSATxGCSAction> ixg_action_ptr = std::dynamic_pointer_cast<INSATxGCSAction>(a);
-      ixg_action_ptrs.emplace_back(ixg_action_ptr);
-    }
+    /// One backward LB graph search per query
+    setQueryGoal(query, regions, main_opt, goal_vid, goal_vec);
 
     for (auto& ixg_act : ixg_action_ptrs) {
       ixg_act->UpdateStateToSuccs();
     }
 
-    /// Construct planner
-    shared_ptr<Planner> planner_ptr;
-    constructPlanner(planner_name, planner_ptr, action_ptrs, planner_params);
-
     // Run experiments
     vector<double> time_vec, cost_vec;
     vector<int> num_edges_vec, threads_used_vec;
@@ -489,7 +753,7 @@ int main(int argc, char* argv[])
     planner_ptr->SetStartState(start);
     if ((planner_name == "rrt") || (planner_name == "rrtconnect"))
     {
-      planner_ptr->SetGoalState(rm::goal);
+      planner_ptr->SetGoalState(query.goal);
     }
 
 
@@ -509,6 +773,13 @@ int main(int argc, char* argv[])
          << " | Lock time: " <<  planner_stats.lock_time_
          << " | Expand time: " << planner_stats.cumulative_expansions_time_
          << " | Threads: " << planner_stats.num_threads_spawned_ << "/" << planner_params["num_threads"] << endl;
+    if (!planner_stats.worker_cpus_.empty())
+    {
+      cout << " | Worker cpu/node:";
+      for (int w = 0; w < planner_stats.worker_cpus_.size(); ++w)
+        cout << " " << planner_stats.worker_cpus_[w] << "/" << planner_stats.worker_numa_nodes_[w];
+      cout << endl;
+    }
 
     for (auto& [action, times] : planner_stats.action_eval_times_)
     {
@@ -636,6 +907,13 @@ int main(int argc, char* argv[])
              << "-1 "   // opt_num_costs
              << "-1 "   // opt_num_constraints
              << endl;
+
+    /// Drop this query's start and goal, keeping the formulated regions
+    for (int i=1; i<num_threads; ++i)
+    {
+      (*opt_vec_ptr)[i].ReleaseTerminals();
+    }
+    main_opt.CleanUp();
   }
 
   StateVarsType dummy_wp(6, -1);
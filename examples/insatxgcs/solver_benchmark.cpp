@@ -0,0 +1,165 @@
+/*!
+ * \file solver_benchmark.cpp
+ * \brief Per-solve latency of the GCSOpt conic solvers on random region chains
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+#include <common/insatxgcs/utils.hpp>
+#include <planners/insat/opt/GCSOpt.hpp>
+
+using namespace ps;
+using drake::geometry::optimization::HPolyhedron;
+
+/// Random walks of path_length regions that do not revisit a region
+std::vector<std::vector<int>> sampleRegionChains(const std::vector<std::pair<int, int>>& edges,
+                                                 int num_regions, int num_paths, int path_length,
+                                                 std::mt19937& rng) {
+  std::unordered_map<int, std::vector<int>> adjacency;
+  for (const auto& e : edges) {
+    adjacency[e.first].push_back(e.second);
+  }
+
+  std::vector<std::vector<int>> paths;
+  std::uniform_int_distribution<int> region_dist(0, num_regions-1);
+  int num_attempts = 0;
+  while (paths.size() < num_paths && num_attempts < 100*num_paths) {
+    ++num_attempts;
+    std::vector<int> path = {region_dist(rng)};
+    while (path.size() < path_length) {
+      std::vector<int> next;
+      for (int v : adjacency[path.back()]) {
+        if (std::find(path.begin(), path.end(), v) == path.end()) {
+          next.push_back(v);
+        }
+      }
+      if (next.empty()) {
+        break;
+      }
+      path.push_back(next[std::uniform_int_distribution<int>(0, next.size()-1)(rng)]);
+    }
+    if (path.size() == path_length) {
+      paths.push_back(path);
+    }
+  }
+  return paths;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || argc > 4) {
+    throw std::runtime_error("Format: solver_benchmark [maze2d|bimanual] [num_paths] [path_length]");
+  }
+  setenv("MOSEKLM_LICENSE_FILE", "/home/gaussian/Documents/softwares/mosektoolslinux64x86/mosek.lic", false);
+
+  std::string env_name = argv[1];
+  int num_paths = (argc > 2)? atoi(argv[2]) : 200;
+  int path_length = (argc > 3)? atoi(argv[3]) : 20;
+
+  std::string regions_file, edges_file;
+  int num_positions;
+  if (env_name == "maze2d") {
+    regions_file = "../examples/insatxgcs/resources/maze2d/maze.csv";
+    edges_file = "../examples/insatxgcs/resources/maze2d/maze_edges.csv";
+    num_positions = 2;
+  } else if (env_name == "bimanual") {
+    regions_file = "../examples/insatxgcs/resources/bimanual/regions.csv";
+    edges_file = "../examples/insatxgcs/resources/bimanual/edges.csv";
+    num_positions = 12;
+  } else {
+    throw std::runtime_error("Environment " + env_name + " not identified");
+  }
+
+  std::vector<HPolyhedron> regions = utils::DeserializeRegions(regions_file);
+  auto edges_bw_regions = utils::DeserializeEdges(edges_file);
+
+  /// Same optimizer setup as run_insatxgcs
+  int order = 1;
+  double h_min = 1e-3;
+  double h_max = 1;
+  double path_len_weight = 1;
+  double time_weight = 0;
+  Eigen::VectorXd vel_lb = -5 * Eigen::VectorXd::Ones(num_positions);
+  Eigen::VectorXd vel_ub = 5 * Eigen::VectorXd::Ones(num_positions);
+
+  std::mt19937 rng(0);
+  auto paths = sampleRegionChains(*edges_bw_regions, regions.size(), num_paths, path_length, rng);
+  std::cout << env_name << ": " << paths.size() << " chains of " << path_length << " regions" << std::endl;
+
+  /// Only the last row takes the polyline fast path that GCSOpt uses for this setup by default
+  const std::vector<std::tuple<GCSSolverType, std::string, bool>> solvers = {
+          {GCSSolverType::kMosek, "mosek", false},
+          {GCSSolverType::kClarabel, "clarabel", false},
+          {GCSSolverType::kScs, "scs", false},
+          {GCSSolverType::kChainSocp, "chain_socp", false},
+          {GCSSolverType::kChainSocp, "polyline", true}};
+
+  /// Costs of the first solver that ran, to compare the others against
+  std::vector<double> ref_costs;
+  std::cout << std::setw(10) << "solver" << std::setw(10) << "success"
+            << std::setw(12) << "mean (ms)" << std::setw(12) << "p50 (ms)" << std::setw(12) << "p95 (ms)"
+            << std::setw(16) << "max cost diff" << std::endl;
+  std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry;
+  for (const auto& [solver_type, solver_name, polyline] : solvers) {
+    GCSOpt opt(regions, *edges_bw_regions,
+               order, h_min, h_max, path_len_weight, time_weight,
+               vel_lb, vel_ub, false, region_geometry);
+    region_geometry = opt.GetRegionGeometry();
+    try {
+      opt.SetSolverType(solver_type);
+    } catch (const std::runtime_error& ex) {
+      std::cout << std::setw(10) << solver_name << "  skipped: " << ex.what() << std::endl;
+      continue;
+    }
+    opt.SetPolylineSolve(polyline);
+    opt.FormulateAndSetCostsAndConstraints();
+
+    std::vector<double> times, costs;
+    int num_success = 0;
+    for (auto path : paths) {
+      for (auto& id : path) {
+        id += opt.GetRegionIdOffset();
+      }
+      auto start_time = std::chrono::steady_clock::now();
+      auto soln = opt.Solve(path);
+      auto end_time = std::chrono::steady_clock::now();
+      times.push_back(1e-6*std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+      bool success = soln.second.is_success();
+      num_success += success;
+      costs.push_back(success? soln.second.get_optimal_cost() : std::numeric_limits<double>::quiet_NaN());
+    }
+
+    double max_cost_diff = 0;
+    if (ref_costs.empty()) {
+      ref_costs = costs;
+    } else {
+      for (int i=0; i<costs.size(); ++i) {
+        if (!std::isnan(costs[i]) && !std::isnan(ref_costs[i])) {
+          max_cost_diff = std::max(max_cost_diff, std::abs(costs[i]-ref_costs[i])/std::max(1.0, std::abs(ref_costs[i])));
+        }
+      }
+    }
+
+    double mean_time = times.empty()? 0 : std::accumulate(times.begin(), times.end(), 0.0)/times.size();
+    std::sort(times.begin(), times.end());
+    auto percentile = [&times](double p) {
+      return times.empty()? 0 : times[std::min(times.size()-1, static_cast<size_t>(p*times.size()))];
+    };
+    std::cout << std::setw(10) << solver_name
+              << std::setw(10) << static_cast<double>(num_success)/std::max<size_t>(1, paths.size())
+              << std::setw(12) << mean_time << std::setw(12) << percentile(0.5) << std::setw(12) << percentile(0.95)
+              << std::setw(16) << max_cost_diff << std::endl;
+  }
+
+  return 0;
+}
@@ -2,6 +2,7 @@
 #define ACTION_HPP
 
 #include <common/State.hpp>
+#include <common/CancellationToken.hpp>
 
 namespace ps
 {
@@ -25,6 +26,8 @@ public:
     virtual ActionSuccessor GetSuccessorLazy(const StateVarsType& state_vars, int thread_id=0)
     {throw std::runtime_error("GetSuccessorLazy not implemented!");};
     virtual ActionSuccessor Evaluate(const StateVarsType& parent_state_vars, const StateVarsType& child_state_vars, int thread_id=0){};
+    /// Token of the planner using the action. Actions with long evaluations should honor it.
+    virtual void SetCancellationToken(const CancellationToken* token){};
 
     std::string GetType() const {return type_;};
     bool IsExpensive() const {return is_expensive_;};
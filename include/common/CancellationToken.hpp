@@ -0,0 +1,68 @@
+#ifndef CANCELLATION_TOKEN_HPP
+#define CANCELLATION_TOKEN_HPP
+
+#include <limits>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ps
+{
+
+/// Cooperative cancellation of the work a planner hands out. Work checks the token before
+/// starting anything expensive, and long solves get the remaining time as their limit. The
+/// token counts as cancelled once Cancel is called or its deadline has passed.
+class CancellationToken
+{
+    public:
+        CancellationToken(): cancelled_(false), deadline_ns_(NO_DEADLINE) {};
+
+        void Cancel() {cancelled_.store(true, std::memory_order_release);};
+
+        /// Clears the cancellation and sets the deadline time_limit seconds from now. Without a
+        /// limit there is no deadline.
+        void Reset(double time_limit=std::numeric_limits<double>::infinity())
+        {
+            int64_t deadline_ns = NO_DEADLINE;
+            if (time_limit < 1e9)
+            {
+                deadline_ns = now() + static_cast<int64_t>(1e9*time_limit);
+            }
+            deadline_ns_.store(deadline_ns, std::memory_order_relaxed);
+            cancelled_.store(false, std::memory_order_release);
+        };
+
+        bool IsCancelled() const
+        {
+            return cancelled_.load(std::memory_order_acquire) ||
+                   now() >= deadline_ns_.load(std::memory_order_relaxed);
+        };
+
+        /// Seconds until the deadline (infinity if there is none), 0 once cancelled
+        double RemainingTime() const
+        {
+            if (cancelled_.load(std::memory_order_acquire))
+                return 0;
+            int64_t deadline_ns = deadline_ns_.load(std::memory_order_relaxed);
+            if (deadline_ns == NO_DEADLINE)
+                return std::numeric_limits<double>::infinity();
+            int64_t remaining_ns = deadline_ns - now();
+            return (remaining_ns > 0) ? 1e-9*remaining_ns : 0;
+        };
+
+    private:
+        static constexpr int64_t NO_DEADLINE = std::numeric_limits<int64_t>::max();
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        };
+
+        std::atomic<bool> cancelled_;
+        std::atomic<int64_t> deadline_ns_;
+};
+
+}
+
+#endif
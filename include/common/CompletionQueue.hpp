@@ -0,0 +1,111 @@
+#ifndef COMPLETION_QUEUE_HPP
+#define COMPLETION_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <exception>
+#include <condition_variable>
+
+namespace ps
+{
+
+/// Results of asynchronous requests in the order they complete. The issuer calls Expect once per
+/// request and tags it, whichever thread finishes the request pushes its result (or error) under
+/// that tag, and the issuer drains results with Next.
+template <typename T>
+class CompletionQueue
+{
+    public:
+        struct Completion
+        {
+            size_t tag_ = 0;
+            T value_;
+            std::exception_ptr error_;
+
+            /// Value of the request, rethrowing the exception it failed with
+            T& Get()
+            {
+                if (error_)
+                    std::rethrow_exception(error_);
+                return value_;
+            };
+        };
+
+        CompletionQueue(): num_outstanding_(0) {};
+
+        CompletionQueue(const CompletionQueue&) = delete;
+        CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+        /// Announces a request whose result will be pushed later
+        void Expect()
+        {
+            std::lock_guard<std::mutex> locker(lock_);
+            ++num_outstanding_;
+        };
+
+        void Push(size_t tag, T value)
+        {
+            Completion completion;
+            completion.tag_ = tag;
+            completion.value_ = std::move(value);
+            push(std::move(completion));
+        };
+
+        void PushError(size_t tag, std::exception_ptr error)
+        {
+            Completion completion;
+            completion.tag_ = tag;
+            completion.error_ = error;
+            push(std::move(completion));
+        };
+
+        /// Blocks until a result is available. Returns false once no request is outstanding.
+        bool Next(Completion& completion)
+        {
+            std::unique_lock<std::mutex> locker(lock_);
+            cv_.wait(locker, [this](){return !completed_.empty() || num_outstanding_ == 0;});
+            return pop(completion);
+        };
+
+        /// Like Next, but returns false instead of blocking when no result is available yet
+        bool TryNext(Completion& completion)
+        {
+            std::lock_guard<std::mutex> locker(lock_);
+            return pop(completion);
+        };
+
+        /// Requests expected whose result has not been taken yet
+        int NumOutstanding() const
+        {
+            std::lock_guard<std::mutex> locker(lock_);
+            return num_outstanding_;
+        };
+
+    private:
+        void push(Completion&& completion)
+        {
+            // Notify under the lock, the consumer may destroy the queue once it has the result
+            std::lock_guard<std::mutex> locker(lock_);
+            completed_.emplace_back(std::move(completion));
+            cv_.notify_one();
+        };
+
+        bool pop(Completion& completion)
+        {
+            if (completed_.empty())
+                return false;
+            completion = std::move(completed_.front());
+            completed_.pop_front();
+            --num_outstanding_;
+            return true;
+        };
+
+        mutable std::mutex lock_;
+        std::condition_variable cv_;
+        std::deque<Completion> completed_;
+        int num_outstanding_;
+};
+
+}
+
+#endif
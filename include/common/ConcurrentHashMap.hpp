@@ -0,0 +1,230 @@
+#ifndef CONCURRENT_HASH_MAP_HPP
+#define CONCURRENT_HASH_MAP_HPP
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace ps
+{
+
+/// Map from size_t keys to non-owning T* values for the parallel planners. Each shard is an
+/// open addressing table with linear probing. Find never locks, writers lock only their shard.
+/// Entries cannot be erased individually. Clear drops them all in O(1) by advancing an epoch:
+/// a slot stamped with an older epoch counts as empty. ForEach and Clear must not run
+/// concurrently with other operations.
+template <typename T>
+class ConcurrentHashMap
+{
+    public:
+        ConcurrentHashMap(int shard_bits=6, size_t shard_capacity=64):
+        shard_bits_(shard_bits), shard_mask_((size_t(1) << shard_bits)-1), shards_(size_t(1) << shard_bits)
+        {
+            size_t capacity = 2;
+            while (capacity < shard_capacity)
+            {
+                capacity <<= 1;
+            }
+            for (auto& shard : shards_)
+            {
+                shard.tables_.emplace_back(new Table(capacity));
+                shard.table_ = shard.tables_.back().get();
+            }
+        };
+
+        ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+        ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+        /// Value stored under key or NULL. Lock free.
+        T* Find(size_t key) const
+        {
+            size_t h = mix(key);
+            const Table* table = shards_[h & shard_mask_].table_.load(std::memory_order_acquire);
+            bool found;
+            size_t idx = probe(*table, h, key, found);
+            return found ? table->slots_[idx].value_ : NULL;
+        };
+
+        /// Inserts value unless key is present. Returns the value stored under key.
+        T* Insert(size_t key, T* value)
+        {
+            return FindOrInsert(key, [value](){return value;});
+        };
+
+        /// Value stored under key, constructing it with make() if absent. make runs at most once
+        /// per key, under the shard lock.
+        template <typename Make>
+        T* FindOrInsert(size_t key, Make make)
+        {
+            size_t h = mix(key);
+            Shard& shard = shards_[h & shard_mask_];
+            Table* table = shard.table_.load(std::memory_order_acquire);
+            bool found;
+            size_t idx = probe(*table, h, key, found);
+            if (found)
+                return table->slots_[idx].value_;
+
+            std::lock_guard<std::mutex> locker(shard.lock_);
+            table = shard.table_.load(std::memory_order_relaxed);
+            idx = probe(*table, h, key, found);
+            if (found)
+                return table->slots_[idx].value_;
+
+            // Keep the load factor at most 1/2 so that probes stay short and always terminate
+            if (2*(shard.size_+1) > table->mask_+1)
+            {
+                table = grow(shard);
+                idx = probe(*table, h, key, found);
+            }
+
+            T* value = make();
+            Slot& slot = table->slots_[idx];
+            slot.key_ = key;
+            slot.value_ = value;
+            slot.epoch_.store(epoch_, std::memory_order_release);
+            ++shard.size_;
+            return value;
+        };
+
+        /// Calls func(key, value) on every entry
+        template <typename Func>
+        void ForEach(Func func) const
+        {
+            for (auto& shard : shards_)
+            {
+                const Table* table = shard.table_.load(std::memory_order_relaxed);
+                for (size_t i = 0; i <= table->mask_; ++i)
+                {
+                    const Slot& slot = table->slots_[i];
+                    if (slot.epoch_.load(std::memory_order_relaxed) == epoch_)
+                        func(slot.key_, slot.value_);
+                }
+            }
+        };
+
+        size_t Size() const
+        {
+            size_t size = 0;
+            for (auto& shard : shards_)
+            {
+                size += shard.size_;
+            }
+            return size;
+        };
+
+        bool Empty() const {return Size() == 0;};
+
+        void Clear()
+        {
+            for (auto& shard : shards_)
+            {
+                // Tables retired by growth may still have been read until now
+                shard.tables_.erase(shard.tables_.begin(), shard.tables_.end()-1);
+                shard.size_ = 0;
+            }
+
+            if (++epoch_ == 0)
+            {
+                for (auto& shard : shards_)
+                {
+                    Table* table = shard.tables_.back().get();
+                    for (size_t i = 0; i <= table->mask_; ++i)
+                    {
+                        table->slots_[i].epoch_.store(0, std::memory_order_relaxed);
+                    }
+                }
+                epoch_ = 1;
+            }
+        };
+
+    private:
+        /// key_ and value_ are published by the release store of epoch_
+        struct Slot
+        {
+            std::atomic<uint32_t> epoch_{0};
+            size_t key_ = 0;
+            T* value_ = NULL;
+        };
+
+        struct Table
+        {
+            Table(size_t capacity): mask_(capacity-1), slots_(new Slot[capacity]) {};
+
+            size_t mask_;
+            std::unique_ptr<Slot[]> slots_;
+        };
+
+        struct Shard
+        {
+            std::mutex lock_;
+            std::atomic<Table*> table_;
+            std::atomic<size_t> size_{0};
+            /// Current table last. Older ones are kept alive for lock free readers until Clear.
+            std::vector<std::unique_ptr<Table>> tables_;
+        };
+
+        static size_t mix(size_t key)
+        {
+            uint64_t h = key;
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        };
+
+        /// Slot holding key if found, otherwise the empty slot where it would be inserted
+        size_t probe(const Table& table, size_t h, size_t key, bool& found) const
+        {
+            size_t idx = (h >> shard_bits_) & table.mask_;
+            while (true)
+            {
+                const Slot& slot = table.slots_[idx];
+                if (slot.epoch_.load(std::memory_order_acquire) != epoch_)
+                {
+                    found = false;
+                    return idx;
+                }
+                if (slot.key_ == key)
+                {
+                    found = true;
+                    return idx;
+                }
+                idx = (idx+1) & table.mask_;
+            }
+        };
+
+        Table* grow(Shard& shard)
+        {
+            const Table* old_table = shard.table_.load(std::memory_order_relaxed);
+            shard.tables_.emplace_back(new Table(2*(old_table->mask_+1)));
+            Table* table = shard.tables_.back().get();
+            for (size_t i = 0; i <= old_table->mask_; ++i)
+            {
+                const Slot& old_slot = old_table->slots_[i];
+                if (old_slot.epoch_.load(std::memory_order_relaxed) != epoch_)
+                    continue;
+
+                size_t idx = (mix(old_slot.key_) >> shard_bits_) & table->mask_;
+                while (table->slots_[idx].epoch_.load(std::memory_order_relaxed) == epoch_)
+                {
+                    idx = (idx+1) & table->mask_;
+                }
+                Slot& slot = table->slots_[idx];
+                slot.key_ = old_slot.key_;
+                slot.value_ = old_slot.value_;
+                slot.epoch_.store(epoch_, std::memory_order_relaxed);
+            }
+            shard.table_.store(table, std::memory_order_release);
+            return table;
+        };
+
+        const int shard_bits_;
+        const size_t shard_mask_;
+        std::vector<Shard> shards_;
+        uint32_t epoch_ = 1;
+};
+
+}
+
+#endif
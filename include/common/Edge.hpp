@@ -36,7 +36,7 @@ class Edge : public smpl::heap_element
         void Print(std::string str="");
         static void ResetStateIDCounter(){id_counter_=0;};
 
-        static std::size_t id_counter_;
+        static std::atomic<std::size_t> id_counter_;
         std::size_t edge_id_;
 
         StatePtrType parent_state_ptr_;
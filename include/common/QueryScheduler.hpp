@@ -0,0 +1,53 @@
+#ifndef QUERY_SCHEDULER_HPP
+#define QUERY_SCHEDULER_HPP
+
+#include <vector>
+#include <functional>
+#include <common/WorkStealingPool.hpp>
+
+namespace ps
+{
+
+/// Runs batches of independent planning queries across cores. Each worker owns one planning
+/// context (planner, optimizer, heuristic), indexed by the worker id passed to the query, and
+/// runs one query at a time on it. Whatever the contexts share must be read only.
+class QueryScheduler
+{
+    public:
+        /// Plans query query_id on the context of worker worker_id. Returns whether a plan was found.
+        typedef std::function<bool(int query_id, int worker_id)> QueryType;
+
+        struct QueryStats
+        {
+            int worker_id_ = -1;
+            bool success_ = false;
+            /// Seconds from the start of the batch
+            double start_time_ = 0;
+            double time_ = 0;
+        };
+
+        QueryScheduler(int num_workers);
+
+        /// Runs queries [0, num_queries) and returns once all of them finished. The first
+        /// exception thrown by a query is rethrown here.
+        void Run(int num_queries, QueryType query);
+
+        int NumWorkers() const {return pool_.NumWorkers();};
+
+        /// Of the last batch, indexed by query id
+        const std::vector<QueryStats>& GetQueryStats() const {return query_stats_;};
+        int NumSuccessful() const;
+        /// Wall time of the last batch
+        double GetTotalTime() const {return total_time_;};
+        /// Queries per second of the last batch
+        double GetThroughput() const;
+
+    private:
+        WorkStealingPool pool_;
+        std::vector<QueryStats> query_stats_;
+        double total_time_;
+};
+
+}
+
+#endif
@@ -48,6 +48,9 @@ public:
     EdgePtrType GetIncomingEdgePtr() {return incoming_edge_ptr_;};
     void ResetIncomingEdgePtr() {incoming_edge_ptr_ = NULL;};
 
+    /// Reinitializes a recycled state as if it was just constructed from vars
+    void Reset(const StateVarsType& vars);
+
     void Print(std::string str="");
 
     std::atomic<int> num_successors_;
@@ -56,11 +59,12 @@ public:
 protected:
 
 //private:
-	static std::size_t id_counter_;
+	static std::atomic<std::size_t> id_counter_;
 
 	std::size_t state_id_;
     StateVarsType vars_;
-	double g_val_;
+	/// Atomic so that independence checks can read it while workers update it
+	std::atomic<double> g_val_;
     double h_val_;
 	double f_val_;
 	std::atomic<bool> is_visited_;
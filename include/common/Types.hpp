@@ -64,6 +64,9 @@ namespace ps
       int num_threads_spawned_ = 0;
 
         std::vector<int> num_jobs_per_thread_;
+        /// Cpu and NUMA node of each pool worker when it started, -1 if it did not
+        std::vector<int> worker_cpus_;
+        std::vector<int> worker_numa_nodes_;
         
 	    double lock_time_ = 0;
         double cumulative_expansions_time_ = 0;
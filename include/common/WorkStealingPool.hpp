@@ -0,0 +1,122 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace ps
+{
+
+/// Fixed size executor with a task deque per worker. A worker pops from the back of its own deque
+/// and steals from the front of the others when it runs dry, then parks until new work arrives.
+/// Threads are spawned lazily, only once the number of pending tasks exceeds the started workers.
+/// Workers can be pinned to cpus and run an init hook on their own thread before their first
+/// task, so that memory they touch first is placed on their NUMA node.
+class WorkStealingPool
+{
+    public:
+        /// Task receives the id (in [0, num_workers)) of the worker running it
+        typedef std::function<void(int)> TaskType;
+
+        WorkStealingPool(int num_workers);
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        /// Pins worker i to the (first_cpu+i)-th cpu the calling thread may run on, wrapping
+        /// around. No effect outside Linux. Must be called before the first Submit.
+        void SetAffinity(int first_cpu);
+
+        /// Pins the calling thread to the cpu_idx-th cpu of those SetAffinity found, e.g. to keep
+        /// the submitting thread off the cpus of the workers. Its previous mask is kept until
+        /// UnpinCallingThread, or the destructor if that runs on the same thread.
+        void PinCallingThread(int cpu_idx);
+
+        /// Gives the thread pinned by PinCallingThread its previous mask back. Must be called on
+        /// that thread, no effect elsewhere.
+        void UnpinCallingThread();
+
+        /// init(worker_id) runs on each worker thread as it starts, before it takes any task.
+        /// Must be called before the first Submit.
+        void SetWorkerInit(TaskType init);
+
+        /// Queues the task. Tasks submitted from a worker go to its own deque.
+        void Submit(TaskType task);
+
+        /// Blocks until fewer tasks are pending than there are workers
+        void WaitForIdleWorker();
+
+        /// Blocks until fewer than max_pending tasks are pending (queued or running)
+        void WaitForPendingBelow(int max_pending);
+
+        /// Blocks until every submitted task has finished and every started worker is initialized
+        void WaitAll();
+
+        int NumWorkers() const {return num_workers_;};
+        int NumWorkersStarted() const {return num_started_;};
+        int NumPending() const {return num_pending_;};
+
+        /// Cpu and NUMA node the worker was on once initialized, -1 if not started or unknown
+        int WorkerCpu(int worker_id) const {return workers_[worker_id]->cpu_;};
+        int WorkerNode(int worker_id) const {return workers_[worker_id]->node_;};
+
+    private:
+        struct Worker
+        {
+            std::mutex lock_;
+            std::deque<TaskType> tasks_;
+            std::atomic<int> cpu_{-1};
+            std::atomic<int> node_{-1};
+        };
+
+        void spawnWorkers();
+        void workerLoop(int worker_id);
+        bool popTask(int worker_id, TaskType& task);
+        void initWorker(int worker_id);
+        void pinTo(int cpu_idx) const;
+        void finishTask();
+        void notifyWaiting();
+        template<typename Pred> void waitUntil(Pred pred);
+
+        const int num_workers_;
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::vector<std::thread> threads_;
+        std::mutex spawn_lock_;
+        std::atomic<int> num_started_;
+        std::atomic<int> num_initialized_;
+        /// -1 leaves workers unpinned
+        int first_cpu_;
+        /// Cpus the process may run on, read by the first pool of the process
+        std::vector<int> cpus_;
+        /// Thread pinned by PinCallingThread and the cpus it was allowed on before
+        std::thread::id caller_id_;
+        std::vector<int> caller_cpus_;
+        TaskType init_;
+        std::atomic<int> next_worker_;
+
+        /// Submitted but not finished / submitted but not yet popped
+        std::atomic<int> num_pending_;
+        std::atomic<int> num_queued_;
+
+        /// Workers park here when no task is queued
+        std::mutex park_lock_;
+        std::condition_variable park_cv_;
+        std::atomic<int> num_parked_;
+        bool stop_;
+
+        /// Submitters wait here for workers to free up
+        std::mutex wait_lock_;
+        std::condition_variable wait_cv_;
+        std::atomic<int> num_waiting_;
+};
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef COMPACT_GCS_TRAJ_HPP
+#define COMPACT_GCS_TRAJ_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <common/insat/InsatTypes.hpp>
+
+namespace ps
+{
+    /// Immutable GCSTraj that keeps the Bezier control points of its segments in one buffer, with
+    /// the segment durations, the cost and the solver status. The leading segments it has in
+    /// common with the trajectory of the parent edge are left to that trajectory, which is kept
+    /// as parent, so storing the trajectory of an edge stores only the segments that changed.
+    /// Drake types are only rebuilt by Expand. The sampled disc_traj_ is not kept.
+    class CompactGCSTraj
+    {
+    public:
+        typedef std::shared_ptr<const CompactGCSTraj> Ptr;
+
+        /// Compacts traj, which costs cost. Leading segments that match those of prefix to
+        /// share_tol (relative to the magnitude of their control points) are shared with it.
+        static Ptr Compress(const GCSTraj& traj, double cost, const Ptr& prefix = nullptr,
+                            double share_tol = 1e-6);
+
+        /// Drake trajectory and a result holding the solver status and optimal cost
+        GCSTraj Expand() const;
+
+        bool IsValid() const {return solution_result_ == drake::solvers::SolutionResult::kSolutionFound;}
+        double Cost() const {return cost_;}
+        int NumSegments() const {return first_segment_ + NumOwnedSegments();}
+        /// Segments stored here and not shared with the prefix
+        int NumOwnedSegments() const {return static_cast<int>(durations_.size());}
+
+        /// Control points of segment i as columns. Walks up the parents to the one storing it.
+        Eigen::Ref<const MatDf> ControlPoints(int i) const
+        {
+            const CompactGCSTraj& owner = ownerOf(i);
+            const int j = i - owner.first_segment_;
+            return owner.control_points_.middleCols(owner.col_offsets_[j], owner.col_offsets_[j+1]-owner.col_offsets_[j]);
+        }
+        double Duration(int i) const
+        {
+            const CompactGCSTraj& owner = ownerOf(i);
+            return owner.durations_[i - owner.first_segment_];
+        }
+
+    private:
+        CompactGCSTraj() = default;
+
+        const CompactGCSTraj& ownerOf(int i) const
+        {
+            const CompactGCSTraj* traj = this;
+            while (i < traj->first_segment_)
+            {
+                traj = traj->parent_.get();
+            }
+            return *traj;
+        }
+
+        /// Calls visit(control_points, duration) on the segments in order until it returns false
+        template<typename Visitor>
+        void forEachSegment(Visitor&& visit) const;
+
+        /// Segments [0, first_segment_) are those of parent_, the rest are stored here
+        Ptr parent_;
+        int first_segment_ = 0;
+        /// Owned segment j is made of columns [col_offsets_[j], col_offsets_[j+1])
+        MatDf control_points_;
+        std::vector<int> col_offsets_{0};
+        std::vector<double> durations_;
+        double start_time_ = 0;
+
+        double cost_ = 0;
+        double optimal_cost_ = 0;
+        drake::solvers::SolutionResult solution_result_ = drake::solvers::SolutionResult::kSolutionResultNotSet;
+        /// Only allocated when the solver left a story
+        std::shared_ptr<const std::string> story_;
+
+        /// Trajectories that are not made of Bezier curves are kept as they are
+        std::shared_ptr<const GCSTraj> full_traj_;
+    };
+}
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef INSAT_ACTION_HPP
 #define INSAT_ACTION_HPP
 
+#include <future>
+#include <memory>
+#include <functional>
 #include <common/insat/InsatState.hpp>
 #include <common/Action.hpp>
+#include <common/CompletionQueue.hpp>
 
 namespace ps
 {
@@ -38,6 +42,54 @@ namespace ps
       virtual std::vector<double> SampleFeasibleState(int thread_id){};
       virtual std::unordered_map<int, std::vector<int>> getAdjacencyList() = 0;
 
+        /// Solve job, run with the thread id of the optimizer it may use
+        typedef std::function<void(int)> SolveJobType;
+
+        /// Runs job where solves of this action run. Defaults to running it inline as thread 0.
+        virtual void submitSolve(SolveJobType job) {job(0);};
+
+        /// optimize(incoming_traj, ancestors, successor) through submitSolve. The arguments are
+        /// copied, so they need not outlive the call.
+        std::future<TrajType> optimizeAsync(const TrajType& incoming_traj,
+                                            const std::vector<StateVarsType>& ancestors,
+                                            const StateVarsType& successor)
+        {
+            auto promise = std::make_shared<std::promise<TrajType>>();
+            auto future = promise->get_future();
+            submitSolve([this, promise, incoming_traj, ancestors, successor](int thread_id)
+            {
+                try
+                {
+                    promise->set_value(optimize(incoming_traj, ancestors, successor, thread_id));
+                }
+                catch (...)
+                {
+                    promise->set_exception(std::current_exception());
+                }
+            });
+            return future;
+        }
+
+        /// Same, delivering the result to queue under tag instead of through a future
+        void optimizeAsync(const TrajType& incoming_traj,
+                           const std::vector<StateVarsType>& ancestors,
+                           const StateVarsType& successor,
+                           CompletionQueue<TrajType>& queue, size_t tag)
+        {
+            queue.Expect();
+            submitSolve([this, &queue, tag, incoming_traj, ancestors, successor](int thread_id)
+            {
+                try
+                {
+                    queue.Push(tag, optimize(incoming_traj, ancestors, successor, thread_id));
+                }
+                catch (...)
+                {
+                    queue.PushError(tag, std::current_exception());
+                }
+            });
+        }
+
     };
 
 }
@@ -3,6 +3,7 @@
 
 #include <common/Edge.hpp>
 #include <common/insat/InsatAction.hpp>
+#include <common/insat/CompactGCSTraj.hpp>
 
 namespace ps
 {
@@ -21,15 +22,24 @@ namespace ps
         InsatEdge& operator=(const InsatEdge& other_edge);
         bool operator==(const InsatEdge& other_edge) const;
 
-        void SetTraj(TrajType& traj) 
+        /// Stores traj and its cost compactly, sharing the leading segments it has in common with prefix
+        void SetTraj(TrajType& traj, double traj_cost, const CompactGCSTraj::Ptr& prefix = nullptr)
         {
+            auto compact_traj = CompactGCSTraj::Compress(traj, traj_cost, prefix);
             lock_.lock();
-            traj_ = traj;
+            traj_ = compact_traj;
             lock_.unlock();
         };
-        
+
+        /// Rebuilds the drake trajectory, for warm starts and the final solution
         TrajType GetTraj() 
         { 
+            auto compact_traj = GetCompactTraj();
+            return compact_traj? compact_traj->Expand() : TrajType();
+        };
+
+        CompactGCSTraj::Ptr GetCompactTraj()
+        {
             lock_.lock();
             auto traj_local = traj_;
             lock_.unlock();
@@ -59,7 +69,7 @@ namespace ps
 
     private:
         // Dynamic trajectory
-        TrajType traj_;
+        CompactGCSTraj::Ptr traj_;
         double traj_cost_;
     };
 }
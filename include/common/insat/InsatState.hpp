@@ -17,6 +17,7 @@ namespace ps
     void ResetIncomingInsatEdgePtr() { incoming_edge_ptr_ = NULL;};
     void SetAncestors(const std::vector<InsatStatePtrType>& ancestors) {ancestors_ = ancestors;};
     std::vector<InsatStatePtrType> GetAncestors() const {return ancestors_;};
+    void Reset(const StateVarsType& vars) { State::Reset(vars); incoming_edge_ptr_ = nullptr; ancestors_.clear();};
 
   protected:
     InsatEdgePtrType incoming_edge_ptr_;
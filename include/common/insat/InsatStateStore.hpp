@@ -0,0 +1,131 @@
+#ifndef INSAT_STATE_STORE_HPP
+#define INSAT_STATE_STORE_HPP
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <common/ConcurrentHashMap.hpp>
+#include <common/insat/InsatState.hpp>
+
+namespace ps
+{
+  /// Pool backed storage of search states. States keyed by a dense id (e.g. a GCS vertex id) are
+  /// found by indexing a fixed vector of atomic slots; dense ids outside of its range and other
+  /// states (e.g. path states, keyed by hash) live in concurrent maps. Lookups never lock and
+  /// workers may create states concurrently. Reset forgets every state in O(1) and the next query
+  /// recycles their storage, so state pointers are only valid until Reset.
+  class InsatStateStore
+  {
+  public:
+
+    /// Ids [first_id, first_id+num_ids) are indexed directly. Drops every state, so it must not
+    /// run concurrently with the other members.
+    void SetDenseRange(size_t first_id, size_t num_ids)
+    {
+      Reset();
+      first_dense_id_ = first_id;
+      num_dense_ids_ = num_ids;
+      dense_.reset(new DenseSlot[num_ids]);
+    }
+
+    /// State with dense id, constructed from vars on first use
+    InsatStatePtrType GetOrCreate(size_t id, const StateVarsType& vars)
+    {
+      if (id < first_dense_id_ || id - first_dense_id_ >= num_dense_ids_)
+      {
+        return sparse_.FindOrInsert(id, [this, &vars](){return allocate(vars);});
+      }
+
+      auto& slot = dense_[id - first_dense_id_];
+      if (slot.epoch_.load(std::memory_order_acquire) == epoch_)
+      {
+        return slot.state_;
+      }
+      std::lock_guard<std::mutex> locker(pool_lock_);
+      if (slot.epoch_.load(std::memory_order_relaxed) != epoch_)
+      {
+        slot.state_ = allocateLocked(vars);
+        slot.epoch_.store(epoch_, std::memory_order_release);
+      }
+      return slot.state_;
+    }
+
+    /// State with hashed key, constructed from vars on first use
+    InsatStatePtrType GetOrCreateHashed(size_t key, const StateVarsType& vars)
+    {
+      return hashed_.FindOrInsert(key, [this, &vars](){return allocate(vars);});
+    }
+
+    /// Live states in creation order. Not safe against concurrent creation.
+    template <typename Func>
+    void ForEach(Func func)
+    {
+      for (size_t i = 0; i < num_used_; ++i)
+      {
+        func(&pool_[i]);
+      }
+    }
+
+    size_t Size() const { return num_used_; }
+
+    /// Must not run concurrently with the other members
+    void Reset()
+    {
+      num_used_ = 0;
+      if (++epoch_ == 0)
+      {
+        for (size_t i = 0; i < num_dense_ids_; ++i)
+        {
+          dense_[i].epoch_.store(0, std::memory_order_relaxed);
+        }
+        epoch_ = 1;
+      }
+      sparse_.Clear();
+      hashed_.Clear();
+    }
+
+  private:
+
+    /// state_ is published by the release store of epoch_. Slots of older epochs are empty.
+    struct DenseSlot
+    {
+      std::atomic<uint32_t> epoch_{0};
+      InsatStatePtrType state_ = nullptr;
+    };
+
+    InsatStatePtrType allocate(const StateVarsType& vars)
+    {
+      std::lock_guard<std::mutex> locker(pool_lock_);
+      return allocateLocked(vars);
+    }
+
+    InsatStatePtrType allocateLocked(const StateVarsType& vars)
+    {
+      if (num_used_ == pool_.size())
+      {
+        pool_.emplace_back(vars);
+      }
+      else
+      {
+        pool_[num_used_].Reset(vars);
+      }
+      return &pool_[num_used_++];
+    }
+
+    /// Deque keeps addresses stable as it grows
+    std::deque<InsatState> pool_;
+    size_t num_used_ = 0;
+    std::mutex pool_lock_;
+
+    uint32_t epoch_ = 1;
+    size_t first_dense_id_ = 0;
+    size_t num_dense_ids_ = 0;
+    std::unique_ptr<DenseSlot[]> dense_;
+
+    ConcurrentHashMap<InsatState> sparse_;
+    ConcurrentHashMap<InsatState> hashed_;
+  };
+}
+
+#endif
@@ -16,7 +16,6 @@ class EpasePlanner : public GepasePlanner
         bool Plan();
 
     protected:
-        void expandEdgeLoop(int thread_id);    
         void expandEdge(EdgePtrType edge_ptr, int thread_id);
         void exit();
 
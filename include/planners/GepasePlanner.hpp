@@ -1,9 +1,11 @@
 #ifndef GEPASE_PLANNER_HPP
 #define GEPASE_PLANNER_HPP
 
-#include <future>
+#include <memory>
 #include <condition_variable>
 #include <planners/Planner.hpp>
+#include <common/WorkStealingPool.hpp>
+#include <common/ConcurrentHashMap.hpp>
 
 namespace ps
 {
@@ -18,8 +20,8 @@ class GepasePlanner : virtual public Planner
 
     protected:
         void initialize();
+        StatePtrType constructState(const StateVarsType& state);
         void notifyMainThread();
-        void expandEdgeLoop(int thread_id);    
         void expand(EdgePtrType edge_ptr, int thread_id);
         void expandEdge(EdgePtrType edge_ptr, int thread_id);
         void exit();
@@ -27,14 +29,14 @@ class GepasePlanner : virtual public Planner
         EdgeQueueMinType edge_open_list_;
         BEType being_expanded_states_;    
 
+        // State and edge lookup that expansion threads can share without holding lock_
+        ConcurrentHashMap<State> concurrent_state_map_;
+        ConcurrentHashMap<Edge> concurrent_edge_map_;
+
         // Multi-threading members
         int num_threads_;
         mutable LockType lock_;
-        mutable std::vector<LockType> lock_vec_; 
-        std::vector<std::future<void>> edge_expansion_futures_;
-        std::vector<EdgePtrType> edge_expansion_vec_;
-        std::vector<int> edge_expansion_status_;
-        std::vector<std::condition_variable> cv_vec_;
+        std::unique_ptr<WorkStealingPool> pool_;
         std::condition_variable cv_;
 
         // Control variables
@@ -8,6 +8,7 @@
 #include <future>
 #include <common/Types.hpp>
 #include <common/Edge.hpp>
+#include <common/WorkStealingPool.hpp>
 
 namespace ps
 {
@@ -43,7 +44,12 @@ class Planner
         void SetEdgeKeyGenerator(std::function<std::size_t(const EdgePtrType&)> callback);
         void SetHeuristicGenerator(std::function<double(const StateVarsType&)> callback);
         void SetStateToStateHeuristicGenerator(std::function<double(const StateVarsType&, const StateVarsType&)> callback);
+        /// Optional batched form of the state to state heuristic: h from each of many states to one
+        void SetStatesToStateHeuristicGenerator(std::function<void(const std::vector<StateVarsType>&, const StateVarsType&, std::vector<double>&)> callback);
         void SetPostProcessor(std::function<void(std::vector<PlanElement>&, double&, double)> callback);
+        /// Runs on each worker thread of the parallel planners as it starts, with the thread id its
+        /// work is done under. Per-thread scratch allocated here is first touched by the worker.
+        void SetThreadInitializer(std::function<void(int)> callback);
 
         StatePtrMapType GetStateMap() {return state_map_;}
 
@@ -53,10 +59,11 @@ class Planner
         void startTimer();
         bool checkTimeout();
         virtual void resetStates();
-        StatePtrType constructState(const StateVarsType& state);
+        virtual StatePtrType constructState(const StateVarsType& state);
         size_t getEdgeKey(const EdgePtrType& edge_ptr);
         double computeHeuristic(const StatePtrType& state_ptr);
         double computeHeuristic(const StatePtrType& state_ptr_1, const StatePtrType& state_ptr_2);
+        void computeHeuristics(const std::vector<StatePtrType>& state_ptrs, const StatePtrType& state_ptr, std::vector<double>& h_vals);
         bool isGoalState(const StatePtrType& state_ptr);
         void constructPlan(StatePtrType& state_ptr);
 
@@ -66,6 +73,15 @@ class Planner
         void cleanUp();
         virtual void exit();
 
+        /// Pool of num_workers worker threads. If the pin_workers param is set, the workers are
+        /// pinned to cpus of their own.
+        std::unique_ptr<WorkStealingPool> makeWorkerPool(int num_workers);
+        /// Pins the calling (search) thread to the cpu left free by the workers of pool for the
+        /// query, no effect unless pin_workers is set. exit() gives the thread its mask back.
+        void pinSearchThread(WorkStealingPool& pool);
+        /// Copies the cpu and NUMA node of each worker into planner_stats_
+        void recordWorkerPlacement(const WorkStealingPool& pool);
+
         std::unordered_map<std::string, double> planner_params_;
         std::vector<std::shared_ptr<Action>> actions_ptrs_;
 
@@ -79,8 +95,10 @@ class Planner
         std::function<std::size_t(const EdgePtrType&)> edge_key_generator_;
         std::function<double(const StateVarsType&)> unary_heuristic_generator_;
         std::function<double(const StateVarsType&, const StateVarsType&)> binary_heuristic_generator_;
+        std::function<void(const std::vector<StateVarsType>&, const StateVarsType&, std::vector<double>&)> batch_binary_heuristic_generator_;
         std::function<double(const StateVarsType&)> goal_checker_;
         std::function<void(std::vector<PlanElement>&, double&, double)> post_processor_;
+        std::function<void(int)> thread_initializer_;
 
         // Statistics
         std::vector<PlanElement> plan_;
@@ -88,6 +106,10 @@ class Planner
         double h_val_min_;
 
         std::chrono::time_point<std::chrono::steady_clock> t_start_;
+
+        /// Shared with the actions. Its deadline is the timeout of the current plan, and exit
+        /// cancels the work still in flight.
+        CancellationToken cancel_token_;
 };
 
 }
@@ -2,9 +2,12 @@
 #define INSATxGCS_PLANNER_HPP
 
 #include <future>
+#include <memory>
 #include <utility>
 #include "planners/Planner.hpp"
+#include <common/WorkStealingPool.hpp>
 #include <common/insat/InsatState.hpp>
+#include <common/insat/InsatStateStore.hpp>
 #include <common/insat/InsatEdge.hpp>
 
 namespace ps
@@ -42,6 +45,37 @@ namespace ps
                      InsatActionPtrType& action_ptr,
                      ActionSuccessor& action_successor);
 
+    /// Expansion with the successor trajectories optimized concurrently on successor_pool_.
+    /// Updates are applied in action order, so the search is identical to expandState.
+    void expandStateParallel(InsatStatePtrType state_ptr);
+
+    /// Expansion with the successor trajectories optimized through the actions' optimizeAsync
+    /// when "pipelined_successors" is set. Each successor is updated as soon as its solve
+    /// completes while the others still run, so ties may be broken differently than expandState.
+    void expandStatePipelined(InsatStatePtrType state_ptr);
+
+    /// Actions and successor states of state_ptr that still need to be evaluated
+    void generateSuccessors(InsatStatePtrType& state_ptr,
+                            std::vector<InsatStatePtrType>& ancestors,
+                            std::vector<InsatActionPtrType>& actions,
+                            std::vector<InsatStatePtrType>& successors);
+
+    /// Successor state if it still needs to be evaluated, NULL otherwise
+    InsatStatePtrType evaluatedSuccessor(std::vector<InsatStatePtrType>& ancestors,
+                                         ActionSuccessor& action_successor);
+
+    TrajType optimizeSuccessor(const InsatStatePtrType& state_ptr,
+                               const std::vector<StateVarsType>& anc_states,
+                               InsatActionPtrType& action_ptr,
+                               const InsatStatePtrType& successor_state_ptr,
+                               int thread_id=0);
+
+    void relaxSuccessor(InsatStatePtrType& state_ptr,
+                        std::vector<InsatStatePtrType>& ancestors,
+                        InsatActionPtrType& action_ptr,
+                        InsatStatePtrType& successor_state_ptr,
+                        TrajType& traj);
+
     void constructInsatActions();
 
     InsatStatePtrType constructInsatState(const StateVarsType& state);
@@ -73,8 +107,13 @@ namespace ps
     InsatStatePtrType start_state_ptr_;
     InsatStatePtrType goal_state_ptr_;
     InsatStateQueueMinType insat_state_open_list_;
-    InsatStatePtrMapType insat_state_map_;
+    InsatStateStore insat_state_store_;
     TrajType soln_traj_;
+    bool warm_start_;
+
+    /// Runs the optimize calls of one expansion when "parallel_successors" is set. Worker i
+    /// uses the action's i-th optimizer.
+    std::unique_ptr<WorkStealingPool> successor_pool_;
 
   };
 
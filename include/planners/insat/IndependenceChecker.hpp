@@ -0,0 +1,54 @@
+#ifndef INDEPENDENCE_CHECKER_HPP
+#define INDEPENDENCE_CHECKER_HPP
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <common/State.hpp>
+
+namespace ps
+{
+
+  /// Decides whether a state popped for expansion is independent of other states (the ones being
+  /// expanded and the ones ahead of it in the open list), i.e. none of them can still lower its g:
+  ///     g(s) <= g(b) + w*h(b, s)  for every other state b.
+  /// States with g(b) >= g(s) pass without a heuristic call since h is non-negative. Pairwise
+  /// heuristic values are cached for the query, and the uncached ones are evaluated in a single
+  /// batch call when a batch heuristic is given.
+  class IndependenceChecker
+  {
+  public:
+    typedef std::function<double(const StatePtrType&, const StatePtrType&)> HeuristicType;
+    /// Fills h_vals with the heuristic from each of the states to the last argument
+    typedef std::function<void(const std::vector<StatePtrType>&, const StatePtrType&, std::vector<double>&)> BatchHeuristicType;
+
+    IndependenceChecker(HeuristicType heuristic=HeuristicType(),
+                        BatchHeuristicType batch_heuristic=BatchHeuristicType(),
+                        double heuristic_w=1.0);
+
+    bool IsIndependent(const StatePtrType& state_ptr, const std::vector<StatePtrType>& other_state_ptrs);
+
+    /// Forgets the cached heuristic values. State ids are only unique within a query.
+    void Clear();
+
+    int NumHeuristicCalls() const {return num_heuristic_calls_;};
+
+  private:
+    static uint64_t pairKey(const StatePtrType& from_ptr, const StatePtrType& to_ptr)
+    {
+      return (static_cast<uint64_t>(from_ptr->GetStateID()) << 32) ^ static_cast<uint64_t>(to_ptr->GetStateID());
+    }
+
+    HeuristicType heuristic_;
+    BatchHeuristicType batch_heuristic_;
+    double heuristic_w_;
+
+    std::unordered_map<uint64_t, double> h_cache_;
+    std::vector<StatePtrType> pending_;
+    std::vector<double> h_vals_;
+    int num_heuristic_calls_ = 0;
+  };
+
+}
+
+#endif
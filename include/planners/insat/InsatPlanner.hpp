@@ -4,6 +4,7 @@
 #include <future>
 #include <utility>
 #include "planners/Planner.hpp"
+#include <common/ConcurrentHashMap.hpp>
 #include <common/insat/InsatState.hpp>
 #include <common/insat/InsatEdge.hpp>
 
@@ -15,7 +16,7 @@ namespace ps
     public:
 
         // Typedefs
-        typedef std::unordered_map<size_t, InsatStatePtrType> InsatStatePtrMapType;
+        typedef ConcurrentHashMap<InsatState> InsatStatePtrMapType;
         typedef smpl::intrusive_heap<InsatState, IsLesserState> InsatStateQueueMinType;
 
         InsatPlanner(ParamsType planner_params);;
@@ -23,7 +23,6 @@ class PinsatPlanner : virtual public GepasePlanner, virtual public InsatPlanner
 
     protected:
         void initialize();
-        void expandEdgeLoop(int thread_id);    
         void expand(InsatEdgePtrType edge_ptr, int thread_id);
         void expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id);
         void exit();
@@ -31,7 +30,6 @@ class PinsatPlanner : virtual public GepasePlanner, virtual public InsatPlanner
         EdgeQueueMinType edge_open_list_;
         BEType being_expanded_states_;    
 
-        std::vector<InsatEdgePtrType> edge_expansion_vec_;
         InsatActionPtrType dummy_action_ptr_;
 
 
@@ -0,0 +1,142 @@
+/*!
+ * \file ChainSocpSolver.hpp
+ * \brief Interior point solver for the conic problems of a path of GCS vertices
+*/
+
+#pragma once
+#ifndef INSATxGCS_CHAINSOCPSOLVER_HPP
+#define INSATxGCS_CHAINSOCPSOLVER_HPP
+
+#include <vector>
+#include <limits>
+#include <Eigen/Dense>
+#include <planners/insat/opt/GCSConicTemplate.hpp>
+
+namespace ps {
+
+  /// Primal-dual interior point method (Nesterov-Todd scaling, Mehrotra predictor-corrector) for a
+  /// ConicProblem whose rows only couple the columns of neighbouring path vertices. The KKT
+  /// system is then block tridiagonal with one block per vertex (its columns and the equality and
+  /// cone rows it owns) and is factored block by block, so an iteration is linear in the path length.
+  /// Workspaces are sized once per solve and kept between solves, iterations do not allocate.
+  class ChainSocpSolver {
+
+  public:
+
+    enum class Status {
+      kSolved,
+      kMaxIterations,
+      kTimeLimit,
+      kNumericalError,
+      /// A row or cone couples vertices that are not neighbours on the path
+      kUnsupported
+    };
+
+    struct Settings {
+      int max_iter_ = 50;
+      double feas_tol_ = 1e-8;
+      double abs_gap_tol_ = 1e-8;
+      double rel_gap_tol_ = 1e-8;
+      /// Static regularization of the reduced KKT blocks, undone by iterative refinement
+      double reg_ = 1e-9;
+      int refine_steps_ = 2;
+      double step_fraction_ = 0.99;
+    };
+
+    Settings& GetSettings() { return settings_; }
+
+    /// Solves prob, giving up once time_limit seconds have passed
+    Status Solve(const ConicProblem& prob,
+                 double time_limit = std::numeric_limits<double>::infinity());
+
+    /// Primal solution and c'x + c0 of the last solve
+    const Eigen::VectorXd& GetX() const { return x_; }
+    double GetCost() const { return cost_; }
+    int GetIterations() const { return iterations_; }
+
+  private:
+
+    bool setupStructure(const ConicProblem& prob);
+    /// Starting point, false if the KKT system can not be factored
+    bool initialize(const ConicProblem& prob);
+    bool computeScaling();
+    /// Assembles and factors the KKT blocks for the current scaling
+    bool factor(const ConicProblem& prob);
+    void addEntry(int pos1, int pos2, double val);
+    void solveBlocks(Eigen::VectorXd& v);
+    /// Solves [0 A' G'; A 0 0; G 0 -W^2] [dx; dy; dz] = [ex; ey; ez] with the factored blocks
+    void solveKKT(const ConicProblem& prob,
+                  const Eigen::VectorXd& ex, const Eigen::VectorXd& ey, const Eigen::VectorXd& ez,
+                  Eigen::VectorXd& dx, Eigen::VectorXd& dy, Eigen::VectorXd& dz);
+    /// Solves the Newton system with right hand sides px, py, pz and the complementarity
+    /// term q in the scaled space
+    void solveNewton(const ConicProblem& prob,
+                     const Eigen::VectorXd& px, const Eigen::VectorXd& py, const Eigen::VectorXd& pz,
+                     const Eigen::VectorXd& q,
+                     Eigen::VectorXd& dx, Eigen::VectorXd& dy, Eigen::VectorXd& dz, Eigen::VectorXd& ds);
+
+    /// Cone operations on the cone rows (inequalities then second order cones)
+    void applyW(const Eigen::VectorXd& v, Eigen::VectorXd& out, bool inverse) const;
+    void jordanProduct(const Eigen::VectorXd& u, const Eigen::VectorXd& v, Eigen::VectorXd& out) const;
+    void jordanDivide(const Eigen::VectorXd& u, const Eigen::VectorXd& v, Eigen::VectorXd& out) const;
+    double maxStep(const Eigen::VectorXd& u, const Eigen::VectorXd& du) const;
+    /// Smallest t such that u + t e is in the cone
+    double shiftToCone(const Eigen::VectorXd& u) const;
+    void addIdentity(Eigen::VectorXd& u, double alpha) const;
+
+    Settings settings_;
+
+    /// Structure of the last problem
+    int num_blocks_ = 0;
+    int num_ineq_ = 0;
+    int num_cone_rows_ = 0;
+    int degree_ = 0;
+    std::vector<int> col_block_;
+    std::vector<int> row_block_;
+    std::vector<bool> row_links_;
+    /// First cone row of each second order cone and the block owning it
+    std::vector<int> soc_offset_;
+    std::vector<int> soc_block_;
+    std::vector<bool> soc_links_;
+    std::vector<int> block_offset_;
+    std::vector<int> block_size_;
+    /// Position of each column, equality row and cone row in the stacked block unknowns
+    std::vector<int> col_pos_;
+    std::vector<int> row_pos_;
+    std::vector<int> cone_pos_;
+    std::vector<int> pos_block_;
+
+    /// Diagonal KKT blocks D_i (overwritten by the Schur complements S_i), sub-diagonal blocks
+    /// B_i (block i+1 by block i), the factors of S_i and S_i^-1 B_i' restricted to the nonzero
+    /// part of B_i: its first link_rows_ rows and the columns from link_begin_ on
+    std::vector<Eigen::MatrixXd> sub_;
+    std::vector<Eigen::MatrixXd> schur_;
+    std::vector<Eigen::MatrixXd> gain_;
+    std::vector<Eigen::PartialPivLU<Eigen::MatrixXd>> lu_;
+    std::vector<int> link_begin_;
+    std::vector<int> link_rows_;
+    Eigen::MatrixXd gain_rhs_;
+    Eigen::VectorXd block_tmp_;
+
+    /// Nesterov-Todd scaling. Per inequality: W = sqrt(s/z). Per cone: eta and the unit vector
+    /// wbar, with W^2 stored densely.
+    Eigen::VectorXd lp_scale_;
+    std::vector<double> soc_eta_;
+    Eigen::VectorXd soc_wbar_;
+    std::vector<Eigen::MatrixXd> soc_w2_;
+    Eigen::VectorXd lambda_;
+
+    /// Iterates and scratch vectors
+    Eigen::VectorXd x_, y_, z_, s_;
+    Eigen::VectorXd rx_, ry_, rz_, h_, b_;
+    Eigen::VectorXd dx_, dy_, dz_, ds_, dx_aff_, dy_aff_, dz_aff_, ds_aff_;
+    Eigen::VectorXd rs_, tmp_cone_, tmp_cone2_, tmp_cone3_, vx_;
+    Eigen::VectorXd kkt_, ref_cone_, res_x_, res_y_, res_z_, corr_x_, corr_y_, corr_z_;
+
+    double cost_ = 0;
+    int iterations_ = 0;
+  };
+
+}
+
+#endif //INSATxGCS_CHAINSOCPSOLVER_HPP
@@ -0,0 +1,256 @@
+//  * Copyright (c) 2024, Ramkumar Natarajan
+//  * All rights reserved.
+//  *
+//  * Redistribution and use in source and binary forms, with or without
+//  * modification, are permitted provided that the following conditions are met:
+//  *
+//  *     * Redistributions of source code must retain the above copyright
+//  *       notice, this list of conditions and the following disclaimer.
+//  *     * Redistributions in binary form must reproduce the above copyright
+//  *       notice, this list of conditions and the following disclaimer in the
+//  *       documentation and/or other materials provided with the distribution.
+//  *     * Neither the name of the Carnegie Mellon University nor the names of its
+//  *       contributors may be used to endorse or promote products derived from
+//  *       this software without specific prior written permission.
+//  *
+//  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//  * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+//  * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//  * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//  * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//  * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  * POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*!
+ * \file GCSConicTemplate.hpp
+ * \author Ram Natarajan (rnataraj@cs.cmu.edu)
+ * \date 3/2/24
+*/
+
+#pragma once
+#ifndef INSATxGCS_GCSCONICTEMPLATE_HPP
+#define INSATxGCS_GCSCONICTEMPLATE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <drake/geometry/optimization/graph_of_convex_sets.h>
+#include <drake/solvers/mathematical_program.h>
+
+namespace ps {
+
+  /// Rows sum_k vals_[k] x[cols_[k]] with right hand side b_, in CSR
+  struct ConicRows {
+    std::vector<int> row_ptr_ = {0};
+    std::vector<int> cols_;
+    std::vector<double> vals_;
+    std::vector<double> b_;
+
+    int NumRows() const { return b_.size(); }
+
+    void AddRow(const std::vector<int>& cols, const std::vector<double>& vals, double b) {
+      cols_.insert(cols_.end(), cols.begin(), cols.end());
+      vals_.insert(vals_.end(), vals.begin(), vals.end());
+      row_ptr_.push_back(cols_.size());
+      b_.push_back(b);
+    }
+
+    /// Keeps the first num_rows rows
+    void Truncate(int num_rows) {
+      row_ptr_.resize(num_rows+1);
+      cols_.resize(row_ptr_.back());
+      vals_.resize(row_ptr_.back());
+      b_.resize(num_rows);
+    }
+
+    Eigen::SparseMatrix<double> ToSparse(int num_cols) const;
+  };
+
+  /// Conic problem in the standard form
+  ///     min c'x + c0  s.t.  A x = b,  G x + s = h,  s in R+^num_ineq x SOC(soc_dims[0]) x ...
+  /// The rows of A are eq_, those of G are ineq_ followed by soc_. Each kind of row is kept apart
+  /// so that the rows of a path vertex can be appended or dropped at the end of each.
+  struct ConicProblem {
+    int num_vars_ = 0;
+    std::vector<int> soc_dims_;
+
+    std::vector<double> c_;
+    double c0_ = 0;
+
+    ConicRows eq_;
+    ConicRows ineq_;
+    ConicRows soc_;
+
+    /// First column of each path vertex (its x comes first, then its auxiliary columns)
+    std::vector<int> col_offsets_;
+
+    /// Cone k compactly as z = soc_A_[k] x[cols] + b in SOC, where cols are
+    /// soc_cols_[soc_col_ptr_[k] .. soc_col_ptr_[k+1]). Only filled by GCSConicTemplate::Assemble.
+    /// The matrices belong to the template and stay valid until vertices are added or removed.
+    std::vector<const Eigen::MatrixXd*> soc_A_;
+    std::vector<int> soc_col_ptr_ = {0};
+    std::vector<int> soc_cols_;
+
+    /// Sizes before each vertex of the path the problem was assembled for, so that
+    /// GCSConicTemplate::Assemble only redoes the vertices after the common prefix of the next path
+    struct Stage {
+      int64_t vid_ = 0;
+      int num_vars_ = 0;
+      double c0_ = 0;
+      int num_eq_ = 0;
+      int num_ineq_ = 0;
+      int num_soc_rows_ = 0;
+      int num_socs_ = 0;
+    };
+    std::vector<Stage> stages_;
+    /// Template revision the stages were assembled from
+    uint64_t revision_ = 0;
+
+    int NumEq() const { return eq_.NumRows(); }
+    int NumIneq() const { return ineq_.NumRows(); }
+    int NumRows() const { return eq_.NumRows() + ineq_.NumRows() + soc_.NumRows(); }
+    Eigen::Map<const Eigen::VectorXd> C() const { return {c_.data(), num_vars_}; }
+  };
+
+  /// Per-vertex and per-edge costs/constraints lowered once into fixed sparse blocks, so that the
+  /// conic problem of a path is assembled by copying rows into a reused ConicProblem. A problem
+  /// keeps the part it shares with the previous path, so extending a path only copies the rows
+  /// of the new vertex and of the edge into it.
+  /// Vertices and edges added after Seal are the terminals of the current query. They are kept
+  /// apart from the regions and their rows are reclaimed once all terminals are removed.
+  class GCSConicTemplate {
+
+  public:
+
+    typedef drake::geometry::optimization::GraphOfConvexSets::Vertex Vertex;
+    typedef drake::geometry::optimization::GraphOfConvexSets::Edge Edge;
+    typedef drake::solvers::Binding<drake::solvers::Cost> CostBinding;
+    typedef drake::solvers::Binding<drake::solvers::Constraint> ConstraintBinding;
+
+    /// Compiles the vertex costs, constraints and point-in-set constraints.
+    /// Only linear costs and linear/Lorentz cone constraints are supported.
+    void AddVertex(const Vertex* v,
+                   const std::vector<CostBinding>& costs,
+                   const std::vector<ConstraintBinding>& constraints);
+
+    /// Compiles the edge constraints. They may only involve xu and xv.
+    void AddEdge(const Edge* e,
+                 const std::vector<ConstraintBinding>& constraints);
+
+    /// Ends the region part of the template
+    void Seal();
+
+    /// Drops the terminal and the edges into or out of it. Regions can not be removed.
+    void RemoveVertex(int64_t vid);
+
+    bool HasVertex(int64_t vid) const { return findVertex(vid) != nullptr; }
+
+    int NumX(int64_t vid) const { return findVertex(vid)->num_x_; }
+
+    /// Assembles the problem of the path (vertex ids) into prob. The vertices prob was last
+    /// assembled for that lead path as well are kept, the rest are dropped and copied in again.
+    void Assemble(const std::vector<int64_t>& path, ConicProblem& prob) const;
+
+  private:
+
+    /// Contiguous range of rows in the arena
+    struct RowRange {
+      int begin_ = 0;
+      int size_ = 0;
+    };
+
+    /// Second order cone on the block columns cols_ with the dense z = A_ x + b map
+    struct Cone {
+      std::vector<int> cols_;
+      Eigen::MatrixXd A_;
+    };
+
+    struct Block {
+      RowRange eq_;
+      RowRange ineq_;
+      RowRange soc_;
+      std::vector<int> soc_dims_;
+      std::vector<Cone> cones_;
+    };
+
+    struct VertexTemplate {
+      int num_x_ = 0;
+      int num_cols_ = 0;
+      Eigen::VectorXd c_;
+      double c0_ = 0;
+      Block block_;
+      /// (successor vertex id, index into edges_)
+      std::vector<std::pair<int64_t, int>> out_edges_;
+    };
+
+    struct EdgeTemplate {
+      /// Block columns below num_xu_ belong to u, the rest to v
+      int num_xu_ = 0;
+      Block block_;
+    };
+
+    struct TerminalEdge {
+      int64_t uid_;
+      int64_t vid_;
+      EdgeTemplate edge_;
+    };
+
+    /// Row of a block under construction
+    struct Row {
+      std::vector<int> cols_;
+      std::vector<double> vals_;
+      double rhs_;
+    };
+
+    void compileConstraints(const drake::solvers::MathematicalProgram& prog, Block& block);
+    void appendRow(const Eigen::Ref<const Eigen::RowVectorXd>& a, const std::vector<int>& col_map,
+                   double rhs, std::vector<Row>& rows) const;
+    RowRange commitRows(const std::vector<Row>& rows);
+    const VertexTemplate* findVertex(int64_t vid) const;
+    bool isRegion(int64_t vid) const {
+      return vid >= first_vid_ && vid < first_vid_ + static_cast<int64_t>(vertices_.size()) &&
+             vertices_[vid-first_vid_].num_cols_ > 0;
+    }
+    const EdgeTemplate& findEdge(int64_t uid, int64_t vid) const;
+    /// Drops the vertices of prob from the num_stages-th on
+    void popStages(int num_stages, ConicProblem& prob) const;
+    /// Appends vertex vid and the edge into it from the last vertex of prob
+    void pushStage(int64_t vid, ConicProblem& prob) const;
+    void copyRows(const RowRange& range, int u_offset, int num_xu, int v_offset, ConicRows& rows) const;
+    void copyCones(const Block& block, int u_offset, int num_xu, int v_offset, ConicProblem& prob) const;
+    void copyBlock(const Block& block, int u_offset, int num_xu, int v_offset, ConicProblem& prob) const;
+
+    /// Regions indexed by vertex id - first_vid_
+    int64_t first_vid_ = 0;
+    std::vector<VertexTemplate> vertices_;
+    std::vector<EdgeTemplate> edges_;
+
+    /// Changes on every added or removed vertex or edge, and differs between templates
+    uint64_t revision_ = nextRevision();
+    static uint64_t nextRevision();
+
+    /// Terminals with the edges into or out of them
+    bool sealed_ = false;
+    std::vector<std::pair<int64_t, VertexTemplate>> terminals_;
+    std::vector<TerminalEdge> terminal_edges_;
+    /// Arena size at Seal. Terminal rows start here.
+    int num_region_rows_ = 0;
+    int num_region_nnz_ = 0;
+
+    /// Flat CSR arena holding the rows of every block
+    std::vector<int> row_ptr_ = {0};
+    std::vector<int> cols_;
+    std::vector<double> vals_;
+    std::vector<double> rhs_;
+  };
+
+}
+
+#endif //INSATxGCS_GCSCONICTEMPLATE_HPP
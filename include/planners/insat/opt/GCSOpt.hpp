@@ -3,6 +3,7 @@
 #define INSATxGCS_OPT_HPP
 
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <optional>
 #include <string>
@@ -24,8 +25,15 @@
 #include <drake/solvers/solve.h>
 #include <drake/common/trajectories/trajectory.h>
 #include <drake/solvers/mosek_solver.h>
+#include <drake/solvers/ipopt_solver.h>
+#include <drake/solvers/clarabel_solver.h>
+#include <drake/solvers/scs_solver.h>
 
 #include <common/insat/InsatTypes.hpp>
+#include <common/CancellationToken.hpp>
+#include <planners/insat/opt/GCSConicTemplate.hpp>
+#include <planners/insat/opt/ChainSocpSolver.hpp>
+#include <planners/insat/opt/ShortestPolylineSolver.hpp>
 
 namespace ps {
 
@@ -53,17 +61,36 @@ namespace ps {
     std::vector< drake::solvers::Binding<drake::solvers::Constraint>> constraints_;
   };
 
+  /// Position space geometry of a vertex, computed once so that heuristics need no solves
+  struct GCSVertexGeometry {
+    /// Chebyshev center (the point itself for terminals)
+    Eigen::VectorXd center_;
+    /// Feasible point found by the set
+    Eigen::VectorXd feasible_point_;
+  };
+
+  /// Conic solver of the path programs. Only MOSEK needs a license. kChainSocp solves compiled
+  /// path problems with ChainSocpSolver and everything else (or what it fails on) with Clarabel.
+  enum class GCSSolverType {
+    kMosek = 0,
+    kClarabel = 1,
+    kScs = 2,
+    kChainSocp = 3
+  };
+
   class GCSOpt {
 
   public:
 
-    /// Sets up the GCS regions and edges
+    /// Sets up the GCS regions and edges. region_geometry, if given, is the GetRegionGeometry of
+    /// an optimizer over the same regions and saves solving for it again.
     GCSOpt(const std::vector<HPolyhedron>& regions,
            const std::vector<std::pair<int, int>>& edges_between_regions,
            int order, double h_min, double h_max,
            double path_length_weight, double time_weight,
            Eigen::VectorXd& vel_lb, Eigen::VectorXd& vel_ub,
-           bool verbose=false);
+           bool verbose=false,
+           std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry=nullptr);
 
     GCSOpt (const GCSOpt &)=default;
     GCSOpt & 	operator= (const GCSOpt &)=default;
@@ -97,19 +124,88 @@ namespace ps {
     std::pair<drake::trajectories::CompositeTrajectory<double>,
           drake::solvers::MathematicalProgramResult> Solve(std::vector<int>& path_ids);
 
+    /// Solve seeded from the trajectory of the parent path (path_vids without its last vertex).
+    /// Uses an interior point NLP solver that exploits the primal guess and falls back to the
+    /// conic solver. IPOPT's default linear solver (MUMPS) keeps process wide state and is not
+    /// thread safe, so planners only warm start when a single thread solves.
+    std::pair<drake::trajectories::CompositeTrajectory<double>,
+            drake::solvers::MathematicalProgramResult> WarmSolve(std::vector<VertexId>& path_vids,
+                                                                 const drake::trajectories::CompositeTrajectory<double>& parent_traj);
+
     double CalculateCost(std::pair<drake::trajectories::CompositeTrajectory<double>,
             drake::solvers::MathematicalProgramResult>& soln);
 
+    /// Arc length of traj. Exact for order 1 Bezier segments, Gauss-Legendre quadrature of the
+    /// speed for higher orders and other segment types. Does not allocate for Bezier segments.
+    static double PathLength(const drake::trajectories::CompositeTrajectory<double>& traj);
+
+    /// Lowers all vertex/edge bindings into a conic template used by Solve. Needs linear costs only.
+    void CompileConicTemplate();
+
+    void SetCompiledSolve(bool compiled) {
+      compiled_solve_ = compiled;
+    }
+
+    /// With order 1 and only the path length cost the path program is the shortest polyline
+    /// through the regions, which Solve hands to ShortestPolylineSolver unless this is off
+    void SetPolylineSolve(bool polyline) {
+      polyline_solve_ = polyline;
+    }
+
+    /// Throws if the solver is not part of the drake build. Choosing MOSEK checks out a license
+    /// that this optimizer and its copies hold on to, so solves do not check out their own.
+    void SetSolverType(GCSSolverType solver_type);
+
+    GCSSolverType GetSolverType() const {
+      return solver_type_;
+    }
+
+    /// Solves fail right away once token is cancelled, and the solvers get the time left until
+    /// its deadline as their time limit. NULL disables both.
+    void SetCancellationToken(const CancellationToken* token) {
+      cancel_token_ = token;
+    }
+
     const std::shared_ptr<drake::geometry::optimization::GraphOfConvexSets> GetGCS() const {
       return gcs_;
     }
 
-    const std::unordered_map<int64_t, GCSVertex*> GetVertexIdToVertexMap() const {
+    const std::unordered_map<int64_t, GCSVertex*>& GetVertexIdToVertexMap() const {
       return vertex_id_to_vertex_;
     }
 
+    /// Vertex id (id().get_value()-1) of the first region. Regions have consecutive ids.
+    int64_t GetRegionIdOffset() const {
+      return region_id_offset_;
+    }
+
+    /// Geometry of a region or terminal vertex
+    const GCSVertexGeometry& GetVertexGeometry(int64_t vid) const {
+      const int64_t region_id = vid - region_id_offset_;
+      if (region_id >= 0 && region_id < region_geometry_->size()) {
+        return (*region_geometry_)[region_id];
+      }
+      return terminal_geometry_.at(vid);
+    }
+
+    /// Geometry of the regions in region order, shared with copies and read only
+    std::shared_ptr<const std::vector<GCSVertexGeometry>> GetRegionGeometry() const {
+      return region_geometry_;
+    }
+
+    /// Distance from the feasible point of the vertex to point
+    double RepresentativeDistance(int64_t vid, const Eigen::VectorXd& point) const;
+
+    /// Removes the start and goal vertices (and their edges) from the graph. The regions and
+    /// their formulated bindings are kept for the next query.
     void CleanUp();
 
+    /// Forgets the start and goal without touching the graph. For copies sharing the graph.
+    void ReleaseTerminals();
+
+    /// Takes over the start and goal that other (a copy sharing the graph) added
+    void AdoptTerminals(const GCSOpt& other);
+
     //// TEMPORARY
     std::vector<drake::geometry::optimization::GraphOfConvexSets::Vertex*> GetVertices() const {
       return vertices_;
@@ -131,14 +227,47 @@ namespace ps {
     void addCosts(const GCSVertex* v);
     void addConstraints(const GCSVertex* v);
     void addConstraints(const GCSEdge* e);
+    void addEdge(GCSEdge* e);
+    EdgeId findEdge(int64_t uid, int64_t vid);
+    void buildPathProgram(drake::solvers::MathematicalProgram& prog,
+                          std::vector<VertexId>& path_vids,
+                          std::vector<EdgeId>& path_eids);
+    std::pair<drake::trajectories::CompositeTrajectory<double>,
+            drake::solvers::MathematicalProgramResult> solveProgram(drake::solvers::MathematicalProgram& prog,
+                                                                    std::vector<VertexId>& path_vids,
+                                                                    Eigen::VectorXd& initial_guess);
+    std::pair<drake::trajectories::CompositeTrajectory<double>,
+            drake::solvers::MathematicalProgramResult> extractTrajectory(const drake::solvers::MathematicalProgramResult& result,
+                                                                         std::vector<VertexId>& path_vids);
+    drake::trajectories::CompositeTrajectory<double> buildTrajectory(const std::vector<Eigen::VectorXd>& path_x) const;
+    std::pair<drake::trajectories::CompositeTrajectory<double>,
+            drake::solvers::MathematicalProgramResult> solveCompiled(std::vector<VertexId>& path_vids);
+    /// Nothing if the chain is not made of regions and terminals or the polyline solver fails
+    std::optional<std::pair<drake::trajectories::CompositeTrajectory<double>,
+            drake::solvers::MathematicalProgramResult>> solvePolyline(std::vector<VertexId>& path_vids);
+    void setWarmStart(drake::solvers::MathematicalProgram& prog,
+                      std::vector<VertexId>& path_vids,
+                      const drake::trajectories::CompositeTrajectory<double>& parent_traj);
+    void computeRegionGeometry(std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry);
+    GCSVertex* findRegionVertex(const Eigen::VectorXd& point) const;
+    void setupTerminalCostsAndConstraints(GCSVertex* v);
+    void rewriteForConvexSolver(int64_t vid);
+    void addTerminalGeometry(const GCSVertex* v, const Eigen::VectorXd& point);
     void setupCostsAndConstraints();
     virtual void formulateTimeCost();
     void formulatePathLengthCost();
     void formulatePathContinuityConstraint();
     virtual void formulateVelocityConstraint();
     void formulateCostsAndConstraints();
+    bool isCancelled() const;
+    /// Solver options bounding the solve by the deadline of the cancellation token
+    drake::solvers::SolverOptions solverOptions() const;
+    /// Solves prog with the selected conic solver
+    drake::solvers::MathematicalProgramResult solveConic(const drake::solvers::MathematicalProgram& prog,
+                                                         const std::optional<Eigen::VectorXd>& initial_guess) const;
 
     bool verbose_;
+    const CancellationToken* cancel_token_ = nullptr;
 
     /// Basics
     int order_;
@@ -152,12 +281,10 @@ namespace ps {
     std::shared_ptr<drake::geometry::optimization::GraphOfConvexSets> gcs_;
 
     /// Terminals
-    GCSVertex* start_vtx_;
-    GCSVertex* goal_vtx_;
-    std::vector<GCSVertex*>::iterator start_vit_;
-    std::vector<GCSVertex*>::iterator goal_vit_;
-    std::vector<GCSEdge*>::iterator start_eit_;
-    std::vector<GCSEdge*>::iterator goal_eit_;
+    GCSVertex* start_vtx_ = nullptr;
+    GCSVertex* goal_vtx_ = nullptr;
+    /// Set once the region bindings are formulated. Terminals added later get theirs on AddStart/AddGoal.
+    bool formulated_ = false;
 
     /// Variables
     drake::VectorX<drake::symbolic::Variable> u_h_;
@@ -202,8 +329,15 @@ namespace ps {
     std::unordered_map<int64_t, std::vector<CostBinding>> edge_id_to_cost_binding_;
     /// Dict for edge id to constraint binding
     std::unordered_map<int64_t, std::vector<ConstraintBinding>> edge_id_to_constraint_binding_;
-    /// Tracking slack variables
-    std::vector<drake::VectorX<drake::symbolic::Variable>> slack_vars_;
+    /// Dict for vertex id to outgoing edges
+    std::unordered_map<int64_t, std::vector<GCSEdge*>> vertex_id_to_out_edges_;
+
+    /// Vertex geometry. The region table is shared by copies.
+    int64_t region_id_offset_;
+    std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry_;
+    std::unordered_map<int64_t, GCSVertexGeometry> terminal_geometry_;
+    /// Dict for vertex id to the slack variables its costs were rewritten with
+    std::unordered_map<int64_t, std::vector<drake::VectorX<drake::symbolic::Variable>>> vertex_id_to_slack_vars_;
 
     /// Flags for enabling/disabling costs and constraints
     bool enable_time_cost_;
@@ -213,6 +347,21 @@ namespace ps {
     double time_weight_;
     Eigen::MatrixXd path_length_weight_;
 
+    /// Compiled solve. The template is shared by copies, the assembled problem is per instance
+    /// (so per thread) and keeps the vertices the next path starts with.
+    bool compiled_solve_;
+    std::shared_ptr<GCSConicTemplate> conic_template_;
+    ConicProblem conic_prob_;
+    ChainSocpSolver chain_solver_;
+
+    /// Polyline solve. polyline_chain_ is set when the formulated program is of that form.
+    bool polyline_solve_;
+    bool polyline_chain_ = false;
+    ShortestPolylineSolver polyline_solver_;
+
+    GCSSolverType solver_type_;
+    std::shared_ptr<drake::solvers::MosekSolver::License> mosek_license_;
+
   };
 }
 
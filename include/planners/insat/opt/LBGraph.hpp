@@ -37,8 +37,12 @@
 
 #include <planners/insat/opt/GCSOpt.hpp>
 #include <planners/insat/opt/GCSSmoothOpt.hpp>
+#include <planners/insat/opt/LBGraphFile.hpp>
 #include <common/Types.hpp>
 
+#include <atomic>
+#include <future>
+#include <limits>
 #include <sstream>
 #include <fstream>
 #include <queue>
@@ -81,81 +85,121 @@ namespace ps {
 //      std::unordered_map<std::pair<int, int>, std::vector<int>, hash_pair> entry_id_;
 //      std::unordered_map<std::pair<int, int>, std::vector<int>, hash_pair> exit_id_;
 
-// Serialization function
-          void serialize(std::string& fname)
+          /// Lays the maps out as the CSR arrays of the binary file
+          LBGraphCSR ToCSR() const
           {
-            std::ofstream outFile(fname);
-            if (!outFile.is_open())
+            LBGraphCSR csr;
+            int num_nodes = 0;
+            for (const auto &entry : new_id_to_state_)
             {
-              std::cerr << "Error opening file for writing: " << fname << std::endl;
-              return;
+              num_nodes = std::max(num_nodes, entry.first+1);
+              csr.state_dim_ = entry.second.size();
             }
-
-            // Serialize old_edge_to_new_id_
-            outFile << old_edge_to_new_id_.size() << "\n";
-            for (const auto &entry : old_edge_to_new_id_)
+            for (const auto &entry : lbg_adj_list_)
             {
-              outFile << entry.first.first << " " << entry.first.second << " " << entry.second.size();
+              num_nodes = std::max(num_nodes, entry.first+1);
               for (int value : entry.second)
               {
-                outFile << " " << value;
+                num_nodes = std::max(num_nodes, value+1);
               }
-              outFile << "\n";
             }
 
-            // Serialize old_id_to_new_id_
-            outFile << old_id_to_new_id_.size() << "\n";
-            for (const auto &entry : old_id_to_new_id_)
+            csr.states_.assign(static_cast<size_t>(num_nodes)*csr.state_dim_, 0.0);
+            for (const auto &entry : new_id_to_state_)
             {
-              outFile << entry.first << " " << entry.second.size();
-              for (int value : entry.second)
-              {
-                outFile << " " << value;
-              }
-              outFile << "\n";
+              std::copy(entry.second.begin(), entry.second.end(),
+                        csr.states_.begin() + static_cast<size_t>(entry.first)*csr.state_dim_);
             }
 
-            // Serialize new_id_to_state_
-            outFile << new_id_to_state_.size() << "\n";
-            for (const auto &entry : new_id_to_state_)
+            for (int u = 0; u < num_nodes; ++u)
             {
-              outFile << entry.first << " " << entry.second.size();
-              for (double value : entry.second)
+              auto it = lbg_adj_list_.find(u);
+              if (it != lbg_adj_list_.end())
               {
-                outFile << " " << value;
+                const auto &costs = lbg_adj_cost_list_.at(u);
+                csr.adj_ids_.insert(csr.adj_ids_.end(), it->second.begin(), it->second.end());
+                csr.adj_costs_.insert(csr.adj_costs_.end(), costs.begin(), costs.end());
               }
-              outFile << "\n";
+              csr.adj_offsets_.push_back(csr.adj_ids_.size());
             }
 
-            // Serialize lbg_adj_list_
-            outFile << lbg_adj_list_.size() << "\n";
-            for (const auto &entry : lbg_adj_list_)
+            std::vector<std::pair<int, int>> old_edges;
+            for (const auto &entry : old_edge_to_new_id_)
             {
-              outFile << entry.first << " " << entry.second.size();
-              for (int value : entry.second)
-              {
-                outFile << " " << value;
-              }
-              outFile << "\n";
+              old_edges.push_back(entry.first);
+            }
+            std::sort(old_edges.begin(), old_edges.end());
+            for (const auto &edge : old_edges)
+            {
+              const auto &ids = old_edge_to_new_id_.at(edge);
+              csr.old_edges_.push_back(edge.first);
+              csr.old_edges_.push_back(edge.second);
+              csr.old_edge_ids_.insert(csr.old_edge_ids_.end(), ids.begin(), ids.end());
+              csr.old_edge_offsets_.push_back(csr.old_edge_ids_.size());
             }
 
-            // Serialize lbg_adj_cost_list_
-            outFile << lbg_adj_cost_list_.size() << "\n";
-            for (const auto &entry : lbg_adj_cost_list_)
+            for (const auto &entry : old_id_to_new_id_)
+            {
+              csr.old_ids_.push_back(entry.first);
+            }
+            std::sort(csr.old_ids_.begin(), csr.old_ids_.end());
+            for (int old_id : csr.old_ids_)
+            {
+              const auto &ids = old_id_to_new_id_.at(old_id);
+              csr.old_id_ids_.insert(csr.old_id_ids_.end(), ids.begin(), ids.end());
+              csr.old_id_offsets_.push_back(csr.old_id_ids_.size());
+            }
+            return csr;
+          }
+
+          void FromView(const LBGraphView &view)
+          {
+            for (int u = 0; u < view.NumNodes(); ++u)
             {
-              outFile << entry.first << " " << entry.second.size();
-              for (double value : entry.second)
+              new_id_to_state_[u] = StateVarsType(view.State(u), view.State(u) + view.StateDim());
+              if (view.AdjEnd(u) > view.AdjBegin(u))
               {
-                outFile << " " << value;
+                lbg_adj_list_[u] = std::vector<int>(view.AdjIds() + view.AdjBegin(u), view.AdjIds() + view.AdjEnd(u));
+                lbg_adj_cost_list_[u] = std::vector<double>(view.AdjCosts() + view.AdjBegin(u), view.AdjCosts() + view.AdjEnd(u));
               }
-              outFile << "\n";
             }
+            for (size_t i = 0; i < view.NumOldEdges(); ++i)
+            {
+              old_edge_to_new_id_[{view.OldEdgeU(i), view.OldEdgeV(i)}] =
+                      std::vector<int>(view.OldEdgeIds() + view.OldEdgeBegin(i), view.OldEdgeIds() + view.OldEdgeEnd(i));
+            }
+            for (size_t i = 0; i < view.NumOldIds(); ++i)
+            {
+              old_id_to_new_id_[view.OldId(i)] =
+                      std::vector<int>(view.OldIdIds() + view.OldIdBegin(i), view.OldIdIds() + view.OldIdEnd(i));
+            }
+          }
 
-            outFile.close();
+// Serialization function
+          void serialize(std::string& fname)
+          {
+            ToCSR().Write(fname);
           }
 
 // Deserialization function
           void deserialize(std::string& fname)
+          {
+            if (LBGraphView::IsLBGFile(fname))
+            {
+              LBGraphView view;
+              if (!view.Open(fname))
+              {
+                std::cerr << "Corrupt or unsupported lower bound graph file: " << fname << std::endl;
+                return;
+              }
+              FromView(view);
+              return;
+            }
+            deserializeText(fname);
+          }
+
+// Deserialization of the legacy text format
+          void deserializeText(std::string& fname)
           {
             std::ifstream inFile(fname);
             if (!inFile.is_open())
@@ -260,6 +304,23 @@ namespace ps {
 
       };
 
+    /// Name of the file an LB graph with these parameters is saved to
+    static std::string FileName(const std::string& env_name,
+                                int order, int continuity,
+                                double path_length_weight, double time_weight,
+                                double h_min, double h_max, double hdot_min = 1e-6,
+                                bool smooth = false) {
+      return env_name +
+             "_o" + std::to_string(order) +
+             "_c" + std::to_string(continuity) +
+             "_pw" + std::to_string((int)path_length_weight) +
+             "_tw" + std::to_string((int)time_weight) +
+             "_hmin" + std::to_string((int)h_min) +
+             "_hmax" + std::to_string((int)h_max) +
+             "_hdmin" + std::to_string((int)hdot_min) +
+             "_sm" + std::to_string(smooth? 1: 0);
+    }
+
     LBGraph(std::string& env_name,
             const std::vector<HPolyhedron>& regions,
             const std::vector<std::pair<int, int>>& edges_between_regions,
@@ -269,7 +330,8 @@ namespace ps {
             double h_min, double h_max, double hdot_min = 1e-6,
             bool smooth = false,
             std::string lbg_dir = "",
-            bool verbose=false) : hpoly_regions_(regions),
+            bool verbose=false,
+            int num_threads=1) : hpoly_regions_(regions),
                                   edges_bw_regions_(edges_between_regions) {
 
       if (smooth){
@@ -284,15 +346,8 @@ namespace ps {
       }
 //      verbose = true;
 
-      data_.filename_ = env_name +
-                        "_o" + std::to_string(order) +
-                        "_c" + std::to_string(continuity) +
-                        "_pw" + std::to_string((int)path_length_weight) +
-                        "_tw" + std::to_string((int)time_weight) +
-                        "_hmin" + std::to_string((int)h_min) +
-                        "_hmax" + std::to_string((int)h_max) +
-                        "_hdmin" + std::to_string((int)hdot_min) +
-                        "_sm" + std::to_string(smooth? 1: 0);
+      data_.filename_ = FileName(env_name, order, continuity, path_length_weight, time_weight,
+                                 h_min, h_max, hdot_min, smooth);
 
       std::string filename = lbg_dir + data_.filename_;
       if (Load(filename)) {
@@ -327,13 +382,18 @@ namespace ps {
         }
       }
 
+      /// Solve the LB problem for each LB edge using the triplets. The triplets are independent,
+      /// so they are handed out to per-thread copies of the optimizer.
+      std::vector<LBEdgeSoln> lb_solns(lbg_opt_edges_.size());
+      solveLBEdges(lb_solns, num_threads, smooth);
+
       int new_id = 0;
-      /// Solve the LB problem for each LB edge using the triplets
       /// Save the edge if it is new or if the cost is lower
-      /// Update the map from old id to new id
-      for (auto& edge : lbg_opt_edges_) {
-        auto soln = gcs_->Solve(edge);
-        double cost = gcs_->CalculateCost(soln);
+      /// Update the map from old id to new id (in triplet order so ids do not depend on threading)
+      for (int i=0; i<lbg_opt_edges_.size(); ++i) {
+        auto& edge = lbg_opt_edges_[i];
+        auto& lb_soln = lb_solns[i];
+        double cost = lb_soln.cost_;
 
         int in_id = new_id++;
         int out_id = new_id++;
@@ -341,12 +401,8 @@ namespace ps {
         /// Save the edges with costs
         lb_edge_to_costs_[nz_lb_edge] = cost;
         /// Save the new id with states
-        auto p0 = soln.first.value(soln.first.start_time());
-        auto pF = soln.first.value(soln.first.end_time());
-        std::vector<double> _p0(p0.data(), p0.data() + p0.size());
-        std::vector<double> _pF(pF.data(), pF.data() + pF.size());
-        data_.new_id_to_state_[in_id] = _p0;
-        data_.new_id_to_state_[out_id] = _pF;
+        data_.new_id_to_state_[in_id] = std::move(lb_soln.p0_);
+        data_.new_id_to_state_[out_id] = std::move(lb_soln.pF_);
 
         /// this works
         data_.old_edge_to_new_id_[{edge[0], edge[1]}].push_back(in_id);
@@ -477,6 +533,41 @@ namespace ps {
       std::cout << "Degree: " << degree << std::endl;
     }
 
+    /// Cost and end points of the solve for one LB edge triplet
+    struct LBEdgeSoln {
+      double cost_;
+      std::vector<double> p0_;
+      std::vector<double> pF_;
+    };
+
+    void solveLBEdges(std::vector<LBEdgeSoln>& lb_solns, int num_threads, bool smooth) {
+      std::atomic<size_t> next_edge(0);
+      auto solve_loop = [&](std::shared_ptr<GCSOpt> opt) {
+        for (size_t i = next_edge++; i < lbg_opt_edges_.size(); i = next_edge++) {
+          auto edge = lbg_opt_edges_[i];
+          auto soln = opt->Solve(edge);
+          auto p0 = soln.first.value(soln.first.start_time());
+          auto pF = soln.first.value(soln.first.end_time());
+          lb_solns[i].cost_ = opt->CalculateCost(soln);
+          lb_solns[i].p0_.assign(p0.data(), p0.data() + p0.size());
+          lb_solns[i].pF_.assign(pF.data(), pF.data() + pF.size());
+        }
+      };
+
+      num_threads = std::max(1, std::min(num_threads, static_cast<int>(lbg_opt_edges_.size())));
+      std::vector<std::future<void>> futures;
+      for (int t=1; t<num_threads; ++t) {
+        std::shared_ptr<GCSOpt> opt = smooth?
+                std::make_shared<GCSSmoothOpt>(*std::dynamic_pointer_cast<GCSSmoothOpt>(gcs_)) :
+                std::make_shared<GCSOpt>(*gcs_);
+        futures.emplace_back(std::async(std::launch::async, solve_loop, opt));
+      }
+      solve_loop(gcs_);
+      for (auto& f : futures) {
+        f.get();
+      }
+    }
+
     std::vector<HPolyhedron> hpoly_regions_;
     std::vector<std::pair<int, int>> edges_bw_regions_;
     std::shared_ptr<GCSOpt> gcs_;
@@ -487,135 +578,266 @@ namespace ps {
     Data data_;
   };
 
-  class LBGSearch {
+  /// Indexed 4-ary min-heap over node ids keyed by their tentative distances. Distances, heap
+  /// positions and membership are stamped with a search epoch, so consecutive searches reuse
+  /// the storage without clearing it.
+  class LBGSearchWorkspace {
   public:
 
-    LBGSearch() {}
-    LBGSearch(std::string& lbg_file) {
-      data_.deserialize(lbg_file);
+    /// Starts a new search over node ids [0, num_nodes)
+    void Begin(size_t num_nodes) {
+      if (num_nodes > dist_.size()) {
+        dist_.resize(num_nodes);
+        pos_.resize(num_nodes);
+        stamp_.resize(num_nodes, 0);
+      }
+      if (++epoch_ == 0) {
+        std::fill(stamp_.begin(), stamp_.end(), 0);
+        epoch_ = 1;
+      }
+      heap_.clear();
     }
 
+    double Dist(int v) const {
+      return stamp_[v] == epoch_ ? dist_[v] : DINF;
+    }
 
-    std::map<int, double> Dijkstra(StateVarsType& start_state,
-                                             int gcs_start_id) {
+    /// Lowers the distance of v to d and (re)queues it. False if d is no improvement.
+    bool Relax(int v, double d) {
+      if (stamp_[v] != epoch_) {
+        stamp_[v] = epoch_;
+        dist_[v] = d;
+        pos_[v] = heap_.size();
+        heap_.push_back(v);
+        siftUp(pos_[v]);
+        return true;
+      }
+      if (d >= dist_[v]) {
+        return false;
+      }
+      dist_[v] = d;
+      if (pos_[v] != kClosed) {
+        siftUp(pos_[v]);
+      }
+      return true;
+    }
 
-      int start = 2*data_.new_id_to_state_.size();
-      VecDf e_start_state = Eigen::Map<VecDf, Eigen::Unaligned>(start_state.data(), start_state.size());
+    bool Empty() const { return heap_.empty(); }
+
+    int Pop() {
+      int v = heap_[0];
+      pos_[v] = kClosed;
+      int last = heap_.back();
+      heap_.pop_back();
+      if (!heap_.empty()) {
+        heap_[0] = last;
+        pos_[last] = 0;
+        siftDown(0);
+      }
+      return v;
+    }
+
+  private:
 
-      for (const auto& otn : data_.old_edge_to_new_id_) {
-        if (otn.first.first == gcs_start_id) {
-          for (const auto& c : otn.second) {
-            data_.lbg_adj_list_[start].push_back(c);
-            VecDf e_new_state = Eigen::Map<VecDf, Eigen::Unaligned>(data_.new_id_to_state_[c].data(), data_.new_id_to_state_[c].size());
-            double cost = (e_new_state - e_start_state).norm();
-            data_.lbg_adj_cost_list_[start].push_back(cost);
+    static constexpr int kArity = 4;
+    static constexpr uint32_t kClosed = std::numeric_limits<uint32_t>::max();
+
+    void siftUp(uint32_t i) {
+      int v = heap_[i];
+      while (i > 0) {
+        uint32_t parent = (i-1)/kArity;
+        if (dist_[heap_[parent]] <= dist_[v]) {
+          break;
+        }
+        heap_[i] = heap_[parent];
+        pos_[heap_[i]] = i;
+        i = parent;
+      }
+      heap_[i] = v;
+      pos_[v] = i;
+    }
+
+    void siftDown(uint32_t i) {
+      int v = heap_[i];
+      const uint32_t n = heap_.size();
+      while (true) {
+        uint32_t first = kArity*i + 1;
+        if (first >= n) {
+          break;
+        }
+        uint32_t best = first;
+        for (uint32_t c = first+1; c < std::min(first+kArity, n); ++c) {
+          if (dist_[heap_[c]] < dist_[heap_[best]]) {
+            best = c;
           }
         }
+        if (dist_[heap_[best]] >= dist_[v]) {
+          break;
+        }
+        heap_[i] = heap_[best];
+        pos_[heap_[i]] = i;
+        i = best;
       }
+      heap_[i] = v;
+      pos_[v] = i;
+    }
+
+    std::vector<double> dist_;
+    std::vector<uint32_t> pos_;
+    std::vector<uint32_t> stamp_;
+    uint32_t epoch_ = 0;
+    std::vector<int> heap_;
+  };
+
+  /// Searches over a lower bound graph file. Keeps a workspace, so an instance must not be
+  /// queried from several threads at once.
+  class LBGSearch {
+  public:
 
-      std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<std::pair<double, double>>> pq;
-      std::map<int, double> new_dist;
-      for (const auto& node : data_.lbg_adj_list_) {
-        new_dist[node.first] = DINF;
+    LBGSearch() {}
+    LBGSearch(std::string& lbg_file) {
+      if (!view_.Open(lbg_file)) {
+        /// Legacy text files are converted in memory
+        LBGraph::Data data;
+        data.deserialize(lbg_file);
+        view_.Adopt(data.ToCSR().Encode());
       }
+      buildVertexIndex();
+    }
 
-      new_dist[start] = 0.0;
-      pq.push({0.0, start});
+    /// Distances from start_state to every GCS vertex over the LB graph, indexed by GCS vertex
+    /// id (DINF if unreachable or unknown). The start is a virtual node connected to the LB nodes
+    /// on the edges leaving gcs_start_id; the graph is not modified. The returned reference is
+    /// valid until the next query.
+    const std::vector<double>& DijkstraDense(const StateVarsType& start_state,
+                                             int gcs_start_id) {
 
-      while (!pq.empty()) {
-        int u = pq.top().second;
-        int dist_u = pq.top().first;
-        pq.pop();
+      const int start = view_.NumNodes();
+      const int dim = view_.StateDim();
+      Eigen::Map<const VecDf> e_start_state(start_state.data(), start_state.size());
 
-        if (dist_u > new_dist[u]) {
-          continue; // Skip outdated entries in priority queue
-        }
+      ws_.Begin(view_.NumNodes()+1);
+      ws_.Relax(start, 0.0);
 
-        for (int i=0; i<data_.lbg_adj_list_.at(u).size(); ++i) {
-          int v = data_.lbg_adj_list_.at(u)[i];
-          double weight = data_.lbg_adj_cost_list_.at(u)[i];
+      while (!ws_.Empty()) {
+        int u = ws_.Pop();
+        double dist_u = ws_.Dist(u);
 
-          if (new_dist[u] + weight < new_dist[v]) {
-            new_dist[v] = new_dist[u] + weight;
-            pq.emplace(new_dist[v], v);
+        if (u == start) {
+          auto [first, last] = view_.OldEdgesFrom(gcs_start_id);
+          for (size_t e = first; e < last; ++e) {
+            for (uint64_t k = view_.OldEdgeBegin(e); k < view_.OldEdgeEnd(e); ++k) {
+              int v = view_.OldEdgeIds()[k];
+              ws_.Relax(v, dist_u + (Eigen::Map<const VecDf>(view_.State(v), dim) - e_start_state).norm());
+            }
           }
+          continue;
+        }
+
+        for (uint64_t k = view_.AdjBegin(u); k < view_.AdjEnd(u); ++k) {
+          ws_.Relax(view_.AdjIds()[k], dist_u + view_.AdjCosts()[k]);
         }
       }
 
-//      std::map<int, double> old_dist;
-//      for (const auto& otn : data_.old_edge_to_new_id_) {
-//        double d = DINF/2;
-//        for (const auto n : otn.second) {
-//          if (new_dist.find(n) != new_dist.end()) {
-//            if (new_dist[n] < d) {
-//              d = new_dist[n];
-//            }
-//          }
-//        }
-//        old_dist[otn.first.first] = d; /// @FIXME: Is this correct?
-//      }
+      gatherVertexDist(ws_, old_dist_);
+      return old_dist_;
+    }
 
-      std::map<int, double> old_dist;
-      for (const auto& id : data_.old_edge_to_new_id_) {
-        old_dist[id.first.first] = DINF;
-        old_dist[id.first.second] = DINF;
-      }
-      for (const auto& otn : data_.old_edge_to_new_id_) {
-        for (const auto n : otn.second) {
-          if (new_dist.find(n) != new_dist.end()) {
-            if (new_dist[n] < old_dist[otn.first.first]) {
-              old_dist[otn.first.first] = new_dist[n];
-            }
-            if (new_dist[n] < old_dist[otn.first.second]) {
-              old_dist[otn.first.second] = new_dist[n];
-            }
+    /// Distances from every GCS vertex to goal_state over the LB graph, indexed by GCS vertex id
+    /// (DINF if unreachable or unknown). Runs on the reversed graph from a virtual goal node
+    /// connected to the LB nodes on the edges of gcs_goal_id, which itself is at 0.
+    const std::vector<double>& ReverseDijkstraDense(const StateVarsType& goal_state,
+                                                    int gcs_goal_id) {
+      BuildReverseAdjacency();
+      ReverseDijkstraDense(goal_state, gcs_goal_id, ws_, old_dist_);
+      return old_dist_;
+    }
+
+    /// Same search with caller owned workspace and output, so that several threads can search
+    /// the same graph. Needs BuildReverseAdjacency to have run.
+    void ReverseDijkstraDense(const StateVarsType& goal_state, int gcs_goal_id,
+                              LBGSearchWorkspace& ws, std::vector<double>& dist) const {
+      if (rev_offsets_.empty()) {
+        throw std::runtime_error("Reverse adjacency of the LB graph is not built");
+      }
+
+      const int goal = view_.NumNodes();
+      const int dim = view_.StateDim();
+      const int num_old_ids = vertex_peg_offsets_.size()-1;
+      Eigen::Map<const VecDf> e_goal_state(goal_state.data(), goal_state.size());
+
+      ws.Begin(view_.NumNodes()+1);
+      ws.Relax(goal, 0.0);
+
+      while (!ws.Empty()) {
+        int v = ws.Pop();
+        double dist_v = ws.Dist(v);
+
+        if (v == goal) {
+          if (gcs_goal_id < 0 || gcs_goal_id >= num_old_ids) {
+            continue;
+          }
+          for (uint64_t k = vertex_peg_offsets_[gcs_goal_id]; k < vertex_peg_offsets_[gcs_goal_id+1]; ++k) {
+            int u = vertex_pegs_[k];
+            ws.Relax(u, dist_v + (Eigen::Map<const VecDf>(view_.State(u), dim) - e_goal_state).norm());
           }
+          continue;
+        }
+
+        for (uint64_t k = rev_offsets_[v]; k < rev_offsets_[v+1]; ++k) {
+          ws.Relax(rev_ids_[k], dist_v + rev_costs_[k]);
         }
       }
 
-//      std::map<int, double> old_dist;
-//      for (const auto& id : data_.old_id_to_new_id_) {
-//        old_dist[id.first] = DINF;
-//      }
-//      for (const auto& otn : data_.old_id_to_new_id_) {
-//        for (const auto n : otn.second) {
-//          if (new_dist.find(n) != new_dist.end()) {
-//            if (new_dist[n] < old_dist[otn.first]) {
-//              old_dist[otn.first] = new_dist[n];
-//            }
-//          }
-//        }
-//      }
+      gatherVertexDist(ws, dist);
+      if (gcs_goal_id >= 0 && gcs_goal_id < num_old_ids) {
+        dist[gcs_goal_id] = 0.0;
+      }
+    }
 
+    /// Transposes the adjacency of the view for the searches towards a goal. Runs once.
+    void BuildReverseAdjacency() {
+      if (rev_offsets_.empty()) {
+        buildReverseAdjacency();
+      }
+    }
+
+    std::map<int, double> Dijkstra(StateVarsType& start_state,
+                                   int gcs_start_id) {
+      const auto& dense_dist = DijkstraDense(start_state, gcs_start_id);
+      std::map<int, double> old_dist;
+      for (int old_id = 0; old_id < dense_dist.size(); ++old_id) {
+        if (vertex_peg_offsets_[old_id+1] > vertex_peg_offsets_[old_id]) {
+          old_dist[old_id] = dense_dist[old_id];
+        }
+      }
       return old_dist;
     }
 
     int FindNumConnectedComponents() {
-      const auto& graph = data_.lbg_adj_list_;
-      std::unordered_set<int> visited;
+      std::vector<bool> visited(view_.NumNodes(), false);
       int components = 0;
 
-      for (const auto& pair : graph) {
-        int node = pair.first;
-
-        if (visited.find(node) == visited.end()) {
-          // Start a new traversal from an unvisited node
-          components++;
-          std::stack<int> stack;
-          stack.push(node);
-
-          while (!stack.empty()) {
-            int current = stack.top();
-            stack.pop();
-
-            if (visited.find(current) == visited.end()) {
-              visited.insert(current);
-
-              // Add unvisited neighbors to the stack
-              for (int neighbor : graph.at(current)) {
-                if (visited.find(neighbor) == visited.end()) {
-                  stack.push(neighbor);
-                }
+      for (int node = 0; node < view_.NumNodes(); ++node) {
+        if (view_.AdjEnd(node) == view_.AdjBegin(node) || visited[node]) {
+          continue;
+        }
+        // Start a new traversal from an unvisited node
+        components++;
+        std::stack<int> stack;
+        stack.push(node);
+
+        while (!stack.empty()) {
+          int current = stack.top();
+          stack.pop();
+
+          if (!visited[current]) {
+            visited[current] = true;
+
+            // Add unvisited neighbors to the stack
+            for (uint64_t k = view_.AdjBegin(current); k < view_.AdjEnd(current); ++k) {
+              if (!visited[view_.AdjIds()[k]]) {
+                stack.push(view_.AdjIds()[k]);
               }
             }
           }
@@ -625,33 +847,132 @@ namespace ps {
       return components;
     }
 
+    int countConnectedComponents() {
+      return FindNumConnectedComponents();
+    }
+
+    const LBGraphView& GetView() const {
+      return view_;
+    }
 
-    void DFSUtil(std::unordered_map<int, std::vector<int>>& graph, int vertex, std::vector<bool>& visited) {
-      visited[vertex] = true;
-      for (int neighbor : graph[vertex]) {
-        if (!visited[neighbor]) {
-          DFSUtil(graph, neighbor, visited);
+  protected:
+
+    /// Collects, per GCS vertex, the LB nodes on the GCS edges touching it
+    void buildVertexIndex() {
+      int num_old_ids = 0;
+      for (size_t e = 0; e < view_.NumOldEdges(); ++e) {
+        num_old_ids = std::max(num_old_ids, std::max(view_.OldEdgeU(e), view_.OldEdgeV(e))+1);
+      }
+      vertex_peg_offsets_.assign(num_old_ids+1, 0);
+      for (size_t e = 0; e < view_.NumOldEdges(); ++e) {
+        const uint64_t num_pegs = view_.OldEdgeEnd(e) - view_.OldEdgeBegin(e);
+        vertex_peg_offsets_[view_.OldEdgeU(e)+1] += num_pegs;
+        vertex_peg_offsets_[view_.OldEdgeV(e)+1] += num_pegs;
+      }
+      for (int i = 0; i < num_old_ids; ++i) {
+        vertex_peg_offsets_[i+1] += vertex_peg_offsets_[i];
+      }
+      vertex_pegs_.resize(vertex_peg_offsets_.back());
+      std::vector<uint64_t> fill(vertex_peg_offsets_.begin(), vertex_peg_offsets_.end()-1);
+      for (size_t e = 0; e < view_.NumOldEdges(); ++e) {
+        for (uint64_t k = view_.OldEdgeBegin(e); k < view_.OldEdgeEnd(e); ++k) {
+          vertex_pegs_[fill[view_.OldEdgeU(e)]++] = view_.OldEdgeIds()[k];
+          vertex_pegs_[fill[view_.OldEdgeV(e)]++] = view_.OldEdgeIds()[k];
         }
       }
+      old_dist_.assign(num_old_ids, DINF);
     }
 
-    int countConnectedComponents() {
-      auto& graph = data_.lbg_adj_list_;
-      int numComponents = 0;
-      int numVertices = graph.size();
-      std::vector<bool> visited(numVertices, false);
-
-      for (auto& vertex : graph) {
-        if (!visited[vertex.first]) {
-          DFSUtil(graph, vertex.first, visited);
-          numComponents++;
+    /// Transposes the adjacency of the view for the searches towards a goal
+    void buildReverseAdjacency() {
+      const int num_nodes = view_.NumNodes();
+      rev_offsets_.assign(num_nodes+1, 0);
+      for (int u = 0; u < num_nodes; ++u) {
+        for (uint64_t k = view_.AdjBegin(u); k < view_.AdjEnd(u); ++k) {
+          ++rev_offsets_[view_.AdjIds()[k]+1];
+        }
+      }
+      for (int v = 0; v < num_nodes; ++v) {
+        rev_offsets_[v+1] += rev_offsets_[v];
+      }
+      rev_ids_.resize(rev_offsets_.back());
+      rev_costs_.resize(rev_offsets_.back());
+      std::vector<uint64_t> fill(rev_offsets_.begin(), rev_offsets_.end()-1);
+      for (int u = 0; u < num_nodes; ++u) {
+        for (uint64_t k = view_.AdjBegin(u); k < view_.AdjEnd(u); ++k) {
+          uint64_t slot = fill[view_.AdjIds()[k]]++;
+          rev_ids_[slot] = u;
+          rev_costs_[slot] = view_.AdjCosts()[k];
+        }
+      }
+    }
+
+    /// A GCS vertex is as far as the closest LB node on any of its edges
+    void gatherVertexDist(const LBGSearchWorkspace& ws, std::vector<double>& dist) const {
+      dist.resize(vertex_peg_offsets_.size()-1);
+      for (int old_id = 0; old_id < dist.size(); ++old_id) {
+        double d = DINF;
+        for (uint64_t k = vertex_peg_offsets_[old_id]; k < vertex_peg_offsets_[old_id+1]; ++k) {
+          d = std::min(d, ws.Dist(vertex_pegs_[k]));
         }
+        dist[old_id] = d;
       }
+    }
+
+    LBGraphView view_;
+    LBGSearchWorkspace ws_;
+
+    std::vector<uint64_t> vertex_peg_offsets_;
+    std::vector<int> vertex_pegs_;
+    std::vector<double> old_dist_;
+
+    std::vector<uint64_t> rev_offsets_;
+    std::vector<int> rev_ids_;
+    std::vector<double> rev_costs_;
+
+  };
+
+  /// Cost-to-go lower bounds of the GCS regions from one backward LB graph search per goal,
+  /// looked up in O(1) by planner state id.
+  class LBGHeuristic {
+  public:
+
+    LBGHeuristic(std::string& lbg_file) : LBGHeuristic(std::make_shared<LBGSearch>(lbg_file)) {}
 
-      return numComponents;
+    /// Shares the graph of search with other heuristics. Each instance keeps its own workspace
+    /// and table, so heuristics of concurrent queries can set their goals in parallel.
+    LBGHeuristic(std::shared_ptr<LBGSearch> search) : search_(std::move(search)) {
+      search_->BuildReverseAdjacency();
     }
 
-    LBGraph::Data data_;
+    /// Searches back from goal_state lying in region gcs_goal_id. Planner state ids are
+    /// region_id_offset ahead of the region ids of the LB graph.
+    void SetGoal(const StateVarsType& goal_state, int gcs_goal_id, int64_t region_id_offset=0) {
+      search_->ReverseDijkstraDense(goal_state, gcs_goal_id, ws_, h_);
+      region_id_offset_ = region_id_offset;
+    }
+
+    /// DINF if the LB graph has no bound for the state
+    double operator()(int64_t state_id) const {
+      int64_t region_id = state_id - region_id_offset_;
+      return (region_id >= 0 && region_id < h_.size())? h_[region_id] : DINF;
+    }
+
+    /// Indexed by region id
+    const std::vector<double>& GetTable() const {
+      return h_;
+    }
+
+    const std::shared_ptr<LBGSearch>& GetSearch() const {
+      return search_;
+    }
+
+  private:
+
+    std::shared_ptr<LBGSearch> search_;
+    LBGSearchWorkspace ws_;
+    std::vector<double> h_;
+    int64_t region_id_offset_ = 0;
 
   };
 
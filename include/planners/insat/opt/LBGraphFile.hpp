@@ -0,0 +1,349 @@
+//  * Copyright (c) 2024, Ramkumar Natarajan
+//  * All rights reserved.
+//  *
+//  * Redistribution and use in source and binary forms, with or without
+//  * modification, are permitted provided that the following conditions are met:
+//  *
+//  *     * Redistributions of source code must retain the above copyright
+//  *       notice, this list of conditions and the following disclaimer.
+//  *     * Redistributions in binary form must reproduce the above copyright
+//  *       notice, this list of conditions and the following disclaimer in the
+//  *       documentation and/or other materials provided with the distribution.
+//  *     * Neither the name of the Carnegie Mellon University nor the names of its
+//  *       contributors may be used to endorse or promote products derived from
+//  *       this software without specific prior written permission.
+//  *
+//  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//  * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+//  * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//  * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//  * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//  * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  * POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*!
+ * \file LBGraphFile.hpp
+ * \author Ram Natarajan (rnataraj@cs.cmu.edu)
+ * \date 3/9/24
+*/
+
+#ifndef IXG_LBGRAPHFILE_HPP
+#define IXG_LBGRAPHFILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ps {
+
+  /// Binary lower bound graph file. A fixed header followed by 8-byte aligned sections:
+  ///   adj_offsets      uint64[num_nodes+1]    CSR row offsets of the LB graph
+  ///   adj_ids          int32[num_edges]       neighbor ids
+  ///   adj_costs        double[num_edges]      edge costs
+  ///   states           double[num_nodes*dim]  node states, row major
+  ///   old_edges        int32[2*num_old_edges] GCS edges (u, v), sorted
+  ///   old_edge_offsets uint64[num_old_edges+1]
+  ///   old_edge_ids     int32[]                LB node ids on each GCS edge
+  ///   old_ids          int32[num_old_ids]     GCS vertex ids, sorted
+  ///   old_id_offsets   uint64[num_old_ids+1]
+  ///   old_id_ids       int32[]                LB node ids inside each GCS vertex
+  /// Numbers are in host byte order.
+  struct LBGFileHeader {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t state_dim_;
+    uint64_t num_nodes_;
+    uint64_t num_edges_;
+    uint64_t num_old_edges_;
+    uint64_t num_old_ids_;
+    uint64_t section_offsets_[10];
+    uint64_t file_size_;
+  };
+
+  constexpr char kLBGMagic[8] = {'I', 'X', 'G', 'L', 'B', 'G', '\0', '\0'};
+  constexpr uint32_t kLBGVersion = 1;
+
+  /// CSR arrays of a lower bound graph in the order they are laid out in the file
+  struct LBGraphCSR {
+    uint32_t state_dim_ = 0;
+    std::vector<uint64_t> adj_offsets_ = {0};
+    std::vector<int32_t> adj_ids_;
+    std::vector<double> adj_costs_;
+    std::vector<double> states_;
+    std::vector<int32_t> old_edges_;
+    std::vector<uint64_t> old_edge_offsets_ = {0};
+    std::vector<int32_t> old_edge_ids_;
+    std::vector<int32_t> old_ids_;
+    std::vector<uint64_t> old_id_offsets_ = {0};
+    std::vector<int32_t> old_id_ids_;
+
+    std::vector<char> Encode() const {
+      LBGFileHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic_, kLBGMagic, sizeof(kLBGMagic));
+      header.version_ = kLBGVersion;
+      header.state_dim_ = state_dim_;
+      header.num_nodes_ = adj_offsets_.size()-1;
+      header.num_edges_ = adj_ids_.size();
+      header.num_old_edges_ = old_edge_offsets_.size()-1;
+      header.num_old_ids_ = old_ids_.size();
+
+      const std::pair<const void*, size_t> sections[10] = {
+              {adj_offsets_.data(), adj_offsets_.size()*sizeof(uint64_t)},
+              {adj_ids_.data(), adj_ids_.size()*sizeof(int32_t)},
+              {adj_costs_.data(), adj_costs_.size()*sizeof(double)},
+              {states_.data(), states_.size()*sizeof(double)},
+              {old_edges_.data(), old_edges_.size()*sizeof(int32_t)},
+              {old_edge_offsets_.data(), old_edge_offsets_.size()*sizeof(uint64_t)},
+              {old_edge_ids_.data(), old_edge_ids_.size()*sizeof(int32_t)},
+              {old_ids_.data(), old_ids_.size()*sizeof(int32_t)},
+              {old_id_offsets_.data(), old_id_offsets_.size()*sizeof(uint64_t)},
+              {old_id_ids_.data(), old_id_ids_.size()*sizeof(int32_t)}};
+
+      uint64_t offset = sizeof(LBGFileHeader);
+      for (int i=0; i<10; ++i) {
+        offset = (offset + 7) & ~uint64_t(7);
+        header.section_offsets_[i] = offset;
+        offset += sections[i].second;
+      }
+      header.file_size_ = offset;
+
+      std::vector<char> buffer(header.file_size_, 0);
+      std::memcpy(buffer.data(), &header, sizeof(header));
+      for (int i=0; i<10; ++i) {
+        if (sections[i].second > 0) {
+          std::memcpy(buffer.data() + header.section_offsets_[i], sections[i].first, sections[i].second);
+        }
+      }
+      return buffer;
+    }
+
+    bool Write(const std::string& fname) const {
+      std::ofstream out_file(fname, std::ios::binary | std::ios::trunc);
+      if (!out_file.is_open()) {
+        std::cerr << "Error opening file for writing: " << fname << std::endl;
+        return false;
+      }
+      auto buffer = Encode();
+      out_file.write(buffer.data(), buffer.size());
+      return out_file.good();
+    }
+  };
+
+  /// Read-only view of a binary lower bound graph. Files are mmap'd and used in place.
+  class LBGraphView {
+  public:
+
+    LBGraphView() {}
+    ~LBGraphView() { release(); }
+
+    LBGraphView(const LBGraphView&)=delete;
+    LBGraphView& operator=(const LBGraphView&)=delete;
+
+    /// False if the file is missing, not a binary LBG file of this version, or its sections,
+    /// offsets or node ids are out of bounds
+    bool Open(const std::string& fname) {
+      release();
+      int fd = ::open(fname.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return false;
+      }
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(LBGFileHeader)) {
+        ::close(fd);
+        return false;
+      }
+      void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED) {
+        return false;
+      }
+      map_addr_ = addr;
+      map_size_ = st.st_size;
+      if (!bind(static_cast<const char*>(addr), map_size_)) {
+        release();
+        return false;
+      }
+      return true;
+    }
+
+    /// Takes over an in-memory encoding (e.g. converted from a legacy text file)
+    bool Adopt(std::vector<char> buffer) {
+      release();
+      owned_ = std::move(buffer);
+      if (!bind(owned_.data(), owned_.size())) {
+        release();
+        return false;
+      }
+      return true;
+    }
+
+    static bool IsLBGFile(const std::string& fname) {
+      std::ifstream in_file(fname, std::ios::binary);
+      char magic[sizeof(kLBGMagic)];
+      return in_file.read(magic, sizeof(magic)) && std::memcmp(magic, kLBGMagic, sizeof(magic)) == 0;
+    }
+
+    bool IsOpen() const { return header_ != nullptr; }
+    size_t NumNodes() const { return header_->num_nodes_; }
+    size_t NumEdges() const { return header_->num_edges_; }
+    int StateDim() const { return header_->state_dim_; }
+
+    /// Out edges of u are [AdjBegin(u), AdjEnd(u)) into AdjIds/AdjCosts
+    uint64_t AdjBegin(int u) const { return adj_offsets_[u]; }
+    uint64_t AdjEnd(int u) const { return adj_offsets_[u+1]; }
+    const int32_t* AdjIds() const { return adj_ids_; }
+    const double* AdjCosts() const { return adj_costs_; }
+    const double* State(int id) const { return states_ + static_cast<size_t>(id)*header_->state_dim_; }
+
+    size_t NumOldEdges() const { return header_->num_old_edges_; }
+    int OldEdgeU(size_t i) const { return old_edges_[2*i]; }
+    int OldEdgeV(size_t i) const { return old_edges_[2*i+1]; }
+    uint64_t OldEdgeBegin(size_t i) const { return old_edge_offsets_[i]; }
+    uint64_t OldEdgeEnd(size_t i) const { return old_edge_offsets_[i+1]; }
+    const int32_t* OldEdgeIds() const { return old_edge_ids_; }
+
+    /// Range [first, last) of GCS edges leaving GCS vertex u
+    std::pair<size_t, size_t> OldEdgesFrom(int u) const {
+      size_t lo = 0, hi = NumOldEdges();
+      while (lo < hi) {
+        size_t mid = (lo + hi)/2;
+        if (OldEdgeU(mid) < u) { lo = mid+1; } else { hi = mid; }
+      }
+      size_t first = lo;
+      hi = NumOldEdges();
+      while (lo < hi) {
+        size_t mid = (lo + hi)/2;
+        if (OldEdgeU(mid) <= u) { lo = mid+1; } else { hi = mid; }
+      }
+      return {first, lo};
+    }
+
+    size_t NumOldIds() const { return header_->num_old_ids_; }
+    int OldId(size_t i) const { return old_ids_[i]; }
+    uint64_t OldIdBegin(size_t i) const { return old_id_offsets_[i]; }
+    uint64_t OldIdEnd(size_t i) const { return old_id_offsets_[i+1]; }
+    const int32_t* OldIdIds() const { return old_id_ids_; }
+
+  private:
+
+    /// count is checked against the bytes left after the section offset by division, so that
+    /// corrupt counts can not overflow
+    template <typename T>
+    bool section(const char* base, size_t size, int idx, uint64_t count, const T*& ptr) const {
+      const uint64_t off = header_->section_offsets_[idx];
+      if (off % alignof(T) != 0 || off > size || count > (size - off)/sizeof(T)) {
+        return false;
+      }
+      ptr = reinterpret_cast<const T*>(base + off);
+      return true;
+    }
+
+    /// CSR offsets start at 0, never decrease and end at total
+    static bool offsetsValid(const uint64_t* offsets, uint64_t num_rows, uint64_t total) {
+      if (offsets[0] != 0 || offsets[num_rows] != total) {
+        return false;
+      }
+      for (uint64_t i=0; i<num_rows; ++i) {
+        if (offsets[i] > offsets[i+1]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /// Node ids are indices into the states
+    static bool idsValid(const int32_t* ids, uint64_t count, uint64_t num_nodes) {
+      for (uint64_t i=0; i<count; ++i) {
+        if (ids[i] < 0 || static_cast<uint64_t>(ids[i]) >= num_nodes) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool bind(const char* base, size_t size) {
+      if (size < sizeof(LBGFileHeader)) {
+        return false;
+      }
+      header_ = reinterpret_cast<const LBGFileHeader*>(base);
+      if (std::memcmp(header_->magic_, kLBGMagic, sizeof(kLBGMagic)) != 0 ||
+          header_->version_ != kLBGVersion || header_->file_size_ > size) {
+        header_ = nullptr;
+        return false;
+      }
+      /// Every count below is bounded by the file size first, so the sums and products that
+      /// follow can not overflow
+      const uint64_t num_nodes = header_->num_nodes_;
+      const uint64_t num_edges = header_->num_edges_;
+      const uint64_t num_old_edges = header_->num_old_edges_;
+      const uint64_t num_old_ids = header_->num_old_ids_;
+      const uint64_t state_dim = header_->state_dim_;
+      bool ok = num_nodes < size && num_old_edges < size && num_old_ids < size &&
+                (state_dim == 0 || num_nodes <= size/(state_dim*sizeof(double))) &&
+                section(base, size, 0, num_nodes+1, adj_offsets_) &&
+                section(base, size, 1, num_edges, adj_ids_) &&
+                section(base, size, 2, num_edges, adj_costs_) &&
+                section(base, size, 3, num_nodes*state_dim, states_) &&
+                section(base, size, 4, 2*num_old_edges, old_edges_) &&
+                section(base, size, 5, num_old_edges+1, old_edge_offsets_) &&
+                section(base, size, 7, num_old_ids, old_ids_) &&
+                section(base, size, 8, num_old_ids+1, old_id_offsets_);
+      ok = ok && section(base, size, 6, old_edge_offsets_[num_old_edges], old_edge_ids_) &&
+                 section(base, size, 9, old_id_offsets_[num_old_ids], old_id_ids_) &&
+                 offsetsValid(adj_offsets_, num_nodes, num_edges) &&
+                 offsetsValid(old_edge_offsets_, num_old_edges, old_edge_offsets_[num_old_edges]) &&
+                 offsetsValid(old_id_offsets_, num_old_ids, old_id_offsets_[num_old_ids]) &&
+                 idsValid(adj_ids_, num_edges, num_nodes) &&
+                 idsValid(old_edge_ids_, old_edge_offsets_[num_old_edges], num_nodes) &&
+                 idsValid(old_id_ids_, old_id_offsets_[num_old_ids], num_nodes);
+      if (!ok) {
+        header_ = nullptr;
+      }
+      return ok;
+    }
+
+    void release() {
+      if (map_addr_) {
+        ::munmap(map_addr_, map_size_);
+        map_addr_ = nullptr;
+        map_size_ = 0;
+      }
+      owned_.clear();
+      header_ = nullptr;
+    }
+
+    void* map_addr_ = nullptr;
+    size_t map_size_ = 0;
+    std::vector<char> owned_;
+
+    const LBGFileHeader* header_ = nullptr;
+    const uint64_t* adj_offsets_ = nullptr;
+    const int32_t* adj_ids_ = nullptr;
+    const double* adj_costs_ = nullptr;
+    const double* states_ = nullptr;
+    const int32_t* old_edges_ = nullptr;
+    const uint64_t* old_edge_offsets_ = nullptr;
+    const int32_t* old_edge_ids_ = nullptr;
+    const int32_t* old_ids_ = nullptr;
+    const uint64_t* old_id_offsets_ = nullptr;
+    const int32_t* old_id_ids_ = nullptr;
+  };
+
+}
+
+#endif //IXG_LBGRAPHFILE_HPP
@@ -0,0 +1,88 @@
+/*!
+ * \file ShortestPolylineSolver.hpp
+ * \brief Shortest polyline through a chain of polytopes
+*/
+
+#pragma once
+#ifndef INSATxGCS_SHORTESTPOLYLINESOLVER_HPP
+#define INSATxGCS_SHORTESTPOLYLINESOLVER_HPP
+
+#include <vector>
+#include <limits>
+#include <Eigen/Dense>
+#include <planners/insat/opt/GCSConicTemplate.hpp>
+#include <planners/insat/opt/ChainSocpSolver.hpp>
+
+namespace ps {
+
+  /// Minimum length polyline q_0 ... q_N whose segment [q_i, q_i+1] lies in the i-th set of a
+  /// chain of polytopes and points. This is the path program of GCSOpt for order 1 without time
+  /// cost, written over the shared waypoints instead of per-vertex control points. A straight
+  /// line between fixed ends is found in closed form, everything else is solved as a waypoint
+  /// SOCP with ChainSocpSolver.
+  class ShortestPolylineSolver {
+
+  public:
+
+    enum class Status {
+      kSolved,
+      kInfeasible,
+      kTimeLimit,
+      kFailed
+    };
+
+    /// Clears the chain. Sets passed to AddPolytope/AddPoint are referenced until the next Reset.
+    void Reset(int num_positions);
+
+    /// Appends a set {p : A p <= b}
+    void AddPolytope(const Eigen::MatrixXd& A, const Eigen::VectorXd& b);
+
+    /// Appends a set holding only point
+    void AddPoint(const Eigen::VectorXd& point);
+
+    /// Minimizes weight times the length of the polyline
+    Status Solve(double weight, double time_limit = std::numeric_limits<double>::infinity());
+
+    /// Waypoints of the last solve as columns, segment i goes from column i to column i+1
+    const Eigen::MatrixXd& GetWaypoints() const { return waypoints_; }
+    double GetCost() const { return cost_; }
+    bool SolvedInClosedForm() const { return closed_form_; }
+    int GetIterations() const { return socp_.GetIterations(); }
+
+  private:
+
+    struct ChainSet {
+      const Eigen::MatrixXd* A_ = nullptr;
+      const Eigen::VectorXd* b_ = nullptr;
+      const Eigen::VectorXd* point_ = nullptr;
+    };
+
+    /// Fixes the waypoints that touch a point set. False if two of those points disagree.
+    bool fixWaypoints();
+    /// Places the waypoints on the segment between fixed q_0 and q_N if that is feasible
+    bool solveStraightLine();
+    /// Narrows [lo, hi] to the s with origin + s dir in set. False if that is empty.
+    bool lineInterval(const ChainSet& set, const Eigen::VectorXd& origin, const Eigen::VectorXd& dir,
+                      double& lo, double& hi) const;
+    bool contains(const ChainSet& set, const Eigen::VectorXd& p) const;
+    /// Waypoint SOCP: block i holds q_i and the length t_i of the segment leaving q_i. Keeping
+    /// t_i in the block that owns its cone keeps the diagonal blocks nonsingular.
+    void assemble(double weight);
+
+    int num_positions_ = 0;
+    std::vector<ChainSet> sets_;
+    /// Index of the point set fixing each waypoint, -1 if free
+    std::vector<int> fixed_;
+
+    ConicProblem prob_;
+    ChainSocpSolver socp_;
+
+    Eigen::MatrixXd waypoints_;
+    Eigen::VectorXd dir_;
+    double cost_ = 0;
+    bool closed_form_ = false;
+  };
+
+}
+
+#endif //INSATxGCS_SHORTESTPOLYLINESOLVER_HPP
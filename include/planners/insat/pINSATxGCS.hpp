@@ -5,6 +5,7 @@
 #include <utility>
 #include <planners/GepasePlanner.hpp>
 #include <planners/insat/INSATxGCS.hpp>
+#include <planners/insat/IndependenceChecker.hpp>
 #include <common/insat/InsatState.hpp>
 #include <common/insat/InsatEdge.hpp>
 
@@ -23,17 +24,39 @@ namespace ps
 
   protected:
     void initialize();
-    void expandEdgeLoop(int thread_id);
     void expand(InsatEdgePtrType edge_ptr, int thread_id);
     void expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id);
+    void finishSuccessor(InsatStatePtrType state_ptr, int thread_id);
+    void releaseBeingExpanded(InsatStatePtrType state_ptr, int thread_id);
     void exit();
 
+    /// Locks the mutex and charges the wait to the thread's lock time
+    std::unique_lock<LockType> acquire(LockType& lock, int thread_id);
+    /// Stripe guarding the g-value, heuristic, incoming edges and visited flag of the state
+    LockType& stateLock(const InsatStatePtrType& state_ptr);
+
     EdgeQueueMinType edge_open_list_;
     BEType being_expanded_states_;
 
-    std::vector<InsatEdgePtrType> edge_expansion_vec_;
     InsatActionPtrType dummy_action_ptr_;
 
+    IndependenceChecker independence_checker_;
+    std::vector<StatePtrType> independence_states_;
+
+    /// lock_ only guards edge_open_list_, being_expanded_states_ and h_val_min_. States and edges
+    /// are looked up in concurrent maps. A state lock is taken before lock_ when both are needed,
+    /// also by the main thread when it closes a state.
+    std::vector<LockType> state_locks_;
+
+    /// Per-thread statistics, merged into planner_stats_ on exit
+    struct alignas(64) ThreadStats
+    {
+      double lock_time_ = 0;
+      double expansions_time_ = 0;
+      int num_evaluated_edges_ = 0;
+    };
+    std::vector<ThreadStats> thread_stats_;
+
 
   };
 
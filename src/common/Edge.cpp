@@ -5,7 +5,7 @@
 using namespace std;
 using namespace ps;
 
-size_t Edge::id_counter_ = 0;
+atomic<size_t> Edge::id_counter_(0);
 
 void Edge::SetCost(double cost)
 {
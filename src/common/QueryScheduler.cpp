@@ -0,0 +1,69 @@
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <common/QueryScheduler.hpp>
+
+using namespace std;
+using namespace ps;
+
+QueryScheduler::QueryScheduler(int num_workers):
+pool_(num_workers), total_time_(0)
+{
+}
+
+void QueryScheduler::Run(int num_queries, QueryType query)
+{
+    query_stats_.assign(num_queries, QueryStats());
+
+    mutex error_lock;
+    exception_ptr error;
+
+    auto t_start = chrono::steady_clock::now();
+    for (int query_id = 0; query_id < num_queries; ++query_id)
+    {
+        pool_.Submit([&, query_id](int worker_id)
+        {
+            auto& stats = query_stats_[query_id];
+            stats.worker_id_ = worker_id;
+            auto t_query_start = chrono::steady_clock::now();
+            try
+            {
+                stats.success_ = query(query_id, worker_id);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> locker(error_lock);
+                if (!error)
+                {
+                    error = current_exception();
+                }
+            }
+            auto t_query_end = chrono::steady_clock::now();
+            stats.start_time_ = 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_query_start-t_start).count();
+            stats.time_ = 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_query_end-t_query_start).count();
+        });
+    }
+    pool_.WaitAll();
+    auto t_end = chrono::steady_clock::now();
+    total_time_ = 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_end-t_start).count();
+
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+}
+
+int QueryScheduler::NumSuccessful() const
+{
+    int num_success = 0;
+    for (auto& stats : query_stats_)
+    {
+        num_success += stats.success_;
+    }
+    return num_success;
+}
+
+double QueryScheduler::GetThroughput() const
+{
+    return (total_time_ > 0) ? query_stats_.size()/total_time_ : 0;
+}
@@ -4,7 +4,7 @@
 using namespace std;
 using namespace ps;
 
-size_t State::id_counter_ = 0;
+atomic<size_t> State::id_counter_(0);
 
 // State::State():
 // g_val_(numeric_limits<double>::infinity()),
@@ -28,6 +28,20 @@ incoming_edge_ptr_(NULL)
     state_id_ = id_counter_++;
 }
 
+void State::Reset(const StateVarsType& vars)
+{
+    vars_ = vars;
+    g_val_ = DINF;
+    f_val_ = DINF;
+    h_val_ = -1;
+    is_visited_ = false;
+    being_expanded_ = false;
+    num_successors_ = 0;
+    num_expanded_successors_ = 0;
+    incoming_edge_ptr_ = NULL;
+    state_id_ = id_counter_++;
+}
+
 void State::Print(string str)
 {
     cout << str
@@ -0,0 +1,300 @@
+#include <common/WorkStealingPool.hpp>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+using namespace ps;
+
+namespace
+{
+    // Pool and id of the worker owning the calling thread, if any
+    thread_local const WorkStealingPool* tl_pool = nullptr;
+    thread_local int tl_worker_id = -1;
+
+#ifdef __linux__
+    vector<int> toCpus(const cpu_set_t& set)
+    {
+        vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    vector<int> callingThreadCpus()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return vector<int>();
+        return toCpus(allowed);
+    }
+
+    void setCallingThreadCpus(const vector<int>& cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // Cpus the process may run on. Read once, by the first pool and so before any pool pinned a
+    // thread: a pinned thread only reports its own cpu and threads it spawns inherit that.
+    const vector<int>& processCpus()
+    {
+        static const vector<int> cpus = callingThreadCpus();
+        return cpus;
+    }
+#endif
+}
+
+WorkStealingPool::WorkStealingPool(int num_workers):
+num_workers_(num_workers), num_started_(0), num_initialized_(0), first_cpu_(-1), next_worker_(0),
+num_pending_(0), num_queued_(0), num_parked_(0), stop_(false), num_waiting_(0)
+{
+    for (int i = 0; i < num_workers_; ++i)
+    {
+        workers_.emplace_back(new Worker());
+    }
+    threads_.reserve(num_workers_);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> locker(park_lock_);
+        stop_ = true;
+    }
+    park_cv_.notify_all();
+
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+
+    if (this_thread::get_id() == caller_id_)
+    {
+        UnpinCallingThread();
+    }
+}
+
+void WorkStealingPool::SetAffinity(int first_cpu)
+{
+    first_cpu_ = first_cpu;
+#ifdef __linux__
+    // Cycle through the cpus the process is allowed on rather than assuming 0..n-1
+    cpus_ = processCpus();
+#endif
+}
+
+void WorkStealingPool::PinCallingThread(int cpu_idx)
+{
+#ifdef __linux__
+    if (cpus_.empty())
+        return;
+    // Pinning again, e.g. on the next query, keeps the mask the caller had first
+    if (caller_id_ != this_thread::get_id())
+    {
+        UnpinCallingThread();
+        caller_cpus_ = callingThreadCpus();
+        caller_id_ = this_thread::get_id();
+    }
+    pinTo(cpu_idx);
+#endif
+}
+
+void WorkStealingPool::UnpinCallingThread()
+{
+#ifdef __linux__
+    if (caller_id_ != this_thread::get_id())
+        return;
+    if (!caller_cpus_.empty())
+        setCallingThreadCpus(caller_cpus_);
+    caller_id_ = thread::id();
+#endif
+}
+
+void WorkStealingPool::SetWorkerInit(TaskType init)
+{
+    init_ = move(init);
+}
+
+void WorkStealingPool::Submit(TaskType task)
+{
+    num_pending_++;
+    if (num_started_ < num_workers_ && num_pending_ > num_started_)
+    {
+        spawnWorkers();
+    }
+
+    int worker_id = (tl_pool == this) ? tl_worker_id : (next_worker_++ % num_started_);
+    auto& worker = *workers_[worker_id];
+    {
+        lock_guard<mutex> locker(worker.lock_);
+        worker.tasks_.emplace_back(move(task));
+        num_queued_++;
+    }
+
+    // Parked workers recheck num_queued_ under park_lock_ before sleeping, so skipping the
+    // notification when nobody is parked cannot lose a wakeup
+    if (num_parked_ > 0)
+    {
+        lock_guard<mutex> locker(park_lock_);
+        park_cv_.notify_one();
+    }
+}
+
+void WorkStealingPool::WaitForIdleWorker()
+{
+    WaitForPendingBelow(num_workers_);
+}
+
+void WorkStealingPool::WaitForPendingBelow(int max_pending)
+{
+    waitUntil([this, max_pending](){return num_pending_ < max_pending;});
+}
+
+void WorkStealingPool::WaitAll()
+{
+    waitUntil([this](){return num_pending_ == 0 && num_initialized_ == num_started_;});
+}
+
+void WorkStealingPool::spawnWorkers()
+{
+    lock_guard<mutex> locker(spawn_lock_);
+    while (num_started_ < num_workers_ && num_pending_ > num_started_)
+    {
+        // Counted before the thread runs, so num_initialized_ never exceeds num_started_
+        int worker_id = num_started_++;
+        threads_.emplace_back(&WorkStealingPool::workerLoop, this, worker_id);
+    }
+}
+
+void WorkStealingPool::workerLoop(int worker_id)
+{
+    tl_pool = this;
+    tl_worker_id = worker_id;
+    initWorker(worker_id);
+
+    while (true)
+    {
+        TaskType task;
+        if (popTask(worker_id, task))
+        {
+            task(worker_id);
+            finishTask();
+            continue;
+        }
+
+        unique_lock<mutex> locker(park_lock_);
+        if (stop_ && num_queued_ == 0)
+            break;
+
+        num_parked_++;
+        park_cv_.wait(locker, [this](){return stop_ || num_queued_ > 0;});
+        num_parked_--;
+    }
+}
+
+bool WorkStealingPool::popTask(int worker_id, TaskType& task)
+{
+    // Own deque first, newest task first
+    {
+        auto& worker = *workers_[worker_id];
+        lock_guard<mutex> locker(worker.lock_);
+        if (!worker.tasks_.empty())
+        {
+            task = move(worker.tasks_.back());
+            worker.tasks_.pop_back();
+            num_queued_--;
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another worker
+    for (int i = 1; i < num_workers_; ++i)
+    {
+        auto& victim = *workers_[(worker_id+i)%num_workers_];
+        lock_guard<mutex> locker(victim.lock_);
+        if (!victim.tasks_.empty())
+        {
+            task = move(victim.tasks_.front());
+            victim.tasks_.pop_front();
+            num_queued_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::initWorker(int worker_id)
+{
+    if (first_cpu_ >= 0)
+    {
+        pinTo(first_cpu_+worker_id);
+    }
+
+    if (init_)
+    {
+        init_(worker_id);
+    }
+
+#ifdef __linux__
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+        workers_[worker_id]->cpu_ = cpu;
+        workers_[worker_id]->node_ = node;
+    }
+#endif
+
+    num_initialized_++;
+    notifyWaiting();
+}
+
+void WorkStealingPool::pinTo(int cpu_idx) const
+{
+#ifdef __linux__
+    if (!cpus_.empty())
+    {
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(cpus_[cpu_idx%cpus_.size()], &pinned);
+        pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+    }
+#endif
+}
+
+void WorkStealingPool::finishTask()
+{
+    num_pending_--;
+    notifyWaiting();
+}
+
+void WorkStealingPool::notifyWaiting()
+{
+    if (num_waiting_ > 0)
+    {
+        lock_guard<mutex> locker(wait_lock_);
+        wait_cv_.notify_all();
+    }
+}
+
+template<typename Pred>
+void WorkStealingPool::waitUntil(Pred pred)
+{
+    if (pred())
+        return;
+
+    unique_lock<mutex> locker(wait_lock_);
+    num_waiting_++;
+    wait_cv_.wait(locker, pred);
+    num_waiting_--;
+}
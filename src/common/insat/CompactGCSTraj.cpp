@@ -0,0 +1,176 @@
+#include <common/insat/CompactGCSTraj.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <drake/common/trajectories/bezier_curve.h>
+
+namespace ps
+{
+    using drake::trajectories::BezierCurve;
+
+    namespace
+    {
+        /// Whether segment matches the stored control points and duration to tol, relative to
+        /// the magnitude of its control points
+        bool matches(const BezierCurve<double>& segment, const Eigen::Ref<const MatDf>& control_points,
+                     double duration, double tol)
+        {
+            const auto& solved = segment.control_points();
+            const double solved_duration = segment.end_time() - segment.start_time();
+            if (solved.rows() != control_points.rows() || solved.cols() != control_points.cols() ||
+                std::abs(solved_duration - duration) > tol*std::max(1.0, solved_duration))
+            {
+                return false;
+            }
+            double scale = 1.0;
+            double diff = 0.0;
+            for (int c=0; c<solved.cols(); ++c)
+            {
+                for (int r=0; r<solved.rows(); ++r)
+                {
+                    scale = std::max(scale, std::abs(solved(r, c)));
+                    diff = std::max(diff, std::abs(solved(r, c) - control_points(r, c)));
+                }
+            }
+            return diff <= tol*scale;
+        }
+    }
+
+    template<typename Visitor>
+    void CompactGCSTraj::forEachSegment(Visitor&& visit) const
+    {
+        /// Trajectories storing the segments, root first
+        std::vector<const CompactGCSTraj*> chain;
+        for (const CompactGCSTraj* traj = this; traj; traj = traj->parent_.get())
+        {
+            chain.push_back(traj);
+        }
+        for (int k=static_cast<int>(chain.size())-1; k>=0; --k)
+        {
+            const CompactGCSTraj& traj = *chain[k];
+            /// A child may share fewer segments than its parent holds
+            const int end = k > 0 ? chain[k-1]->first_segment_ : NumSegments();
+            for (int i=traj.first_segment_; i<end; ++i)
+            {
+                const int j = i - traj.first_segment_;
+                if (!visit(traj.control_points_.middleCols(traj.col_offsets_[j], traj.col_offsets_[j+1]-traj.col_offsets_[j]),
+                           traj.durations_[j]))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    CompactGCSTraj::Ptr CompactGCSTraj::Compress(const GCSTraj& traj, double cost, const Ptr& prefix,
+                                                 double share_tol)
+    {
+        std::shared_ptr<CompactGCSTraj> compact(new CompactGCSTraj());
+        compact->cost_ = cost;
+        compact->optimal_cost_ = traj.result_.get_optimal_cost();
+        compact->solution_result_ = traj.result_.get_solution_result();
+        if (!traj.story_.empty())
+        {
+            compact->story_ = std::make_shared<const std::string>(traj.story_);
+        }
+
+        const auto& composite = traj.traj_;
+        const int num_segments = composite.get_number_of_segments();
+        std::vector<const BezierCurve<double>*> segments(num_segments);
+        for (int i=0; i<num_segments; ++i)
+        {
+            segments[i] = dynamic_cast<const BezierCurve<double>*>(&composite.segment(i));
+            if (!segments[i])
+            {
+                compact->full_traj_ = std::make_shared<const GCSTraj>(traj);
+                return compact;
+            }
+        }
+        if (num_segments == 0)
+        {
+            return compact;
+        }
+        compact->start_time_ = composite.start_time();
+
+        /// Leading segments the prefix already stores
+        int num_shared = 0;
+        if (prefix && !prefix->full_traj_ && prefix->start_time_ == compact->start_time_)
+        {
+            const int max_shared = std::min(num_segments, prefix->NumSegments());
+            prefix->forEachSegment([&](const Eigen::Ref<const MatDf>& prefix_cp, double prefix_duration)
+            {
+                if (num_shared == max_shared || !matches(*segments[num_shared], prefix_cp, prefix_duration, share_tol))
+                {
+                    return false;
+                }
+                ++num_shared;
+                return true;
+            });
+        }
+        if (num_shared > 0)
+        {
+            /// The closest trajectory up the prefix's parents that stores all shared segments
+            Ptr parent = prefix;
+            while (num_shared <= parent->first_segment_)
+            {
+                parent = parent->parent_;
+            }
+            compact->parent_ = parent;
+            compact->first_segment_ = num_shared;
+        }
+
+        compact->col_offsets_.reserve(num_segments-num_shared+1);
+        compact->durations_.reserve(num_segments-num_shared);
+        for (int i=num_shared; i<num_segments; ++i)
+        {
+            compact->col_offsets_.push_back(compact->col_offsets_.back() + segments[i]->control_points().cols());
+            compact->durations_.push_back(segments[i]->end_time() - segments[i]->start_time());
+        }
+        if (compact->col_offsets_.back() > 0)
+        {
+            compact->control_points_.resize(segments[0]->rows(), compact->col_offsets_.back());
+        }
+        for (int i=num_shared; i<num_segments; ++i)
+        {
+            compact->control_points_.middleCols(compact->col_offsets_[i-num_shared], segments[i]->control_points().cols()) =
+                segments[i]->control_points();
+        }
+
+        /// The first owned segment starts exactly where the shared part ends, a shared segment
+        /// may be off from the solved one by up to share_tol
+        if (num_shared > 0 && compact->col_offsets_.back() > 0)
+        {
+            const auto last_shared = compact->ControlPoints(num_shared-1);
+            compact->control_points_.col(0) = last_shared.col(last_shared.cols()-1);
+        }
+        return compact;
+    }
+
+    GCSTraj CompactGCSTraj::Expand() const
+    {
+        if (full_traj_)
+        {
+            return *full_traj_;
+        }
+
+        std::vector<drake::copyable_unique_ptr<drake::trajectories::Trajectory<double>>> segments;
+        segments.reserve(NumSegments());
+        double t = start_time_;
+        forEachSegment([&](const Eigen::Ref<const MatDf>& control_points, double duration)
+        {
+            segments.emplace_back(std::make_unique<BezierCurve<double>>(t, t+duration, control_points));
+            t += duration;
+            return true;
+        });
+
+        drake::solvers::MathematicalProgramResult result;
+        result.set_solution_result(solution_result_);
+        result.set_optimal_cost(optimal_cost_);
+        GCSTraj traj(drake::trajectories::CompositeTrajectory<double>(segments), result);
+        if (story_)
+        {
+            traj.story_ = *story_;
+        }
+        return traj;
+    }
+}
@@ -147,42 +147,15 @@ bool EpasePlanner::Plan()
 
         lock_.unlock();
 
-        int thread_id = 0;
-        bool edge_expansion_assigned = false;
-
         if (num_threads_ == 1)
         {
             expandEdge(curr_edge_ptr, 0);
         }
         else
         {
-            while (!edge_expansion_assigned)
-            {
-                unique_lock<mutex> locker(lock_vec_[thread_id]);
-                bool status = edge_expansion_status_[thread_id];
-                locker.unlock();
-
-                if (!status)
-                {
-                    int num_threads_current = edge_expansion_futures_.size();
-                    if (thread_id >= num_threads_current)
-                    {
-                        if (VERBOSE) cout << "Spawning edge expansion thread " << thread_id << endl;
-                        edge_expansion_futures_.emplace_back(async(launch::async, &EpasePlanner::expandEdgeLoop, this, thread_id));
-                    }
-                    locker.lock();
-                    edge_expansion_vec_[thread_id] = curr_edge_ptr;
-                    edge_expansion_status_[thread_id] = 1;
-                    edge_expansion_assigned = true;       
-                    locker.unlock();
-                    cv_vec_[thread_id].notify_one();
-                }
-                else
-                {
-                    thread_id = thread_id == num_threads_-2 ? 0 : thread_id+1;
-                }
-
-            }
+            // Hand the edge over as soon as a worker is free
+            pool_->WaitForIdleWorker();
+            pool_->Submit([this, curr_edge_ptr](int thread_id){expandEdge(curr_edge_ptr, thread_id);});
         }
 
         lock_.lock();
@@ -198,27 +171,6 @@ bool EpasePlanner::Plan()
     return false;
 }
 
-void EpasePlanner::expandEdgeLoop(int thread_id)
-{
-    while (!terminate_)
-    {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        cv_vec_[thread_id].wait(locker, [this, thread_id](){return (edge_expansion_status_[thread_id] == 1);});
-        locker.unlock();
-
-        if (terminate_)
-            break;
-
-        expandEdge(edge_expansion_vec_[thread_id], thread_id);
-
-        locker.lock();
-        edge_expansion_vec_[thread_id] = NULL;
-        edge_expansion_status_[thread_id] = 0;
-        locker.unlock();
-
-    }    
-}
-
 void EpasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
 {
     auto t_start = chrono::steady_clock::now();
@@ -240,7 +192,7 @@ void EpasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
             if (action_ptr->CheckPreconditions(state_ptr->GetStateVars()))
             {
                 auto edge_ptr_real = new Edge(state_ptr, action_ptr);
-                edge_map_.insert(make_pair(getEdgeKey(edge_ptr_real), edge_ptr_real));
+                concurrent_edge_map_.Insert(getEdgeKey(edge_ptr_real), edge_ptr_real);
 
                 // edge_ptr_real->exp_priority_ = state_ptr->GetGValue() + heuristic_w_*state_ptr->GetHValue();
                 edge_ptr_real->expansion_priority_ = edge_ptr->expansion_priority_;
@@ -308,18 +260,7 @@ void EpasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
                         // Insert poxy edge
                         auto edge_temp = Edge(successor_state_ptr, dummy_action_ptr_);
                         auto edge_key = getEdgeKey(&edge_temp);
-                        auto it_edge = edge_map_.find(edge_key); 
-                        EdgePtrType proxy_edge_ptr;
-
-                        if (it_edge == edge_map_.end())
-                        {
-                            proxy_edge_ptr = new Edge(successor_state_ptr, dummy_action_ptr_);
-                            edge_map_.insert(make_pair(edge_key, proxy_edge_ptr));
-                        }
-                        else
-                        {
-                            proxy_edge_ptr = it_edge->second;
-                        }
+                        EdgePtrType proxy_edge_ptr = concurrent_edge_map_.FindOrInsert(edge_key, [&](){return new Edge(successor_state_ptr, dummy_action_ptr_);});
 
                         proxy_edge_ptr->expansion_priority_ = new_g_val + heuristic_w_*h_val;
                         
@@ -11,8 +11,10 @@ GepasePlanner::GepasePlanner(ParamsType planner_params):
 Planner(planner_params)
 {    
     num_threads_  = planner_params["num_threads"];
-    vector<LockType> lock_vec(num_threads_-1);
-    lock_vec_.swap(lock_vec);
+    if (planner_params_.find("persistent_pool") == planner_params_.end())
+    {
+        planner_params_["persistent_pool"] = false;
+    }
 }
 
 GepasePlanner::~GepasePlanner()
@@ -150,42 +152,15 @@ bool GepasePlanner::Plan()
 
         lock_.unlock();
 
-        int thread_id = 0;
-        bool edge_expansion_assigned = false;
-
         if (num_threads_ == 1)
         {
             expand(curr_edge_ptr, 0);
         }
         else
         {
-            while (!edge_expansion_assigned)
-            {
-                unique_lock<mutex> locker(lock_vec_[thread_id]);
-                bool status = edge_expansion_status_[thread_id];
-                locker.unlock();
-
-                if (!status)
-                {
-                    int num_threads_current = edge_expansion_futures_.size();
-                    if (thread_id >= num_threads_current)
-                    {
-                        if (VERBOSE) cout << "Spawning edge expansion thread " << thread_id << endl;
-                        edge_expansion_futures_.emplace_back(async(launch::async, &GepasePlanner::expandEdgeLoop, this, thread_id));
-                    }
-                    locker.lock();
-                    edge_expansion_vec_[thread_id] = curr_edge_ptr;
-                    edge_expansion_status_[thread_id] = 1;
-                    edge_expansion_assigned = true;       
-                    locker.unlock();
-                    cv_vec_[thread_id].notify_one();
-                }
-                else
-                {
-                    thread_id = thread_id == num_threads_-2 ? 0 : thread_id+1;
-                }
-
-            }
+            // Hand the edge over as soon as a worker is free
+            pool_->WaitForIdleWorker();
+            pool_->Submit([this, curr_edge_ptr](int thread_id){expand(curr_edge_ptr, thread_id);});
         }
 
         lock_.lock();
@@ -209,51 +184,35 @@ void GepasePlanner::initialize()
     terminate_ = false;
     recheck_flag_ = true;
 
-    edge_expansion_vec_.clear();
-    edge_expansion_vec_.resize(num_threads_-1, NULL);
-    
-    edge_expansion_status_.clear();
-    edge_expansion_status_.resize(num_threads_-1, 0);
-
-    vector<condition_variable> cv_vec(num_threads_-1);
-    cv_vec_.swap(cv_vec);
-
-    edge_expansion_futures_.clear();
+    // A persistent pool is kept from the previous query, along with its started threads
+    if ((num_threads_ > 1) && !pool_)
+    {
+        pool_ = makeWorkerPool(num_threads_-1);
+    }
+    if (pool_)
+    {
+        pinSearchThread(*pool_);
+    }
 
     // Insert proxy edge with start state
     dummy_action_ptr_ = NULL;
     auto edge_ptr = new Edge(start_state_ptr_, dummy_action_ptr_);
     edge_ptr->expansion_priority_ = heuristic_w_*computeHeuristic(start_state_ptr_);
 
-    edge_map_.insert(make_pair(getEdgeKey(edge_ptr), edge_ptr));
+    concurrent_edge_map_.Insert(getEdgeKey(edge_ptr), edge_ptr);
     edge_open_list_.push(edge_ptr);   
 }
 
-void GepasePlanner::notifyMainThread()
+StatePtrType GepasePlanner::constructState(const StateVarsType& state)
 {
-    recheck_flag_ = true;
-    cv_.notify_one();
+    size_t key = state_key_generator_(state);
+    return concurrent_state_map_.FindOrInsert(key, [&state](){return new State(state);});
 }
 
-void GepasePlanner::expandEdgeLoop(int thread_id)
+void GepasePlanner::notifyMainThread()
 {
-    while (!terminate_)
-    {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        cv_vec_[thread_id].wait(locker, [this, thread_id](){return (edge_expansion_status_[thread_id] == 1);});
-        locker.unlock();
-
-        if (terminate_)
-            break;
-
-        expand(edge_expansion_vec_[thread_id], thread_id);
-
-        locker.lock();
-        edge_expansion_vec_[thread_id] = NULL;
-        edge_expansion_status_[thread_id] = 0;
-        locker.unlock();
-
-    }    
+    recheck_flag_ = true;
+    cv_.notify_one();
 }
 
 void GepasePlanner::expand(EdgePtrType edge_ptr, int thread_id)
@@ -275,7 +234,7 @@ void GepasePlanner::expand(EdgePtrType edge_ptr, int thread_id)
             if (action_ptr->CheckPreconditions(state_ptr->GetStateVars()))
             {
                 auto edge_ptr_next = new Edge(state_ptr, action_ptr);
-                edge_map_.insert(make_pair(getEdgeKey(edge_ptr_next), edge_ptr_next));
+                concurrent_edge_map_.Insert(getEdgeKey(edge_ptr_next), edge_ptr_next);
                 edge_ptr_next->expansion_priority_ = edge_ptr->expansion_priority_;
                 state_ptr->num_successors_+=1;
 
@@ -331,9 +290,13 @@ void GepasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
     auto action_ptr = edge_ptr->action_ptr_;
 
     lock_.unlock();
-    // Evaluate the edge
+    // Evaluate the edge. Once the plan is cancelled only the bookkeeping runs.
     auto t_start = chrono::steady_clock::now();
-    auto action_successor = action_ptr->GetSuccessor(edge_ptr->parent_state_ptr_->GetStateVars(), thread_id);
+    ActionSuccessor action_successor(false, {});
+    if (!cancel_token_.IsCancelled())
+    {
+        action_successor = action_ptr->GetSuccessor(edge_ptr->parent_state_ptr_->GetStateVars(), thread_id);
+    }
     auto t_end = chrono::steady_clock::now();
     //********************
     
@@ -380,18 +343,7 @@ void GepasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
                     // Insert poxy edge
                     auto edge_temp = Edge(successor_state_ptr, dummy_action_ptr_);
                     auto edge_key = getEdgeKey(&edge_temp);
-                    auto it_edge = edge_map_.find(edge_key); 
-                    EdgePtrType proxy_edge_ptr;
-
-                    if (it_edge == edge_map_.end())
-                    {
-                        proxy_edge_ptr = new Edge(successor_state_ptr, dummy_action_ptr_);
-                        edge_map_.insert(make_pair(edge_key, proxy_edge_ptr));
-                    }
-                    else
-                    {
-                        proxy_edge_ptr = it_edge->second;
-                    }
+                    EdgePtrType proxy_edge_ptr = concurrent_edge_map_.FindOrInsert(edge_key, [&](){return new Edge(successor_state_ptr, dummy_action_ptr_);});
 
                     proxy_edge_ptr->expansion_priority_ = new_g_val + heuristic_w_*h_val;
                     
@@ -422,29 +374,21 @@ void GepasePlanner::expandEdge(EdgePtrType edge_ptr, int thread_id)
 
 void GepasePlanner::exit()
 {
-    for (int thread_id = 0; thread_id < num_threads_-1; ++thread_id)
+    // Let the in-flight expansions finish before the states are released. Cancelling first
+    // makes the queued ones skip their evaluations.
+    planner_stats_.num_threads_spawned_ = 1;
+    if (pool_)
     {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        edge_expansion_status_[thread_id] = 1;
-        locker.unlock();
-        cv_vec_[thread_id].notify_one();
-    }
-
-    planner_stats_.num_threads_spawned_ = edge_expansion_futures_.size()+1;
-    bool all_expansion_threads_terminated = false;
-    while (!all_expansion_threads_terminated)
-    {
-        all_expansion_threads_terminated = true;
-        for (auto& fut : edge_expansion_futures_)
+        cancel_token_.Cancel();
+        pool_->WaitAll();
+        planner_stats_.num_threads_spawned_ += pool_->NumWorkersStarted();
+        recordWorkerPlacement(*pool_);
+        pool_->UnpinCallingThread();
+        if (!planner_params_["persistent_pool"])
         {
-            if (!isFutureReady(fut))
-            {
-                all_expansion_threads_terminated = false;
-                break;
-            }
+            pool_.reset();
         }
     }
-    edge_expansion_futures_.clear();
 
     while (!edge_open_list_.empty())
     {
@@ -452,5 +396,10 @@ void GepasePlanner::exit()
     }
     being_expanded_states_.clear();
 
+    concurrent_state_map_.ForEach([](size_t key, StatePtrType state_ptr){delete state_ptr;});
+    concurrent_state_map_.Clear();
+    concurrent_edge_map_.ForEach([](size_t key, EdgePtrType edge_ptr){delete edge_ptr;});
+    concurrent_edge_map_.Clear();
+
     Planner::exit();
 }
@@ -19,6 +19,10 @@ Planner::~Planner()
 void Planner::SetActions(vector<shared_ptr<Action>> actions_ptrs)
 {
     actions_ptrs_ = actions_ptrs;
+    for (auto& action_ptr : actions_ptrs_)
+    {
+        action_ptr->SetCancellationToken(&cancel_token_);
+    }
 }
 
 void Planner::SetStartState(const StateVarsType& state_vars)
@@ -56,11 +60,21 @@ void Planner::SetStateToStateHeuristicGenerator(function<double(const StateVarsT
     binary_heuristic_generator_ = callback;
 }
 
+void Planner::SetStatesToStateHeuristicGenerator(function<void(const vector<StateVarsType>&, const StateVarsType&, vector<double>&)> callback)
+{
+    batch_binary_heuristic_generator_ = callback;
+}
+
 void Planner::SetPostProcessor(std::function<void(vector<PlanElement>&, double&, double)> callback)
 {
     post_processor_ = callback;
 }
 
+void Planner::SetThreadInitializer(function<void(int)> callback)
+{
+    thread_initializer_ = callback;
+}
+
 std::vector<PlanElement> Planner::GetPlan() const
 {
     return plan_;
@@ -93,6 +107,8 @@ void Planner::initialize()
 void Planner::startTimer()
 {
     t_start_ = chrono::steady_clock::now();
+    auto it = planner_params_.find("timeout");
+    cancel_token_.Reset((it != planner_params_.end()) ? it->second : numeric_limits<double>::infinity());
 }
 
 bool Planner::checkTimeout()
@@ -155,6 +171,31 @@ double Planner::computeHeuristic(const StatePtrType& state_ptr_1, const StatePtr
     return roundOff(binary_heuristic_generator_(state_ptr_1->GetStateVars(), state_ptr_2->GetStateVars()));
 }
 
+void Planner::computeHeuristics(const vector<StatePtrType>& state_ptrs, const StatePtrType& state_ptr, vector<double>& h_vals)
+{
+    h_vals.resize(state_ptrs.size());
+    if (!batch_binary_heuristic_generator_)
+    {
+        for (int i = 0; i < state_ptrs.size(); ++i)
+        {
+            h_vals[i] = computeHeuristic(state_ptrs[i], state_ptr);
+        }
+        return;
+    }
+
+    vector<StateVarsType> states_vars;
+    states_vars.reserve(state_ptrs.size());
+    for (auto& s_ptr : state_ptrs)
+    {
+        states_vars.emplace_back(s_ptr->GetStateVars());
+    }
+    batch_binary_heuristic_generator_(states_vars, state_ptr->GetStateVars(), h_vals);
+    for (auto& h_val : h_vals)
+    {
+        h_val = roundOff(h_val);
+    }
+}
+
 bool Planner::isGoalState(const StatePtrType& state_ptr)
 {
     return goal_checker_(state_ptr->GetStateVars());
@@ -193,7 +234,9 @@ void Planner::constructPlan(StatePtrType& state_ptr)
 
 double Planner::roundOff(double value, int prec)
 {
-    double pow_10 = pow(10.0, prec);
+    // Called for every heuristic evaluation, avoid pow for the usual precisions
+    static const double POW_10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    double pow_10 = (prec >= 0 && prec < 10) ? POW_10[prec] : pow(10.0, prec);
     return round(value * pow_10) / pow_10;
 }
 
@@ -226,4 +269,37 @@ void Planner::cleanUp()
 void Planner::exit()
 {
     cleanUp();
+    cancel_token_.Reset();
+}
+
+unique_ptr<WorkStealingPool> Planner::makeWorkerPool(int num_workers)
+{
+    unique_ptr<WorkStealingPool> pool(new WorkStealingPool(num_workers));
+    auto it = planner_params_.find("pin_workers");
+    if (it != planner_params_.end() && it->second)
+    {
+        // The search runs on the calling thread. It takes the first cpu, the workers the rest.
+        pool->SetAffinity(1);
+    }
+    if (thread_initializer_)
+    {
+        pool->SetWorkerInit(thread_initializer_);
+    }
+    return pool;
+}
+
+void Planner::pinSearchThread(WorkStealingPool& pool)
+{
+    pool.PinCallingThread(0);
+}
+
+void Planner::recordWorkerPlacement(const WorkStealingPool& pool)
+{
+    planner_stats_.worker_cpus_.resize(pool.NumWorkers());
+    planner_stats_.worker_numa_nodes_.resize(pool.NumWorkers());
+    for (int i = 0; i < pool.NumWorkers(); ++i)
+    {
+        planner_stats_.worker_cpus_[i] = pool.WorkerCpu(i);
+        planner_stats_.worker_numa_nodes_[i] = pool.WorkerNode(i);
+    }
 }
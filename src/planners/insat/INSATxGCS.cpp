@@ -34,6 +34,7 @@
 
 #include <planners/insat/INSATxGCS.hpp>
 #include <boost/functional/hash.hpp>
+#include <common/CompletionQueue.hpp>
 #include <common/insatxgcs/gcsbfs.hpp>
 
 namespace ps
@@ -47,6 +48,28 @@ namespace ps
     {
       planner_params["adaptive_opt"] = false;
     }
+    if (planner_params_.find("warm_start") == planner_params_.end())
+    {
+      planner_params_["warm_start"] = false;
+    }
+    if (planner_params_.find("parallel_successors") == planner_params_.end())
+    {
+      planner_params_["parallel_successors"] = false;
+    }
+    if (planner_params_.find("pipelined_successors") == planner_params_.end())
+    {
+      planner_params_["pipelined_successors"] = false;
+    }
+    if (planner_params_.find("persistent_pool") == planner_params_.end())
+    {
+      planner_params_["persistent_pool"] = false;
+    }
+    // Vertex states are indexed directly when the range of vertex ids is known
+    if (planner_params_.find("num_dense_states") != planner_params_.end())
+    {
+      insat_state_store_.SetDenseRange(static_cast<size_t>(planner_params_["dense_state_offset"]),
+                                       static_cast<size_t>(planner_params_["num_dense_states"]));
+    }
   }
 
   void INSATxGCS::SetStartState(const StateVarsType &state_vars) {
@@ -75,13 +98,25 @@ namespace ps
         return true;
       }
 
-      expandState(state_ptr);
+      if (planner_params_["pipelined_successors"])
+      {
+        expandStatePipelined(state_ptr);
+      }
+      else if (successor_pool_)
+      {
+        expandStateParallel(state_ptr);
+      }
+      else
+      {
+        expandState(state_ptr);
+      }
 
     }
 
     auto t_end = std::chrono::steady_clock::now();
     double t_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end-t_start_).count();
     planner_stats_.total_time_ = 1e-9*t_elapsed;
+    exit();
     return false;
   }
 
@@ -109,7 +144,31 @@ namespace ps
     // Reset h_min
     h_val_min_ = DINF;
 
-    planner_stats_.num_jobs_per_thread_.resize(1, 0);
+    int num_threads = 1;
+    if ((planner_params_["parallel_successors"] || planner_params_["pipelined_successors"]) &&
+        planner_params_.find("num_threads") != planner_params_.end())
+    {
+      num_threads = std::max(1, static_cast<int>(planner_params_["num_threads"]));
+    }
+
+    // Warm solves use IPOPT, whose linear solver is not thread safe
+    warm_start_ = planner_params_["warm_start"] && (num_threads == 1);
+    if (planner_params_["warm_start"] && !warm_start_)
+    {
+      std::cout << "Warm start is disabled with parallel successors" << std::endl;
+    }
+    // A persistent pool is kept from the previous query, along with its started threads. Pipelined
+    // solves run where the actions submit them instead.
+    if ((num_threads > 1) && !successor_pool_ && !planner_params_["pipelined_successors"])
+    {
+      successor_pool_ = makeWorkerPool(num_threads);
+    }
+    if (successor_pool_)
+    {
+      pinSearchThread(*successor_pool_);
+    }
+
+    planner_stats_.num_jobs_per_thread_.resize(num_threads, 0);
     // Initialize open list
     start_state_ptr_->SetFValue(start_state_ptr_->GetGValue() + heuristic_w_*start_state_ptr_->GetHValue());
     insat_state_open_list_.push(start_state_ptr_);
@@ -161,7 +220,7 @@ namespace ps
       ub_cost_[adj.first] = global_ub;
 
       // Lower bound
-      // Option 1
+      // Option 1: the unary heuristic (an O(1) LB graph lookup when the driver installs one)
       StateVarsType state(1, adj.first);
       lb_cost_[adj.first] = unary_heuristic_generator_(state);
 
@@ -247,125 +306,270 @@ namespace ps
   void INSATxGCS::updateState(InsatStatePtrType &state_ptr, std::vector<InsatStatePtrType> &ancestors,
                                  InsatActionPtrType &action_ptr, ActionSuccessor &action_successor) {
 
-    if (action_successor.success_)
+    auto successor_state_ptr = evaluatedSuccessor(ancestors, action_successor);
+    if (!successor_state_ptr)
     {
-#if OPTIMAL
-      auto successor_state_ptr = constructInsatPath(ancestors, action_successor.successor_state_vars_costs_.back().first);
-#else
-      auto successor_state_ptr = constructInsatState(action_successor.successor_state_vars_costs_.back().first);
-#endif
+      return;
+    }
 
-      if (!successor_state_ptr->IsVisited())
+    std::vector<StateVarsType> anc_states;
+    for (auto& anc: ancestors)
+    {
+      anc_states.emplace_back(anc->GetStateVars());
+    }
+    auto traj = optimizeSuccessor(state_ptr, anc_states, action_ptr, successor_state_ptr);
+    relaxSuccessor(state_ptr, ancestors, action_ptr, successor_state_ptr, traj);
+  }
+
+  void INSATxGCS::expandStateParallel(InsatStatePtrType state_ptr) {
+
+    if (VERBOSE) state_ptr->Print("Expanding");
+    planner_stats_.num_state_expansions_++;
+
+    state_ptr->SetVisited();
+
+    auto ancestors = getStateAncestors(state_ptr, true);
+    std::vector<StateVarsType> anc_states;
+    for (auto& anc: ancestors)
+    {
+      anc_states.emplace_back(anc->GetStateVars());
+    }
+    std::vector<InsatActionPtrType> actions;
+    std::vector<InsatStatePtrType> successors;
+    generateSuccessors(state_ptr, ancestors, actions, successors);
+
+    // The solves only read the parent and write their own slot, so they are independent
+    std::vector<TrajType> trajs(successors.size());
+    for (size_t i = 0; i < successors.size(); ++i)
+    {
+      successor_pool_->Submit([this, i, &state_ptr, &anc_states, &actions, &successors, &trajs](int thread_id)
       {
-        planner_stats_.num_evaluated_edges_++;
+        planner_stats_.num_jobs_per_thread_[thread_id] += 1;
+        trajs[i] = optimizeSuccessor(state_ptr, anc_states, actions[i], successors[i], thread_id);
+      });
+    }
+    successor_pool_->WaitAll();
+
+    for (size_t i = 0; i < successors.size(); ++i)
+    {
+      relaxSuccessor(state_ptr, ancestors, actions[i], successors[i], trajs[i]);
+    }
+  }
+
+  void INSATxGCS::expandStatePipelined(InsatStatePtrType state_ptr) {
 
+    if (VERBOSE) state_ptr->Print("Expanding");
+    planner_stats_.num_state_expansions_++;
+
+    state_ptr->SetVisited();
+
+    auto ancestors = getStateAncestors(state_ptr, true);
+    std::vector<StateVarsType> anc_states;
+    for (auto& anc: ancestors)
+    {
+      anc_states.emplace_back(anc->GetStateVars());
+    }
+    std::vector<InsatActionPtrType> actions;
+    std::vector<InsatStatePtrType> successors;
+    generateSuccessors(state_ptr, ancestors, actions, successors);
+
+    // An invalid incoming trajectory makes the action solve cold
+    const TrajType incoming_traj = (warm_start_ && state_ptr->GetIncomingInsatEdgePtr())?
+            state_ptr->GetIncomingInsatEdgePtr()->GetTraj() : TrajType();
+    CompletionQueue<TrajType> queue;
+    for (size_t i = 0; i < successors.size() && !cancel_token_.IsCancelled(); ++i)
+    {
+      actions[i]->optimizeAsync(incoming_traj, anc_states, successors[i]->GetStateVars(), queue, i);
+    }
+
+    // Every solve is drained before returning, the queue lives on this stack
+    std::exception_ptr error;
+    CompletionQueue<TrajType>::Completion completion;
+    while (queue.Next(completion))
+    {
+      if (completion.error_)
+      {
+        error = error? error : completion.error_;
+        continue;
+      }
+      relaxSuccessor(state_ptr, ancestors, actions[completion.tag_], successors[completion.tag_], completion.value_);
+    }
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void INSATxGCS::generateSuccessors(InsatStatePtrType& state_ptr,
+                                     std::vector<InsatStatePtrType>& ancestors,
+                                     std::vector<InsatActionPtrType>& actions,
+                                     std::vector<InsatStatePtrType>& successors) {
+    // Successors are generated serially, in the same order as expandState
+    for (auto& action_ptr: insat_actions_ptrs_)
+    {
+      if (action_ptr->CheckPreconditions(state_ptr->GetStateVars()))
+      {
+        auto action_successor = action_ptr->GetSuccessor(state_ptr->GetStateVars());
 #if OPTIMAL
-        /// counting number of incoming rewirings to the same state
-        ///////////////////////////////////////////////////////////
-        int state_key = static_cast<int>(successor_state_ptr->GetStateVars()[0]);
-        auto it = planner_stats_.num_incoming_edges_map_.find(state_key);
-        if (it == planner_stats_.num_incoming_edges_map_.end())
-        {
-          planner_stats_.num_incoming_edges_map_[state_key] = 0;
-          planner_stats_.num_incoming_edges_map_[state_key]++;
+        if (action_successor.success_) {
+          /// Do not allow cycles
+          for (const auto& anc : ancestors) {
+            if (anc->GetStateVars()[0] == action_successor.successor_state_vars_costs_.back().first[0]) {
+              action_successor.success_ = false;
+              break;
+            }
+          }
         }
-        else
+#endif
+        auto successor_state_ptr = evaluatedSuccessor(ancestors, action_successor);
+        if (successor_state_ptr)
         {
-          planner_stats_.num_incoming_edges_map_[state_key]++;
+          actions.emplace_back(action_ptr);
+          successors.emplace_back(successor_state_ptr);
         }
-        ///////////////////////////////////////////////////////////
+      }
+    }
+  }
+
+  InsatStatePtrType INSATxGCS::evaluatedSuccessor(std::vector<InsatStatePtrType> &ancestors,
+                                                  ActionSuccessor &action_successor) {
+    if (!action_successor.success_)
+    {
+      return NULL;
+    }
+
+#if OPTIMAL
+    auto successor_state_ptr = constructInsatPath(ancestors, action_successor.successor_state_vars_costs_.back().first);
+#else
+    auto successor_state_ptr = constructInsatState(action_successor.successor_state_vars_costs_.back().first);
 #endif
 
-        TrajType traj;
-        double cost = 0;
-        double inc_cost = 0;
-        InsatStatePtrType best_anc;
+    if (successor_state_ptr->IsVisited())
+    {
+      return NULL;
+    }
 
-        std::vector<StateVarsType> anc_states;
-        for (auto& anc: ancestors)
-        {
-          anc_states.emplace_back(anc->GetStateVars());
-        }
-        traj = action_ptr->optimize(anc_states, successor_state_ptr->GetStateVars());
+    planner_stats_.num_evaluated_edges_++;
 
-        if (!traj.isValid())
-        {
-          return;
-        }
+#if OPTIMAL
+    /// counting number of incoming rewirings to the same state
+    ///////////////////////////////////////////////////////////
+    int state_key = static_cast<int>(successor_state_ptr->GetStateVars()[0]);
+    auto it = planner_stats_.num_incoming_edges_map_.find(state_key);
+    if (it == planner_stats_.num_incoming_edges_map_.end())
+    {
+      planner_stats_.num_incoming_edges_map_[state_key] = 0;
+      planner_stats_.num_incoming_edges_map_[state_key]++;
+    }
+    else
+    {
+      planner_stats_.num_incoming_edges_map_[state_key]++;
+    }
+    ///////////////////////////////////////////////////////////
+#endif
 
-        cost = action_ptr->getCost(traj);
-        double new_g_val = cost;
-        inc_cost = state_ptr->GetIncomingInsatEdgePtr()?
-                action_ptr->getCost(traj) - action_ptr->getCost(state_ptr->GetIncomingInsatEdgePtr()->GetTraj()):
-                action_ptr->getCost(traj);
+    return successor_state_ptr;
+  }
+
+  TrajType INSATxGCS::optimizeSuccessor(const InsatStatePtrType &state_ptr,
+                                        const std::vector<StateVarsType> &anc_states,
+                                        InsatActionPtrType &action_ptr,
+                                        const InsatStatePtrType &successor_state_ptr,
+                                        int thread_id) {
+    if (cancel_token_.IsCancelled())
+    {
+      return TrajType();
+    }
+    if (warm_start_ && state_ptr->GetIncomingInsatEdgePtr())
+    {
+      return action_ptr->optimize(state_ptr->GetIncomingInsatEdgePtr()->GetTraj(),
+                                  anc_states, successor_state_ptr->GetStateVars(), thread_id);
+    }
+    return action_ptr->optimize(anc_states, successor_state_ptr->GetStateVars(), thread_id);
+  }
+
+  void INSATxGCS::relaxSuccessor(InsatStatePtrType &state_ptr, std::vector<InsatStatePtrType> &ancestors,
+                                 InsatActionPtrType &action_ptr, InsatStatePtrType &successor_state_ptr,
+                                 TrajType &traj) {
+    if (!traj.isValid())
+    {
+      return;
+    }
+
+    auto parent_traj = state_ptr->GetIncomingInsatEdgePtr()?
+            state_ptr->GetIncomingInsatEdgePtr()->GetCompactTraj() : CompactGCSTraj::Ptr();
+    double cost = action_ptr->getCost(traj);
+    double new_g_val = cost;
+    double inc_cost = parent_traj? cost - parent_traj->Cost() : cost;
+    InsatStatePtrType best_anc;
 
 #if OPTIMAL
 //        double lb = new_g_val + lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])];
-        double lb = state_ptr->GetGValue() + lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])];
+    double lb = state_ptr->GetGValue() + lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])];
 //        if (0.2*lb > ub_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])]) {
-        if (lb > ub_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])]) {
-          planner_stats_.num_pruned_edges_++;
+    if (lb > ub_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])]) {
+      planner_stats_.num_pruned_edges_++;
 #if VERBOSE
-          if (std::find(ub_path_.begin(), ub_path_.end(),successor_state_ptr->GetStateVars()[0])!=ub_path_.end()) {
-            printPath(ancestors);
-            std::cout << successor_state_ptr->GetStateVars()[0] << std::endl;
-          }
-            std::cout << "pruning cuz lb is " << lb << " g: " << state_ptr->GetGValue() << " h: " << lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])] << std::endl;
+      if (std::find(ub_path_.begin(), ub_path_.end(),successor_state_ptr->GetStateVars()[0])!=ub_path_.end()) {
+        printPath(ancestors);
+        std::cout << successor_state_ptr->GetStateVars()[0] << std::endl;
+      }
+        std::cout << "pruning cuz lb is " << lb << " g: " << state_ptr->GetGValue() << " h: " << lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])] << std::endl;
 #endif
-          return;
-        }
+      return;
+    }
 #endif
 
-        if (successor_state_ptr->GetGValue() > new_g_val)
-        {
-          best_anc = ancestors[0];
+    if (successor_state_ptr->GetGValue() > new_g_val)
+    {
+      best_anc = ancestors[0];
 
-          double h_val = successor_state_ptr->GetHValue();
-          if (h_val == -1)
-          {
-            h_val = computeHeuristic(successor_state_ptr);
+      double h_val = successor_state_ptr->GetHValue();
+      if (h_val == -1)
+      {
+        h_val = computeHeuristic(successor_state_ptr);
 //            h_val = lb_cost_[static_cast<int>(successor_state_ptr->GetStateVars()[0])];
-            successor_state_ptr->SetHValue(h_val);
-          }
+        successor_state_ptr->SetHValue(h_val);
+      }
 
-          if (h_val != DINF)
-          {
-            h_val_min_ = h_val < h_val_min_ ? h_val : h_val_min_;
-            successor_state_ptr->SetGValue(new_g_val); //
-            successor_state_ptr->SetFValue(new_g_val + heuristic_w_*h_val); //
-
-            auto edge_ptr = new Edge(state_ptr, action_ptr, successor_state_ptr);
-            edge_ptr->SetCost(inc_cost);
-            successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
-
-            auto insat_edge_ptr = new InsatEdge(state_ptr, action_ptr, best_anc, successor_state_ptr);
-            insat_edge_ptr->SetTraj(traj);
-            insat_edge_ptr->SetTrajCost(cost);
-            insat_edge_ptr->SetCost(cost);
-            if (isGoalState(successor_state_ptr))
-            {
-              insat_edge_ptr->SetTrajCost(0);
-              insat_edge_ptr->SetCost(0);
-              successor_state_ptr->SetFValue(0.0);
-            }
-            edge_map_.insert(std::make_pair(getEdgeKey(insat_edge_ptr), insat_edge_ptr));
-            successor_state_ptr->SetIncomingInsatEdgePtr(insat_edge_ptr); //
+      if (h_val != DINF)
+      {
+        h_val_min_ = h_val < h_val_min_ ? h_val : h_val_min_;
+        successor_state_ptr->SetGValue(new_g_val); //
+        successor_state_ptr->SetFValue(new_g_val + heuristic_w_*h_val); //
+
+        auto edge_ptr = new Edge(state_ptr, action_ptr, successor_state_ptr);
+        edge_ptr->SetCost(inc_cost);
+        successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
+
+        auto insat_edge_ptr = new InsatEdge(state_ptr, action_ptr, best_anc, successor_state_ptr);
+        insat_edge_ptr->SetTraj(traj, cost, parent_traj);
+        insat_edge_ptr->SetTrajCost(cost);
+        insat_edge_ptr->SetCost(cost);
+        if (isGoalState(successor_state_ptr))
+        {
+          insat_edge_ptr->SetTrajCost(0);
+          insat_edge_ptr->SetCost(0);
+          successor_state_ptr->SetFValue(0.0);
+        }
+        edge_map_.insert(std::make_pair(getEdgeKey(insat_edge_ptr), insat_edge_ptr));
+        successor_state_ptr->SetIncomingInsatEdgePtr(insat_edge_ptr); //
 
-            if (insat_state_open_list_.contains(successor_state_ptr))
-            {
-              insat_state_open_list_.decrease(successor_state_ptr);
-            }
-            else
-            {
-              insat_state_open_list_.push(successor_state_ptr);
-            }
-          }
+        if (insat_state_open_list_.contains(successor_state_ptr))
+        {
+          insat_state_open_list_.decrease(successor_state_ptr);
+        }
+        else
+        {
+          insat_state_open_list_.push(successor_state_ptr);
         }
       }
     }
   }
 
   void INSATxGCS::constructInsatActions() {
+    /// Called on every Plan, so a planner reused across queries must not accumulate actions
+    insat_actions_ptrs_.clear();
     for (auto& action_ptr : actions_ptrs_)
     {
       insat_actions_ptrs_.emplace_back(std::dynamic_pointer_cast<InsatAction>(action_ptr));
@@ -373,22 +577,8 @@ namespace ps
   }
 
   InsatStatePtrType INSATxGCS::constructInsatState(const StateVarsType &state) {
-    size_t key = state_key_generator_(state);
-    auto it = insat_state_map_.find(key);
-    InsatStatePtrType insat_state_ptr;
-
-    // Check if state exists in the search state map
-    if (it == insat_state_map_.end())
-    {
-      insat_state_ptr = new InsatState(state);
-      insat_state_map_.insert(std::pair<size_t, InsatStatePtrType>(key, insat_state_ptr));
-    }
-    else
-    {
-      insat_state_ptr = it->second;
-    }
-
-    return insat_state_ptr;
+    /// GCS states are keyed by their vertex id
+    return insat_state_store_.GetOrCreate(static_cast<size_t>(state[0]), state);
   }
 
   InsatStatePtrType
@@ -400,34 +590,13 @@ namespace ps
       boost::hash_combine(key, anc->GetStateVars()[0]);
     }
 
-    auto it = insat_state_map_.find(key);
-    InsatStatePtrType insat_state_ptr;
-
-    // Check if state exists in the search state map
-    if (it == insat_state_map_.end())
-    {
-      insat_state_ptr = new InsatState(state);
-      insat_state_map_.insert(std::pair<size_t, InsatStatePtrType>(key, insat_state_ptr));
-    }
-    else
-    {
-      insat_state_ptr = it->second;
-    }
-
-    return insat_state_ptr;
+    return insat_state_store_.GetOrCreateHashed(key, state);
   }
 
 
   void INSATxGCS::cleanUp() {
-    for (auto& state_it : insat_state_map_)
-    {
-      if (state_it.second)
-      {
-        delete state_it.second;
-        state_it.second = NULL;
-      }
-    }
-    insat_state_map_.clear();
+    insat_state_open_list_.clear();
+    insat_state_store_.Reset();
 
     for (auto& edge_it : edge_map_)
     {
@@ -439,22 +608,22 @@ namespace ps
     }
     edge_map_.clear();
 
-    State::ResetStateIDCounter();
-    Edge::ResetStateIDCounter();
+    /// The id counters are not reset: planners running concurrently in one process share them,
+    /// and only the relative order of the ids of a search matters for tie breaking.
   }
 
   void INSATxGCS::resetStates() {
-    for (auto it = insat_state_map_.begin(); it != insat_state_map_.end(); ++it)
+    insat_state_store_.ForEach([](InsatStatePtrType state_ptr)
     {
-      it->second->ResetGValue();
-      it->second->ResetFValue();
-      // it->second->ResetVValue();
-      it->second->ResetIncomingInsatEdgePtr();
-      it->second->UnsetVisited();
-      it->second->UnsetBeingExpanded();
-      it->second->num_successors_ = 0;
-      it->second->num_expanded_successors_ = 0;
-    }
+      state_ptr->ResetGValue();
+      state_ptr->ResetFValue();
+      // state_ptr->ResetVValue();
+      state_ptr->ResetIncomingInsatEdgePtr();
+      state_ptr->UnsetVisited();
+      state_ptr->UnsetBeingExpanded();
+      state_ptr->num_successors_ = 0;
+      state_ptr->num_expanded_successors_ = 0;
+    });
   }
 
   void INSATxGCS::constructPlan(InsatStatePtrType &insat_state_ptr) {
@@ -464,13 +633,25 @@ namespace ps
     if (insat_state_ptr->GetIncomingInsatEdgePtr())
     {
 //                planner_stats_.path_cost_ = insat_state_ptr->GetIncomingInsatEdgePtr()->GetTrajCost();
-      planner_stats_.path_cost_ =
-              insat_actions_ptrs_[0]->getCost(insat_state_ptr->GetIncomingInsatEdgePtr()->GetTraj());
       soln_traj_ = insat_state_ptr->GetIncomingInsatEdgePtr()->GetTraj();
+      planner_stats_.path_cost_ = insat_actions_ptrs_[0]->getCost(soln_traj_);
     }
   }
 
   void INSATxGCS::exit() {
+    planner_stats_.num_threads_spawned_ = 1;
+    if (successor_pool_)
+    {
+      planner_stats_.num_threads_spawned_ += successor_pool_->NumWorkersStarted();
+      recordWorkerPlacement(*successor_pool_);
+      successor_pool_->UnpinCallingThread();
+      if (!planner_params_["persistent_pool"])
+      {
+        successor_pool_.reset();
+      }
+    }
+    cancel_token_.Reset();
+
     // Clear open list
     while (!insat_state_open_list_.empty())
     {
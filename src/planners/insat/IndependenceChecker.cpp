@@ -0,0 +1,71 @@
+#include <planners/insat/IndependenceChecker.hpp>
+
+using namespace std;
+using namespace ps;
+
+IndependenceChecker::IndependenceChecker(HeuristicType heuristic,
+                                         BatchHeuristicType batch_heuristic,
+                                         double heuristic_w):
+        heuristic_(heuristic), batch_heuristic_(batch_heuristic), heuristic_w_(heuristic_w)
+{
+
+}
+
+bool IndependenceChecker::IsIndependent(const StatePtrType& state_ptr, const vector<StatePtrType>& other_state_ptrs)
+{
+  double g_val = state_ptr->GetGValue();
+
+  // Cached pairs first, they can reject without evaluating anything
+  pending_.clear();
+  for (auto& other_ptr : other_state_ptrs)
+  {
+    double other_g_val = other_ptr->GetGValue();
+    if (other_ptr == state_ptr || other_g_val >= g_val)
+      continue;
+
+    auto it = h_cache_.find(pairKey(other_ptr, state_ptr));
+    if (it == h_cache_.end())
+    {
+      pending_.emplace_back(other_ptr);
+    }
+    else if (g_val > other_g_val + heuristic_w_*it->second)
+    {
+      return false;
+    }
+  }
+
+  if (pending_.empty())
+    return true;
+
+  if (batch_heuristic_)
+  {
+    batch_heuristic_(pending_, state_ptr, h_vals_);
+    num_heuristic_calls_ += 1;
+
+    bool independent = true;
+    for (int i = 0; i < pending_.size(); ++i)
+    {
+      h_cache_[pairKey(pending_[i], state_ptr)] = h_vals_[i];
+      if (g_val > pending_[i]->GetGValue() + heuristic_w_*h_vals_[i])
+        independent = false;
+    }
+    return independent;
+  }
+
+  // One at a time, stopping at the first dependent state
+  for (auto& other_ptr : pending_)
+  {
+    double h_val = heuristic_(other_ptr, state_ptr);
+    num_heuristic_calls_ += 1;
+    h_cache_[pairKey(other_ptr, state_ptr)] = h_val;
+    if (g_val > other_ptr->GetGValue() + heuristic_w_*h_val)
+      return false;
+  }
+  return true;
+}
+
+void IndependenceChecker::Clear()
+{
+  h_cache_.clear();
+  num_heuristic_calls_ = 0;
+}
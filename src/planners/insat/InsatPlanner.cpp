@@ -182,7 +182,7 @@ namespace ps
                         traj = action_ptr->optimize(state_ptr->GetIncomingInsatEdgePtr()->GetTraj(),
                                                     anc_states,
                                                     successor_state_ptr->GetStateVars());
-                        inc_cost = action_ptr->getCost(traj) - action_ptr->getCost(state_ptr->GetIncomingInsatEdgePtr()->GetTraj());
+                        inc_cost = action_ptr->getCost(traj) - state_ptr->GetIncomingInsatEdgePtr()->GetCompactTraj()->Cost();
                     }
                     else
                     {
@@ -207,8 +207,7 @@ namespace ps
                                 traj = action_ptr->optimize(anc->GetIncomingInsatEdgePtr()->GetTraj(),
                                                             anc->GetStateVars(),
                                                             successor_state_ptr->GetStateVars());
-                                inc_cost = action_ptr->getCost(traj) - action_ptr->getCost(
-                                    anc->GetIncomingInsatEdgePtr()->GetTraj());
+                                inc_cost = action_ptr->getCost(traj) - anc->GetIncomingInsatEdgePtr()->GetCompactTraj()->Cost();
                             }
                             else
                             {
@@ -275,7 +274,8 @@ namespace ps
                         successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
 
                         auto insat_edge_ptr = new InsatEdge(state_ptr, action_ptr, best_anc, successor_state_ptr);
-                        insat_edge_ptr->SetTraj(traj);
+                        auto prefix_edge_ptr = state_ptr->GetIncomingInsatEdgePtr();
+                        insat_edge_ptr->SetTraj(traj, cost, prefix_edge_ptr? prefix_edge_ptr->GetCompactTraj() : CompactGCSTraj::Ptr());
                         insat_edge_ptr->SetTrajCost(cost);
                         insat_edge_ptr->SetCost(cost);
                         if (isGoalState(successor_state_ptr))
@@ -310,33 +310,13 @@ namespace ps
 
     InsatStatePtrType InsatPlanner::constructInsatState(const StateVarsType &state) {
         size_t key = state_key_generator_(state);
-        auto it = insat_state_map_.find(key);
-        InsatStatePtrType insat_state_ptr;
-
-        // Check if state exists in the search state map
-        if (it == insat_state_map_.end())
-        {
-            insat_state_ptr = new InsatState(state);
-            insat_state_map_.insert(std::pair<size_t, InsatStatePtrType>(key, insat_state_ptr));
-        }
-        else
-        {
-            insat_state_ptr = it->second;
-        }
-
-        return insat_state_ptr;
+        // Lock free if the state exists, PinsatPlanner workers construct states concurrently
+        return insat_state_map_.FindOrInsert(key, [&state](){return new InsatState(state);});
     }
 
     void InsatPlanner::cleanUp() {
-        for (auto& state_it : insat_state_map_)
-        {
-            if (state_it.second)
-            {
-                delete state_it.second;
-                state_it.second = NULL;
-            }
-        }
-        insat_state_map_.clear();
+        insat_state_map_.ForEach([](size_t key, InsatStatePtrType state_ptr){delete state_ptr;});
+        insat_state_map_.Clear();
 
         for (auto& edge_it : edge_map_)
         {
@@ -353,17 +333,17 @@ namespace ps
     }
 
     void InsatPlanner::resetStates() {
-        for (auto it = insat_state_map_.begin(); it != insat_state_map_.end(); ++it)
+        insat_state_map_.ForEach([](size_t key, InsatStatePtrType state_ptr)
         {
-            it->second->ResetGValue();
-            it->second->ResetFValue();
-            // it->second->ResetVValue();
-          it->second->ResetIncomingInsatEdgePtr();
-            it->second->UnsetVisited();
-            it->second->UnsetBeingExpanded();
-            it->second->num_successors_ = 0;
-            it->second->num_expanded_successors_ = 0;
-        }
+            state_ptr->ResetGValue();
+            state_ptr->ResetFValue();
+            // state_ptr->ResetVValue();
+            state_ptr->ResetIncomingInsatEdgePtr();
+            state_ptr->UnsetVisited();
+            state_ptr->UnsetBeingExpanded();
+            state_ptr->num_successors_ = 0;
+            state_ptr->num_expanded_successors_ = 0;
+        });
     }
 
     void InsatPlanner::constructPlan(InsatStatePtrType &insat_state_ptr) {
@@ -373,9 +353,8 @@ namespace ps
       if (insat_state_ptr->GetIncomingInsatEdgePtr())
         {
 //                planner_stats_.path_cost_ = insat_state_ptr->GetIncomingInsatEdgePtr()->GetTrajCost();
-            planner_stats_.path_cost_ =
-                    insat_actions_ptrs_[0]->getCost(insat_state_ptr->GetIncomingInsatEdgePtr()->GetTraj());
             soln_traj_ = insat_state_ptr->GetIncomingInsatEdgePtr()->GetTraj();
+            planner_stats_.path_cost_ = insat_actions_ptrs_[0]->getCost(soln_traj_);
         }
     }
 
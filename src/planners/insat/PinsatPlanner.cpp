@@ -150,42 +150,15 @@ bool PinsatPlanner::Plan()
 
         lock_.unlock();
 
-        int thread_id = 0;
-        bool edge_expansion_assigned = false;
-
         if (num_threads_ == 1)
         {
             expand(curr_edge_ptr, 0);
         }
         else
         {
-            while (!edge_expansion_assigned)
-            {
-                unique_lock<mutex> locker(lock_vec_[thread_id]);
-                bool status = edge_expansion_status_[thread_id];
-                locker.unlock();
-
-                if (!status)
-                {
-                    int num_threads_current = edge_expansion_futures_.size();
-                    if (thread_id >= num_threads_current)
-                    {
-                        if (VERBOSE) cout << "Spawning edge expansion thread " << thread_id << endl;
-                        edge_expansion_futures_.emplace_back(async(launch::async, &PinsatPlanner::expandEdgeLoop, this, thread_id));
-                    }
-                    locker.lock();
-                    edge_expansion_vec_[thread_id] = curr_edge_ptr;
-                    edge_expansion_status_[thread_id] = 1;
-                    edge_expansion_assigned = true;       
-                    locker.unlock();
-                    cv_vec_[thread_id].notify_one();
-                }
-                else
-                {
-                    thread_id = thread_id == num_threads_-2 ? 0 : thread_id+1;
-                }
-
-            }
+            // Hand the edge over as soon as a worker is free
+            pool_->WaitForIdleWorker();
+            pool_->Submit([this, curr_edge_ptr](int thread_id){expand(curr_edge_ptr, thread_id);});
         }
 
         lock_.lock();
@@ -218,16 +191,15 @@ void PinsatPlanner::initialize()
     terminate_ = false;
     recheck_flag_ = true;
 
-    edge_expansion_vec_.clear();
-    edge_expansion_vec_.resize(num_threads_-1, NULL);
-    
-    edge_expansion_status_.clear();
-    edge_expansion_status_.resize(num_threads_-1, 0);
-
-    vector<condition_variable> cv_vec(num_threads_-1);
-    cv_vec_.swap(cv_vec);
-
-    edge_expansion_futures_.clear();
+    // A persistent pool is kept from the previous query, along with its started threads
+    if ((num_threads_ > 1) && !pool_)
+    {
+        pool_ = makeWorkerPool(num_threads_-1);
+    }
+    if (pool_)
+    {
+        pinSearchThread(*pool_);
+    }
 
     // Insert proxy edge with start state
     start_state_ptr_->SetGValue(0);
@@ -236,34 +208,13 @@ void PinsatPlanner::initialize()
     auto edge_ptr = new InsatEdge(start_state_ptr_, dummy_action_ptr_);
     edge_ptr->expansion_priority_ = heuristic_w_*computeHeuristic(start_state_ptr_);
 
-    edge_map_.insert(make_pair(getEdgeKey(edge_ptr), edge_ptr));
+    concurrent_edge_map_.Insert(getEdgeKey(edge_ptr), edge_ptr);
     edge_open_list_.push(edge_ptr);   
     
     constructInsatActions();
 
 }
 
-void PinsatPlanner::expandEdgeLoop(int thread_id)
-{
-    while (!terminate_)
-    {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        cv_vec_[thread_id].wait(locker, [this, thread_id](){return (edge_expansion_status_[thread_id] == 1);});
-        locker.unlock();
-
-        if (terminate_)
-            break;
-
-        expand(edge_expansion_vec_[thread_id], thread_id);
-
-        locker.lock();
-        edge_expansion_vec_[thread_id] = NULL;
-        edge_expansion_status_[thread_id] = 0;
-        locker.unlock();
-
-    }    
-}
-
 void PinsatPlanner::expand(InsatEdgePtrType edge_ptr, int thread_id)
 {
     planner_stats_.num_jobs_per_thread_[thread_id] +=1;
@@ -285,7 +236,7 @@ void PinsatPlanner::expand(InsatEdgePtrType edge_ptr, int thread_id)
             if (action_ptr->CheckPreconditions(state_ptr->GetStateVars()))
             {
                 auto edge_ptr_next = new InsatEdge(state_ptr, action_ptr);
-                edge_map_.insert(make_pair(getEdgeKey(edge_ptr_next), edge_ptr_next));
+                concurrent_edge_map_.Insert(getEdgeKey(edge_ptr_next), edge_ptr_next);
                 edge_ptr_next->expansion_priority_ = edge_ptr->expansion_priority_;
                 state_ptr->num_successors_+=1;
 
@@ -388,8 +339,7 @@ void PinsatPlanner::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
                     traj = action_ptr->optimize(ancestors.front()->GetIncomingInsatEdgePtr()->GetTraj(),
                                                 anc_states,
                                                 successor_state_ptr->GetStateVars(), thread_id);
-                    inc_cost = action_ptr->getCost(traj) - action_ptr->getCost(
-                        ancestors.front()->GetIncomingInsatEdgePtr()->GetTraj());
+                    inc_cost = action_ptr->getCost(traj) - ancestors.front()->GetIncomingInsatEdgePtr()->GetCompactTraj()->Cost();
                 }
                 else
                 {
@@ -414,7 +364,7 @@ void PinsatPlanner::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
                             traj = action_ptr->optimize(anc->GetIncomingInsatEdgePtr()->GetTraj(),
                                                         anc->GetStateVars(),
                                                         successor_state_ptr->GetStateVars(), thread_id);
-                            inc_cost = action_ptr->getCost(traj) - action_ptr->getCost(anc->GetIncomingInsatEdgePtr()->GetTraj());
+                            inc_cost = action_ptr->getCost(traj) - anc->GetIncomingInsatEdgePtr()->GetCompactTraj()->Cost();
                         }
                         else
                         {
@@ -488,7 +438,8 @@ void PinsatPlanner::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
                         edge_ptr->SetCost(inc_cost);
                         successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
 
-                        insat_edge_ptr->SetTraj(traj);
+                        auto prefix_edge_ptr = insat_edge_ptr->lowD_parent_state_ptr_->GetIncomingInsatEdgePtr();
+                        insat_edge_ptr->SetTraj(traj, cost, prefix_edge_ptr? prefix_edge_ptr->GetCompactTraj() : CompactGCSTraj::Ptr());
                         insat_edge_ptr->SetTrajCost(cost);
                         insat_edge_ptr->SetCost(cost);
                         if (isGoalState(successor_state_ptr))
@@ -501,18 +452,8 @@ void PinsatPlanner::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
                         // Insert poxy edge
                         auto edge_temp = Edge(successor_state_ptr, dummy_action_ptr_);
                         auto edge_key = getEdgeKey(&edge_temp);
-                        auto it_edge = edge_map_.find(edge_key); 
-                        InsatEdgePtrType proxy_edge_ptr;
-
-                        if (it_edge == edge_map_.end())
-                        {
-                            proxy_edge_ptr = new InsatEdge(successor_state_ptr, dummy_action_ptr_);
-                            edge_map_.insert(make_pair(edge_key, proxy_edge_ptr));
-                        }
-                        else
-                        {
-                            proxy_edge_ptr = dynamic_cast<InsatEdgePtrType>(it_edge->second);
-                        }
+                        auto proxy_edge_ptr = dynamic_cast<InsatEdgePtrType>(concurrent_edge_map_.FindOrInsert(edge_key,
+                            [&](){return new InsatEdge(successor_state_ptr, dummy_action_ptr_);}));
 
                         proxy_edge_ptr->expansion_priority_ = new_g_val + heuristic_w_*h_val;
                         
@@ -544,29 +485,21 @@ void PinsatPlanner::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
 
 void PinsatPlanner::exit()
 {
-    for (int thread_id = 0; thread_id < num_threads_-1; ++thread_id)
+    // Let the in-flight expansions finish before the states are released. Actions honoring the
+    // cancellation cut their optimizations short.
+    planner_stats_.num_threads_spawned_ = 1;
+    if (pool_)
     {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        edge_expansion_status_[thread_id] = 1;
-        locker.unlock();
-        cv_vec_[thread_id].notify_one();
-    }
-
-    planner_stats_.num_threads_spawned_ = edge_expansion_futures_.size()+1;
-    bool all_expansion_threads_terminated = false;
-    while (!all_expansion_threads_terminated)
-    {
-        all_expansion_threads_terminated = true;
-        for (auto& fut : edge_expansion_futures_)
+        cancel_token_.Cancel();
+        pool_->WaitAll();
+        planner_stats_.num_threads_spawned_ += pool_->NumWorkersStarted();
+        recordWorkerPlacement(*pool_);
+        pool_->UnpinCallingThread();
+        if (!planner_params_["persistent_pool"])
         {
-            if (!isFutureReady(fut))
-            {
-                all_expansion_threads_terminated = false;
-                break;
-            }
+            pool_.reset();
         }
     }
-    edge_expansion_futures_.clear();
     
     // Clear open list
     while (!edge_open_list_.empty())
@@ -577,27 +510,14 @@ void PinsatPlanner::exit()
     // Clear BE
     being_expanded_states_.clear();
 
-    for (auto& state_it : insat_state_map_)
-    {
-        if (state_it.second)
-        {
-            delete state_it.second;
-            state_it.second = NULL;
-        }
-    }
-    insat_state_map_.clear();
+    insat_state_map_.ForEach([](size_t key, InsatStatePtrType state_ptr){delete state_ptr;});
+    insat_state_map_.Clear();
 
     // Planner::exit();
-    for (auto& edge_it : edge_map_)
-    {
-        if (edge_it.second)
-        {
-            delete edge_it.second;
-            edge_it.second = NULL;
-        }
-    }
-    edge_map_.clear();
+    concurrent_edge_map_.ForEach([](size_t key, EdgePtrType edge_ptr){delete edge_ptr;});
+    concurrent_edge_map_.Clear();
     
     State::ResetStateIDCounter();
     Edge::ResetStateIDCounter();
+    cancel_token_.Reset();
 }
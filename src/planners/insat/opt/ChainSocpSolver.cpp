@@ -0,0 +1,636 @@
+/*!
+ * \file ChainSocpSolver.cpp
+ * \brief Interior point solver for the conic problems of a path of GCS vertices
+*/
+
+#include <planners/insat/opt/ChainSocpSolver.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace ps {
+
+  namespace {
+
+    /// out = rows x
+    void multiplyRows(const ConicRows& rows, const Eigen::VectorXd& x, Eigen::Ref<Eigen::VectorXd> out) {
+      for (int r=0; r<rows.NumRows(); ++r) {
+        double sum = 0;
+        for (int k=rows.row_ptr_[r]; k<rows.row_ptr_[r+1]; ++k) {
+          sum += rows.vals_[k]*x(rows.cols_[k]);
+        }
+        out(r) = sum;
+      }
+    }
+
+    /// out += alpha rows' v
+    void multiplyRowsTransposeAdd(const ConicRows& rows, const Eigen::Ref<const Eigen::VectorXd>& v,
+                                  Eigen::VectorXd& out, double alpha = 1) {
+      for (int r=0; r<rows.NumRows(); ++r) {
+        for (int k=rows.row_ptr_[r]; k<rows.row_ptr_[r+1]; ++k) {
+          out(rows.cols_[k]) += alpha*rows.vals_[k]*v(r);
+        }
+      }
+    }
+
+    /// out = G x, G being the inequality rows followed by the cone rows
+    void multiplyCones(const ConicProblem& prob, const Eigen::VectorXd& x, Eigen::VectorXd& out) {
+      multiplyRows(prob.ineq_, x, out.head(prob.NumIneq()));
+      multiplyRows(prob.soc_, x, out.tail(prob.soc_.NumRows()));
+    }
+
+    /// out += alpha G' v
+    void multiplyConesTransposeAdd(const ConicProblem& prob, const Eigen::VectorXd& v,
+                                   Eigen::VectorXd& out, double alpha = 1) {
+      multiplyRowsTransposeAdd(prob.ineq_, v.head(prob.NumIneq()), out, alpha);
+      multiplyRowsTransposeAdd(prob.soc_, v.tail(prob.soc_.NumRows()), out, alpha);
+    }
+
+  }
+
+  ChainSocpSolver::Status ChainSocpSolver::Solve(const ConicProblem& prob, double time_limit) {
+    const auto start_time = std::chrono::steady_clock::now();
+    iterations_ = 0;
+    if (!setupStructure(prob)) {
+      return Status::kUnsupported;
+    }
+    if (!initialize(prob)) {
+      return Status::kNumericalError;
+    }
+
+    const double b_norm = std::max(1.0, b_.norm());
+    const double h_norm = std::max(1.0, h_.norm());
+    const double c_norm = std::max(1.0, prob.C().norm());
+
+    for (iterations_=0; iterations_<settings_.max_iter_; ++iterations_) {
+      /// Residuals of A'y + G'z + c = 0, Ax = b, Gx + s = h
+      rx_ = prob.C();
+      multiplyRowsTransposeAdd(prob.eq_, y_, rx_);
+      multiplyConesTransposeAdd(prob, z_, rx_);
+      multiplyRows(prob.eq_, x_, ry_);
+      ry_ -= b_;
+      multiplyCones(prob, x_, rz_);
+      rz_ += s_ - h_;
+
+      const double gap = s_.dot(z_);
+      const double pcost = prob.C().dot(x_);
+      const double dcost = -b_.dot(y_) - h_.dot(z_);
+      const double pres = std::max(ry_.norm()/b_norm, rz_.norm()/h_norm);
+      const double dres = rx_.norm()/c_norm;
+      const double min_cost = std::min(std::abs(pcost), std::abs(dcost));
+      if (pres < settings_.feas_tol_ && dres < settings_.feas_tol_ &&
+          (gap < settings_.abs_gap_tol_ || (min_cost > 0 && gap/min_cost < settings_.rel_gap_tol_))) {
+        cost_ = pcost + prob.c0_;
+        return Status::kSolved;
+      }
+
+      const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+      if (elapsed > time_limit) {
+        return Status::kTimeLimit;
+      }
+
+      if (!computeScaling() || !factor(prob)) {
+        return Status::kNumericalError;
+      }
+      const double mu = (degree_ > 0)? gap/degree_ : 0;
+      rx_ = -rx_;
+      ry_ = -ry_;
+      rz_ = -rz_;
+
+      /// Predictor: complementarity -lambda o lambda, so lambda \ rs = -lambda
+      rs_ = -lambda_;
+      solveNewton(prob, rx_, ry_, rz_, rs_, dx_aff_, dy_aff_, dz_aff_, ds_aff_);
+      const double alpha_aff = std::min({1.0, maxStep(s_, ds_aff_), maxStep(z_, dz_aff_)});
+      const double sigma = std::pow(1 - alpha_aff, 3);
+
+      /// Corrector: -lambda o lambda + sigma mu e - (W^-1 ds_aff) o (W dz_aff)
+      applyW(ds_aff_, tmp_cone_, true);
+      applyW(dz_aff_, tmp_cone2_, false);
+      jordanProduct(tmp_cone_, tmp_cone2_, tmp_cone3_);
+      jordanProduct(lambda_, lambda_, tmp_cone_);
+      tmp_cone_ += tmp_cone3_;
+      tmp_cone_ = -tmp_cone_;
+      addIdentity(tmp_cone_, sigma*mu);
+      jordanDivide(lambda_, tmp_cone_, rs_);
+      solveNewton(prob, rx_, ry_, rz_, rs_, dx_, dy_, dz_, ds_);
+
+      if (!dx_.allFinite() || !dy_.allFinite() || !dz_.allFinite() || !ds_.allFinite()) {
+        return Status::kNumericalError;
+      }
+      const double alpha = std::min(1.0, settings_.step_fraction_*std::min(maxStep(s_, ds_), maxStep(z_, dz_)));
+      if (alpha < 1e-10) {
+        return Status::kNumericalError;
+      }
+      x_ += alpha*dx_;
+      y_ += alpha*dy_;
+      z_ += alpha*dz_;
+      s_ += alpha*ds_;
+    }
+    return Status::kMaxIterations;
+  }
+
+  bool ChainSocpSolver::setupStructure(const ConicProblem& prob) {
+    num_blocks_ = prob.col_offsets_.size();
+    if (num_blocks_ == 0) {
+      return false;
+    }
+    num_ineq_ = prob.NumIneq();
+    num_cone_rows_ = prob.NumIneq() + prob.soc_.NumRows();
+    degree_ = prob.NumIneq() + prob.soc_dims_.size();
+
+    col_block_.resize(prob.num_vars_);
+    for (int b=0; b<num_blocks_; ++b) {
+      const int col_end = (b+1 < num_blocks_)? prob.col_offsets_[b+1] : prob.num_vars_;
+      std::fill(col_block_.begin()+prob.col_offsets_[b], col_block_.begin()+col_end, b);
+    }
+
+    /// First block touched by rows [row_begin, row_end), -1 if they touch more than a block and
+    /// its successor. links is set if they touch the successor.
+    auto row_span = [&](const ConicRows& rows, int row_begin, int row_end, bool& links) {
+      int lo = num_blocks_, hi = -1;
+      for (int k=rows.row_ptr_[row_begin]; k<rows.row_ptr_[row_end]; ++k) {
+        lo = std::min(lo, col_block_[rows.cols_[k]]);
+        hi = std::max(hi, col_block_[rows.cols_[k]]);
+      }
+      links = hi > lo;
+      if (hi < 0) {
+        return 0;
+      }
+      return (hi - lo > 1)? -1 : lo;
+    };
+
+    /// Stacked unknowns of a block: its columns, the equality rows and the cone rows it owns,
+    /// with the rows that link to the next block last. A row (or a whole cone) is owned by the
+    /// first block it touches.
+    bool links;
+    block_size_.assign(num_blocks_, 0);
+    for (int c=0; c<prob.num_vars_; ++c) {
+      ++block_size_[col_block_[c]];
+    }
+    row_block_.resize(prob.NumEq());
+    row_links_.resize(prob.NumEq());
+    for (int r=0; r<prob.NumEq(); ++r) {
+      row_block_[r] = row_span(prob.eq_, r, r+1, links);
+      row_links_[r] = links;
+      if (row_block_[r] < 0) {
+        return false;
+      }
+      ++block_size_[row_block_[r]];
+    }
+    for (int r=0; r<prob.NumIneq(); ++r) {
+      if (row_span(prob.ineq_, r, r+1, links) < 0) {
+        return false;
+      }
+    }
+    soc_offset_.resize(prob.soc_dims_.size());
+    soc_block_.resize(prob.soc_dims_.size());
+    soc_links_.resize(prob.soc_dims_.size());
+    int row = 0;
+    for (size_t k=0; k<prob.soc_dims_.size(); ++k) {
+      soc_offset_[k] = num_ineq_+row;
+      soc_block_[k] = row_span(prob.soc_, row, row+prob.soc_dims_[k], links);
+      soc_links_[k] = links;
+      if (soc_block_[k] < 0) {
+        return false;
+      }
+      block_size_[soc_block_[k]] += prob.soc_dims_[k];
+      row += prob.soc_dims_[k];
+    }
+
+    block_offset_.resize(num_blocks_+1);
+    block_offset_[0] = 0;
+    for (int b=0; b<num_blocks_; ++b) {
+      block_offset_[b+1] = block_offset_[b] + block_size_[b];
+    }
+    pos_block_.resize(block_offset_[num_blocks_]);
+    for (int b=0; b<num_blocks_; ++b) {
+      std::fill(pos_block_.begin()+block_offset_[b], pos_block_.begin()+block_offset_[b+1], b);
+      block_size_[b] = block_offset_[b];
+    }
+    /// block_size_ now holds the next free position of each block
+    col_pos_.resize(prob.num_vars_);
+    for (int c=0; c<prob.num_vars_; ++c) {
+      col_pos_[c] = block_size_[col_block_[c]]++;
+    }
+    row_pos_.resize(prob.NumEq());
+    cone_pos_.resize(num_cone_rows_);
+    for (const bool linking : {false, true}) {
+      for (int r=0; r<prob.NumEq(); ++r) {
+        if (row_links_[r] == linking) {
+          row_pos_[r] = block_size_[row_block_[r]]++;
+        }
+      }
+      for (size_t k=0; k<soc_offset_.size(); ++k) {
+        for (int i=0; soc_links_[k] == linking && i<prob.soc_dims_[k]; ++i) {
+          cone_pos_[soc_offset_[k]+i] = block_size_[soc_block_[k]]++;
+        }
+      }
+    }
+    for (int b=0; b<num_blocks_; ++b) {
+      block_size_[b] = block_offset_[b+1] - block_offset_[b];
+    }
+
+    /// Nonzero part of each B_i, from the rows coupling block i+1 with block i
+    link_begin_.resize(num_blocks_-1);
+    link_rows_.assign(num_blocks_-1, 0);
+    for (int b=0; b+1<num_blocks_; ++b) {
+      link_begin_[b] = block_size_[b];
+    }
+    auto link = [&](int p1, int p2) {
+      for (const auto& p : {std::make_pair(p1, p2), std::make_pair(p2, p1)}) {
+        const int b = pos_block_[p.second];
+        if (pos_block_[p.first] == b+1) {
+          link_begin_[b] = std::min(link_begin_[b], p.second-block_offset_[b]);
+          link_rows_[b] = std::max(link_rows_[b], p.first-block_offset_[b+1]+1);
+        }
+      }
+    };
+    const ConicRows& ineq = prob.ineq_;
+    for (int i=0; i<num_ineq_; ++i) {
+      for (int k1=ineq.row_ptr_[i]; k1<ineq.row_ptr_[i+1]; ++k1) {
+        for (int k2=k1+1; k2<ineq.row_ptr_[i+1]; ++k2) {
+          link(col_pos_[ineq.cols_[k1]], col_pos_[ineq.cols_[k2]]);
+        }
+      }
+    }
+    const ConicRows& eq = prob.eq_;
+    for (int r=0; r<eq.NumRows(); ++r) {
+      for (int k=eq.row_ptr_[r]; k<eq.row_ptr_[r+1]; ++k) {
+        link(row_pos_[r], col_pos_[eq.cols_[k]]);
+      }
+    }
+    const ConicRows& soc = prob.soc_;
+    for (int r=0; r<soc.NumRows(); ++r) {
+      for (int k=soc.row_ptr_[r]; k<soc.row_ptr_[r+1]; ++k) {
+        link(cone_pos_[num_ineq_+r], col_pos_[soc.cols_[k]]);
+      }
+    }
+
+    schur_.resize(num_blocks_);
+    lu_.resize(num_blocks_);
+    sub_.resize(num_blocks_-1);
+    gain_.resize(num_blocks_-1);
+    int max_block = 0;
+    for (int b=0; b<num_blocks_; ++b) {
+      schur_[b].resize(block_size_[b], block_size_[b]);
+      if (b+1 < num_blocks_) {
+        sub_[b].resize(block_size_[b+1], block_size_[b]);
+        gain_[b].resize(block_size_[b], link_rows_[b]);
+      }
+      max_block = std::max(max_block, block_size_[b]);
+    }
+    block_tmp_.resize(max_block);
+    gain_rhs_.resize(max_block, max_block);
+    soc_w2_.resize(prob.soc_dims_.size());
+    for (size_t k=0; k<prob.soc_dims_.size(); ++k) {
+      soc_w2_[k].resize(prob.soc_dims_[k], prob.soc_dims_[k]);
+    }
+    soc_eta_.resize(prob.soc_dims_.size());
+
+    for (auto* v : {&x_, &rx_, &dx_, &dx_aff_, &vx_, &res_x_, &corr_x_}) {
+      v->resize(prob.num_vars_);
+    }
+    for (auto* v : {&y_, &ry_, &b_, &dy_, &dy_aff_, &res_y_, &corr_y_}) {
+      v->resize(prob.NumEq());
+    }
+    for (auto* v : {&z_, &s_, &rz_, &h_, &dz_, &ds_, &dz_aff_, &ds_aff_, &rs_, &lambda_, &lp_scale_,
+                    &soc_wbar_, &tmp_cone_, &tmp_cone2_, &tmp_cone3_, &ref_cone_, &res_z_, &corr_z_}) {
+      v->resize(num_cone_rows_);
+    }
+    kkt_.resize(block_offset_[num_blocks_]);
+    b_ = Eigen::Map<const Eigen::VectorXd>(prob.eq_.b_.data(), prob.NumEq());
+    h_.head(num_ineq_) = Eigen::Map<const Eigen::VectorXd>(prob.ineq_.b_.data(), num_ineq_);
+    h_.tail(prob.soc_.NumRows()) = Eigen::Map<const Eigen::VectorXd>(prob.soc_.b_.data(), prob.soc_.NumRows());
+    return true;
+  }
+
+  bool ChainSocpSolver::initialize(const ConicProblem& prob) {
+    /// With identity scaling the KKT system gives the least squares s with Gx + s = h, Ax = b as
+    /// the primal start and the least norm z with G'z + A'y + c = 0 as the dual start. Both are
+    /// then pushed into the interior of the cone.
+    lp_scale_.setOnes();
+    for (auto& w2 : soc_w2_) {
+      w2.setIdentity();
+    }
+    if (!factor(prob)) {
+      return false;
+    }
+
+    vx_.setZero();
+    solveKKT(prob, vx_, b_, h_, x_, y_, z_);
+    multiplyCones(prob, x_, s_);
+    s_ = h_ - s_;
+
+    vx_ = -prob.C();
+    res_y_.setZero();
+    res_z_.setZero();
+    solveKKT(prob, vx_, res_y_, res_z_, dx_, y_, z_);
+
+    for (auto* u : {&s_, &z_}) {
+      const double shift = shiftToCone(*u);
+      if (shift >= 0) {
+        addIdentity(*u, 1 + shift);
+      }
+    }
+    return true;
+  }
+
+  bool ChainSocpSolver::computeScaling() {
+    for (int i=0; i<num_ineq_; ++i) {
+      if (s_(i) <= 0 || z_(i) <= 0) {
+        return false;
+      }
+      lp_scale_(i) = std::sqrt(s_(i)/z_(i));
+    }
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      const auto s = s_.segment(o, q);
+      const auto z = z_.segment(o, q);
+      const double s_res = s(0)*s(0) - s.tail(q-1).squaredNorm();
+      const double z_res = z(0)*z(0) - z.tail(q-1).squaredNorm();
+      if (s(0) <= 0 || z(0) <= 0 || s_res <= 0 || z_res <= 0) {
+        return false;
+      }
+      const double s_norm = std::sqrt(s_res), z_norm = std::sqrt(z_res);
+      const double gamma = std::sqrt((1 + s.dot(z)/(s_norm*z_norm))/2);
+      auto w = soc_wbar_.segment(o, q);
+      w(0) = (s(0)/s_norm + z(0)/z_norm)/(2*gamma);
+      w.tail(q-1) = (s.tail(q-1)/s_norm - z.tail(q-1)/z_norm)/(2*gamma);
+      soc_eta_[k] = std::sqrt(s_norm/z_norm);
+
+      /// W^2 = eta^2 (2 w w' - J)
+      auto& w2 = soc_w2_[k];
+      w2.noalias() = 2*w*w.transpose();
+      w2(0, 0) -= 1;
+      w2.diagonal().tail(q-1).array() += 1;
+      w2 *= soc_eta_[k]*soc_eta_[k];
+    }
+    applyW(z_, lambda_, false);
+    return true;
+  }
+
+  void ChainSocpSolver::addEntry(int p1, int p2, double val) {
+    const int b1 = pos_block_[p1], b2 = pos_block_[p2];
+    if (b1 == b2) {
+      schur_[b1](p1-block_offset_[b1], p2-block_offset_[b2]) += val;
+    } else if (b1 == b2+1) {
+      sub_[b2](p1-block_offset_[b1], p2-block_offset_[b2]) += val;
+    }
+  }
+
+  bool ChainSocpSolver::factor(const ConicProblem& prob) {
+    for (auto& d : schur_) {
+      d.setZero();
+    }
+    for (auto& d : sub_) {
+      d.setZero();
+    }
+
+    /// Inequalities are eliminated into G_lp' W^-2 G_lp, their scaling is diagonal
+    const ConicRows& ineq = prob.ineq_;
+    for (int i=0; i<num_ineq_; ++i) {
+      const double w = 1/(lp_scale_(i)*lp_scale_(i));
+      for (int k1=ineq.row_ptr_[i]; k1<ineq.row_ptr_[i+1]; ++k1) {
+        for (int k2=ineq.row_ptr_[i]; k2<ineq.row_ptr_[i+1]; ++k2) {
+          addEntry(col_pos_[ineq.cols_[k1]], col_pos_[ineq.cols_[k2]], ineq.vals_[k1]*w*ineq.vals_[k2]);
+        }
+      }
+    }
+
+    /// Equalities and second order cones stay in the system next to their rows of A and G, with
+    /// -W^2 on the diagonal of the cones. Eliminating the cones as well would square the
+    /// conditioning of their scaling.
+    const ConicRows& eq = prob.eq_;
+    for (int r=0; r<eq.NumRows(); ++r) {
+      for (int k=eq.row_ptr_[r]; k<eq.row_ptr_[r+1]; ++k) {
+        addEntry(row_pos_[r], col_pos_[eq.cols_[k]], eq.vals_[k]);
+        addEntry(col_pos_[eq.cols_[k]], row_pos_[r], eq.vals_[k]);
+      }
+      addEntry(row_pos_[r], row_pos_[r], -settings_.reg_);
+    }
+    const ConicRows& soc = prob.soc_;
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      for (int i=0; i<q; ++i) {
+        const int row = o-num_ineq_+i;
+        for (int kk=soc.row_ptr_[row]; kk<soc.row_ptr_[row+1]; ++kk) {
+          addEntry(cone_pos_[o+i], col_pos_[soc.cols_[kk]], soc.vals_[kk]);
+          addEntry(col_pos_[soc.cols_[kk]], cone_pos_[o+i], soc.vals_[kk]);
+        }
+        for (int j=0; j<q; ++j) {
+          addEntry(cone_pos_[o+i], cone_pos_[o+j], -soc_w2_[k](i, j));
+        }
+        addEntry(cone_pos_[o+i], cone_pos_[o+i], -settings_.reg_);
+      }
+    }
+    for (int c=0; c<prob.num_vars_; ++c) {
+      addEntry(col_pos_[c], col_pos_[c], settings_.reg_);
+    }
+
+    /// Block LU in place of the diagonal blocks: S_0 = D_0, S_{i+1} = D_{i+1} - B_i S_i^-1 B_i'.
+    /// B_i is only nonzero in the leading rows of block i+1 and the trailing (linking) columns
+    /// of block i, as found by setupStructure.
+    for (int b=0; b<num_blocks_; ++b) {
+      if (b > 0) {
+        const int lb = link_begin_[b-1], lr = link_rows_[b-1];
+        schur_[b].topLeftCorner(lr, lr).noalias() -=
+                sub_[b-1].block(0, lb, lr, block_size_[b-1]-lb)*gain_[b-1].bottomRows(block_size_[b-1]-lb);
+      }
+      lu_[b].compute(schur_[b]);
+      if (!lu_[b].matrixLU().diagonal().allFinite() ||
+          (lu_[b].matrixLU().diagonal().array() == 0).any()) {
+        return false;
+      }
+      if (b+1 < num_blocks_) {
+        const int lb = link_begin_[b], lr = link_rows_[b];
+        auto rhs = gain_rhs_.topLeftCorner(block_size_[b], lr);
+        rhs.topRows(lb).setZero();
+        rhs.bottomRows(block_size_[b]-lb) = sub_[b].block(0, lb, lr, block_size_[b]-lb).transpose();
+        gain_[b] = lu_[b].solve(rhs);
+      }
+    }
+    return true;
+  }
+
+  void ChainSocpSolver::solveBlocks(Eigen::VectorXd& v) {
+    for (int b=0; b+1<num_blocks_; ++b) {
+      v.segment(block_offset_[b+1], link_rows_[b]).noalias() -=
+              gain_[b].transpose()*v.segment(block_offset_[b], block_size_[b]);
+    }
+    for (int b=num_blocks_-1; b>=0; --b) {
+      block_tmp_.head(block_size_[b]) = lu_[b].solve(v.segment(block_offset_[b], block_size_[b]));
+      v.segment(block_offset_[b], block_size_[b]) = block_tmp_.head(block_size_[b]);
+      if (b+1 < num_blocks_) {
+        v.segment(block_offset_[b], block_size_[b]).noalias() -=
+                gain_[b]*v.segment(block_offset_[b+1], link_rows_[b]);
+      }
+    }
+  }
+
+  void ChainSocpSolver::solveKKT(const ConicProblem& prob,
+                                 const Eigen::VectorXd& ex, const Eigen::VectorXd& ey, const Eigen::VectorXd& ez,
+                                 Eigen::VectorXd& dx, Eigen::VectorXd& dy, Eigen::VectorXd& dz) {
+    /// dz_lp = W^-2 (G_lp dx - ez_lp) moves G_lp' W^-2 ez_lp to the right hand side of dx
+    const ConicRows& ineq = prob.ineq_;
+    vx_ = ex;
+    for (int i=0; i<num_ineq_; ++i) {
+      const double w = ez(i)/(lp_scale_(i)*lp_scale_(i));
+      for (int k=ineq.row_ptr_[i]; k<ineq.row_ptr_[i+1]; ++k) {
+        vx_(ineq.cols_[k]) += ineq.vals_[k]*w;
+      }
+    }
+    for (int c=0; c<prob.num_vars_; ++c) {
+      kkt_(col_pos_[c]) = vx_(c);
+    }
+    for (int r=0; r<prob.NumEq(); ++r) {
+      kkt_(row_pos_[r]) = ey(r);
+    }
+    for (int i=num_ineq_; i<num_cone_rows_; ++i) {
+      kkt_(cone_pos_[i]) = ez(i);
+    }
+
+    solveBlocks(kkt_);
+
+    for (int c=0; c<prob.num_vars_; ++c) {
+      dx(c) = kkt_(col_pos_[c]);
+    }
+    for (int r=0; r<prob.NumEq(); ++r) {
+      dy(r) = kkt_(row_pos_[r]);
+    }
+    for (int i=num_ineq_; i<num_cone_rows_; ++i) {
+      dz(i) = kkt_(cone_pos_[i]);
+    }
+    for (int i=0; i<num_ineq_; ++i) {
+      double gx = -ez(i);
+      for (int k=ineq.row_ptr_[i]; k<ineq.row_ptr_[i+1]; ++k) {
+        gx += ineq.vals_[k]*dx(ineq.cols_[k]);
+      }
+      dz(i) = gx/(lp_scale_(i)*lp_scale_(i));
+    }
+  }
+
+  void ChainSocpSolver::solveNewton(const ConicProblem& prob,
+                                    const Eigen::VectorXd& px, const Eigen::VectorXd& py, const Eigen::VectorXd& pz,
+                                    const Eigen::VectorXd& q,
+                                    Eigen::VectorXd& dx, Eigen::VectorXd& dy, Eigen::VectorXd& dz, Eigen::VectorXd& ds) {
+    /// A'dy + G'dz = px, A dx = py, G dx + ds = pz, W dz + W^-1 ds = q. With ds = W (q - W dz)
+    /// the last two become G dx - W^2 dz = pz - W q.
+    applyW(q, tmp_cone_, false);
+    ref_cone_ = pz - tmp_cone_;
+    solveKKT(prob, px, py, ref_cone_, dx, dy, dz);
+
+    /// Iterative refinement against the unregularized system
+    for (int step=0; step<settings_.refine_steps_; ++step) {
+      res_x_ = px;
+      multiplyRowsTransposeAdd(prob.eq_, dy, res_x_, -1);
+      multiplyConesTransposeAdd(prob, dz, res_x_, -1);
+      multiplyRows(prob.eq_, dx, res_y_);
+      res_y_ = py - res_y_;
+      multiplyCones(prob, dx, res_z_);
+      res_z_ = ref_cone_ - res_z_;
+      applyW(dz, tmp_cone_, false);
+      applyW(tmp_cone_, tmp_cone2_, false);
+      res_z_ += tmp_cone2_;
+
+      solveKKT(prob, res_x_, res_y_, res_z_, corr_x_, corr_y_, corr_z_);
+      dx += corr_x_;
+      dy += corr_y_;
+      dz += corr_z_;
+    }
+
+    applyW(dz, tmp_cone_, false);
+    tmp_cone_ = q - tmp_cone_;
+    applyW(tmp_cone_, ds, false);
+  }
+
+  void ChainSocpSolver::applyW(const Eigen::VectorXd& v, Eigen::VectorXd& out, bool inverse) const {
+    for (int i=0; i<num_ineq_; ++i) {
+      out(i) = inverse? v(i)/lp_scale_(i) : v(i)*lp_scale_(i);
+    }
+    /// W = eta [w0 w1'; w1 I + w1 w1'/(1+w0)], W^-1 flips the sign of w1 and divides by eta
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      const auto w = soc_wbar_.segment(o, q);
+      const auto u = v.segment(o, q);
+      const double sign = inverse? -1 : 1;
+      const double scale = inverse? 1/soc_eta_[k] : soc_eta_[k];
+      const double w1u1 = w.tail(q-1).dot(u.tail(q-1));
+      out(o) = scale*(w(0)*u(0) + sign*w1u1);
+      out.segment(o+1, q-1) = scale*(u.tail(q-1) + (sign*u(0) + w1u1/(1 + w(0)))*w.tail(q-1));
+    }
+  }
+
+  void ChainSocpSolver::jordanProduct(const Eigen::VectorXd& u, const Eigen::VectorXd& v, Eigen::VectorXd& out) const {
+    out.head(num_ineq_) = u.head(num_ineq_).cwiseProduct(v.head(num_ineq_));
+    /// u o v = (u'v, u0 v1 + v0 u1)
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      out(o) = u.segment(o, q).dot(v.segment(o, q));
+      out.segment(o+1, q-1) = u(o)*v.segment(o+1, q-1) + v(o)*u.segment(o+1, q-1);
+    }
+  }
+
+  void ChainSocpSolver::jordanDivide(const Eigen::VectorXd& u, const Eigen::VectorXd& v, Eigen::VectorXd& out) const {
+    out.head(num_ineq_) = v.head(num_ineq_).cwiseQuotient(u.head(num_ineq_));
+    /// Solves u o x = v
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      const double u1v1 = u.segment(o+1, q-1).dot(v.segment(o+1, q-1));
+      const double det = u(o)*u(o) - u.segment(o+1, q-1).squaredNorm();
+      out(o) = (u(o)*v(o) - u1v1)/det;
+      out.segment(o+1, q-1) = (v.segment(o+1, q-1) - out(o)*u.segment(o+1, q-1))/u(o);
+    }
+  }
+
+  double ChainSocpSolver::maxStep(const Eigen::VectorXd& u, const Eigen::VectorXd& du) const {
+    double alpha = std::numeric_limits<double>::infinity();
+    for (int i=0; i<num_ineq_; ++i) {
+      if (du(i) < 0) {
+        alpha = std::min(alpha, -u(i)/du(i));
+      }
+    }
+    /// First positive root of (u0 + t du0)^2 - |u1 + t du1|^2 = a t^2 + 2 b t + c
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      const double a = du(o)*du(o) - du.segment(o+1, q-1).squaredNorm();
+      const double b = u(o)*du(o) - u.segment(o+1, q-1).dot(du.segment(o+1, q-1));
+      const double c = u(o)*u(o) - u.segment(o+1, q-1).squaredNorm();
+      if (c <= 0) {
+        return 0;
+      }
+      const double disc = b*b - a*c;
+      if (disc < 0) {
+        continue;
+      }
+      const double root = -(b + std::copysign(std::sqrt(disc), b));
+      for (const double t : {(a != 0)? root/a : -1.0, (root != 0)? c/root : -1.0}) {
+        if (t > 0) {
+          alpha = std::min(alpha, t);
+        }
+      }
+    }
+    return alpha;
+  }
+
+  double ChainSocpSolver::shiftToCone(const Eigen::VectorXd& u) const {
+    double shift = -std::numeric_limits<double>::infinity();
+    for (int i=0; i<num_ineq_; ++i) {
+      shift = std::max(shift, -u(i));
+    }
+    for (size_t k=0; k<soc_offset_.size(); ++k) {
+      const int o = soc_offset_[k], q = soc_w2_[k].rows();
+      shift = std::max(shift, u.segment(o+1, q-1).norm() - u(o));
+    }
+    return shift;
+  }
+
+  void ChainSocpSolver::addIdentity(Eigen::VectorXd& u, double alpha) const {
+    u.head(num_ineq_).array() += alpha;
+    for (const int o : soc_offset_) {
+      u(o) += alpha;
+    }
+  }
+
+}
@@ -0,0 +1,390 @@
+//  * Copyright (c) 2024, Ramkumar Natarajan
+//  * All rights reserved.
+//  *
+//  * Redistribution and use in source and binary forms, with or without
+//  * modification, are permitted provided that the following conditions are met:
+//  *
+//  *     * Redistributions of source code must retain the above copyright
+//  *       notice, this list of conditions and the following disclaimer.
+//  *     * Redistributions in binary form must reproduce the above copyright
+//  *       notice, this list of conditions and the following disclaimer in the
+//  *       documentation and/or other materials provided with the distribution.
+//  *     * Neither the name of the Carnegie Mellon University nor the names of its
+//  *       contributors may be used to endorse or promote products derived from
+//  *       this software without specific prior written permission.
+//  *
+//  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//  * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+//  * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+//  * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+//  * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//  * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+//  * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+//  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  * POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*!
+ * \file GCSConicTemplate.cpp
+ * \author Ram Natarajan (rnataraj@cs.cmu.edu)
+ * \date 3/2/24
+*/
+
+#include <planners/insat/opt/GCSConicTemplate.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace ps {
+
+  Eigen::SparseMatrix<double> ConicRows::ToSparse(int num_cols) const {
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(cols_.size());
+    for (int r=0; r<NumRows(); ++r) {
+      for (int k=row_ptr_[r]; k<row_ptr_[r+1]; ++k) {
+        triplets.emplace_back(r, cols_[k], vals_[k]);
+      }
+    }
+    Eigen::SparseMatrix<double> A(NumRows(), num_cols);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    return A;
+  }
+
+  uint64_t GCSConicTemplate::nextRevision() {
+    static std::atomic<uint64_t> revision(1);
+    return revision++;
+  }
+
+  void GCSConicTemplate::AddVertex(const Vertex* v,
+                                   const std::vector<CostBinding>& costs,
+                                   const std::vector<ConstraintBinding>& constraints) {
+    const int64_t vid = v->id().get_value()-1;
+
+    /// Scratch program only used to number the block columns. x is added first so it owns
+    /// the leading columns of the block.
+    drake::solvers::MathematicalProgram prog;
+    prog.AddDecisionVariables(v->x());
+    for (const auto& cost : costs) {
+      prog.AddDecisionVariables(cost.variables());
+      prog.AddCost(cost);
+    }
+    for (const auto& constraint : constraints) {
+      prog.AddDecisionVariables(constraint.variables());
+      prog.AddConstraint(constraint);
+    }
+    v->set().AddPointInSetConstraints(&prog, v->x());
+
+    VertexTemplate vt;
+    vt.num_x_ = v->x().size();
+    vt.num_cols_ = prog.num_vars();
+    vt.c_ = Eigen::VectorXd::Zero(vt.num_cols_);
+    for (const auto& cost : prog.GetAllCosts()) {
+      const auto* lc = dynamic_cast<const drake::solvers::LinearCost*>(cost.evaluator().get());
+      if (!lc) {
+        throw std::runtime_error("Only linear costs can be compiled. Rewrite the costs for a convex solver first!!");
+      }
+      const auto idx = prog.FindDecisionVariableIndices(cost.variables());
+      for (size_t j=0; j<idx.size(); ++j) {
+        vt.c_(idx[j]) += lc->a()(j);
+      }
+      vt.c0_ += lc->b();
+    }
+    compileConstraints(prog, vt.block_);
+    revision_ = nextRevision();
+
+    if (sealed_) {
+      terminals_.emplace_back(vid, std::move(vt));
+      return;
+    }
+    if (vertices_.empty()) {
+      first_vid_ = vid;
+    }
+    if (vid < first_vid_) {
+      throw std::runtime_error("Region vertices have to be added in increasing id order!!");
+    }
+    if (vid-first_vid_ >= vertices_.size()) {
+      vertices_.resize(vid-first_vid_+1);
+    }
+    vertices_[vid-first_vid_] = std::move(vt);
+  }
+
+  void GCSConicTemplate::AddEdge(const Edge* e,
+                                 const std::vector<ConstraintBinding>& constraints) {
+    const int64_t uid = e->u().id().get_value()-1;
+    const int64_t vid = e->v().id().get_value()-1;
+    if (!HasVertex(uid) || !HasVertex(vid)) {
+      throw std::runtime_error("Edge " + std::to_string(uid) + "->" + std::to_string(vid) +
+                               " added before its vertices were compiled!!");
+    }
+
+    drake::solvers::MathematicalProgram prog;
+    prog.AddDecisionVariables(e->u().x());
+    prog.AddDecisionVariables(e->v().x());
+    for (const auto& constraint : constraints) {
+      prog.AddConstraint(constraint);
+    }
+
+    EdgeTemplate et;
+    et.num_xu_ = e->u().x().size();
+    compileConstraints(prog, et.block_);
+    revision_ = nextRevision();
+
+    if (!isRegion(uid) || !isRegion(vid)) {
+      terminal_edges_.push_back({uid, vid, std::move(et)});
+      return;
+    }
+    if (sealed_) {
+      throw std::runtime_error("Edges between regions have to be added before the template is sealed!!");
+    }
+    edges_.emplace_back(std::move(et));
+    vertices_[uid-first_vid_].out_edges_.emplace_back(vid, edges_.size()-1);
+  }
+
+  void GCSConicTemplate::Seal() {
+    sealed_ = true;
+    num_region_rows_ = rhs_.size();
+    num_region_nnz_ = cols_.size();
+  }
+
+  void GCSConicTemplate::RemoveVertex(int64_t vid) {
+    if (isRegion(vid)) {
+      throw std::runtime_error("Region vertex " + std::to_string(vid) + " can not be removed from the conic template!!");
+    }
+    auto it = std::find_if(terminals_.begin(), terminals_.end(),
+                           [vid](const std::pair<int64_t, VertexTemplate>& t) { return t.first == vid; });
+    if (it == terminals_.end()) {
+      return;
+    }
+    terminals_.erase(it);
+    revision_ = nextRevision();
+    terminal_edges_.erase(std::remove_if(terminal_edges_.begin(), terminal_edges_.end(),
+                                         [vid](const TerminalEdge& te) {
+                                           return te.uid_ == vid || te.vid_ == vid;
+                                         }),
+                          terminal_edges_.end());
+
+    /// Terminal rows are all after the region rows, so they go together with the last terminal
+    if (terminals_.empty()) {
+      row_ptr_.resize(num_region_rows_+1);
+      cols_.resize(num_region_nnz_);
+      vals_.resize(num_region_nnz_);
+      rhs_.resize(num_region_rows_);
+    }
+  }
+
+  void GCSConicTemplate::Assemble(const std::vector<int64_t>& path, ConicProblem& prob) const {
+    size_t num_kept = 0;
+    if (prob.revision_ == revision_) {
+      while (num_kept < path.size() && num_kept < prob.stages_.size() &&
+             prob.stages_[num_kept].vid_ == path[num_kept]) {
+        ++num_kept;
+      }
+    }
+    popStages(num_kept, prob);
+    prob.revision_ = revision_;
+    for (size_t i=num_kept; i<path.size(); ++i) {
+      pushStage(path[i], prob);
+    }
+  }
+
+  void GCSConicTemplate::popStages(int num_stages, ConicProblem& prob) const {
+    if (num_stages >= static_cast<int>(prob.stages_.size())) {
+      return;
+    }
+    /// Sizes before the first dropped vertex
+    const ConicProblem::Stage stage = prob.stages_[num_stages];
+    prob.stages_.resize(num_stages);
+    prob.col_offsets_.resize(num_stages);
+    prob.num_vars_ = stage.num_vars_;
+    prob.c_.resize(stage.num_vars_);
+    prob.c0_ = stage.c0_;
+    prob.eq_.Truncate(stage.num_eq_);
+    prob.ineq_.Truncate(stage.num_ineq_);
+    prob.soc_.Truncate(stage.num_soc_rows_);
+    prob.soc_dims_.resize(stage.num_socs_);
+    prob.soc_A_.resize(stage.num_socs_);
+    prob.soc_col_ptr_.resize(stage.num_socs_+1);
+    prob.soc_cols_.resize(prob.soc_col_ptr_.back());
+  }
+
+  void GCSConicTemplate::pushStage(int64_t vid, ConicProblem& prob) const {
+    /// Looked up before prob is touched, so that a throw leaves it at the last whole vertex
+    const auto* vt = findVertex(vid);
+    if (!vt) {
+      throw std::runtime_error("Vertex ID: " + std::to_string(vid) + " not compiled!!");
+    }
+    const EdgeTemplate* et = prob.stages_.empty() ? nullptr : &findEdge(prob.stages_.back().vid_, vid);
+
+    ConicProblem::Stage stage;
+    stage.vid_ = vid;
+    stage.num_vars_ = prob.num_vars_;
+    stage.c0_ = prob.c0_;
+    stage.num_eq_ = prob.eq_.NumRows();
+    stage.num_ineq_ = prob.ineq_.NumRows();
+    stage.num_soc_rows_ = prob.soc_.NumRows();
+    stage.num_socs_ = prob.soc_dims_.size();
+
+    const int offset = prob.num_vars_;
+    prob.num_vars_ += vt->num_cols_;
+    prob.c_.insert(prob.c_.end(), vt->c_.data(), vt->c_.data()+vt->num_cols_);
+    prob.c0_ += vt->c0_;
+    if (et) {
+      copyBlock(et->block_, prob.col_offsets_.back(), et->num_xu_, offset, prob);
+    }
+    copyBlock(vt->block_, offset, vt->num_cols_, 0, prob);
+
+    prob.stages_.push_back(stage);
+    prob.col_offsets_.push_back(offset);
+  }
+
+  void GCSConicTemplate::compileConstraints(const drake::solvers::MathematicalProgram& prog, Block& block) {
+    std::vector<Row> eq_rows, ineq_rows, soc_rows;
+
+    /// lb <= A x <= ub split into equalities and one-sided inequalities
+    auto add_linear = [&](const Eigen::MatrixXd& A, const Eigen::VectorXd& lb, const Eigen::VectorXd& ub,
+                          const std::vector<int>& idx) {
+      for (int r=0; r<A.rows(); ++r) {
+        if (lb(r) == ub(r)) {
+          appendRow(A.row(r), idx, ub(r), eq_rows);
+          continue;
+        }
+        if (std::isfinite(ub(r))) {
+          appendRow(A.row(r), idx, ub(r), ineq_rows);
+        }
+        if (std::isfinite(lb(r))) {
+          appendRow(-A.row(r), idx, -lb(r), ineq_rows);
+        }
+      }
+    };
+
+    for (const auto& binding : prog.GetAllConstraints()) {
+      const auto* c = binding.evaluator().get();
+      const auto idx = prog.FindDecisionVariableIndices(binding.variables());
+
+      if (const auto* bb = dynamic_cast<const drake::solvers::BoundingBoxConstraint*>(c)) {
+        add_linear(Eigen::MatrixXd::Identity(idx.size(), idx.size()), bb->lower_bound(), bb->upper_bound(), idx);
+      } else if (const auto* lc = dynamic_cast<const drake::solvers::LinearConstraint*>(c)) {
+        /// Also covers LinearEqualityConstraint (lb == ub)
+        add_linear(lc->GetDenseA(), lc->lower_bound(), lc->upper_bound(), idx);
+      } else if (const auto* lorentz = dynamic_cast<const drake::solvers::LorentzConeConstraint*>(c)) {
+        /// z = A x + b in SOC  <=>  s = b - (-A) x in SOC
+        const Eigen::MatrixXd A = lorentz->A_dense();
+        for (int r=0; r<A.rows(); ++r) {
+          appendRow(-A.row(r), idx, lorentz->b()(r), soc_rows);
+        }
+        block.soc_dims_.push_back(A.rows());
+
+        Cone cone;
+        cone.cols_.assign(idx.begin(), idx.end());
+        std::sort(cone.cols_.begin(), cone.cols_.end());
+        cone.cols_.erase(std::unique(cone.cols_.begin(), cone.cols_.end()), cone.cols_.end());
+        cone.A_ = Eigen::MatrixXd::Zero(A.rows(), cone.cols_.size());
+        for (size_t j=0; j<idx.size(); ++j) {
+          const int k = std::lower_bound(cone.cols_.begin(), cone.cols_.end(), idx[j]) - cone.cols_.begin();
+          cone.A_.col(k) += A.col(j);
+        }
+        block.cones_.emplace_back(std::move(cone));
+      } else {
+        throw std::runtime_error("Constraint " + c->get_description() + " can not be compiled into a conic block!!");
+      }
+    }
+
+    block.eq_ = commitRows(eq_rows);
+    block.ineq_ = commitRows(ineq_rows);
+    block.soc_ = commitRows(soc_rows);
+  }
+
+  void GCSConicTemplate::appendRow(const Eigen::Ref<const Eigen::RowVectorXd>& a, const std::vector<int>& col_map,
+                                   double rhs, std::vector<Row>& rows) const {
+    Row row;
+    for (int j=0; j<a.size(); ++j) {
+      if (a(j) != 0) {
+        row.cols_.push_back(col_map[j]);
+        row.vals_.push_back(a(j));
+      }
+    }
+    row.rhs_ = rhs;
+    rows.emplace_back(std::move(row));
+  }
+
+  GCSConicTemplate::RowRange GCSConicTemplate::commitRows(const std::vector<Row>& rows) {
+    RowRange range;
+    range.begin_ = rhs_.size();
+    range.size_ = rows.size();
+    for (const auto& row : rows) {
+      cols_.insert(cols_.end(), row.cols_.begin(), row.cols_.end());
+      vals_.insert(vals_.end(), row.vals_.begin(), row.vals_.end());
+      rhs_.push_back(row.rhs_);
+      row_ptr_.push_back(cols_.size());
+    }
+    return range;
+  }
+
+  const GCSConicTemplate::VertexTemplate* GCSConicTemplate::findVertex(int64_t vid) const {
+    if (isRegion(vid)) {
+      return &vertices_[vid-first_vid_];
+    }
+    for (const auto& [tid, vt] : terminals_) {
+      if (tid == vid) {
+        return &vt;
+      }
+    }
+    return nullptr;
+  }
+
+  const GCSConicTemplate::EdgeTemplate& GCSConicTemplate::findEdge(int64_t uid, int64_t vid) const {
+    if (isRegion(uid) && isRegion(vid)) {
+      for (const auto& [succ, eidx] : vertices_[uid-first_vid_].out_edges_) {
+        if (succ == vid) {
+          return edges_[eidx];
+        }
+      }
+    } else {
+      for (const auto& te : terminal_edges_) {
+        if (te.uid_ == uid && te.vid_ == vid) {
+          return te.edge_;
+        }
+      }
+    }
+    throw std::runtime_error("No compiled edge from vertex " + std::to_string(uid) + " to vertex " + std::to_string(vid) + "!!");
+  }
+
+  void GCSConicTemplate::copyRows(const RowRange& range, int u_offset, int num_xu, int v_offset,
+                                  ConicRows& rows) const {
+    for (int r=range.begin_; r<range.begin_+range.size_; ++r) {
+      for (int k=row_ptr_[r]; k<row_ptr_[r+1]; ++k) {
+        const int col = cols_[k];
+        rows.cols_.push_back(col < num_xu ? u_offset + col : v_offset + col - num_xu);
+        rows.vals_.push_back(vals_[k]);
+      }
+      rows.b_.push_back(rhs_[r]);
+      rows.row_ptr_.push_back(rows.cols_.size());
+    }
+  }
+
+  void GCSConicTemplate::copyCones(const Block& block, int u_offset, int num_xu, int v_offset,
+                                   ConicProblem& prob) const {
+    for (const auto& cone : block.cones_) {
+      for (const int col : cone.cols_) {
+        prob.soc_cols_.push_back(col < num_xu ? u_offset + col : v_offset + col - num_xu);
+      }
+      prob.soc_col_ptr_.push_back(prob.soc_cols_.size());
+      prob.soc_A_.push_back(&cone.A_);
+    }
+  }
+
+  void GCSConicTemplate::copyBlock(const Block& block, int u_offset, int num_xu, int v_offset,
+                                   ConicProblem& prob) const {
+    copyRows(block.eq_, u_offset, num_xu, v_offset, prob.eq_);
+    copyRows(block.ineq_, u_offset, num_xu, v_offset, prob.ineq_);
+    copyRows(block.soc_, u_offset, num_xu, v_offset, prob.soc_);
+    prob.soc_dims_.insert(prob.soc_dims_.end(), block.soc_dims_.begin(), block.soc_dims_.end());
+    copyCones(block, u_offset, num_xu, v_offset, prob);
+  }
+
+}
@@ -34,6 +34,8 @@
 
 #include <planners/insat/opt/GCSOpt.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace ps {
@@ -87,6 +89,15 @@ namespace ps {
     }
     return vars_dense;
   }
+
+  /// 8 point Gauss-Legendre rule on [0, 1]
+  const int kNumQuadPoints = 8;
+  const double kQuadNodes[kNumQuadPoints] = {
+          0.0198550717512319, 0.1016667612931866, 0.2372337950418355, 0.4082826787521751,
+          0.5917173212478249, 0.7627662049581645, 0.8983332387068134, 0.9801449282487681};
+  const double kQuadWeights[kNumQuadPoints] = {
+          0.0506142681451881, 0.1111905172266872, 0.1568533229389436, 0.1813418916891810,
+          0.1813418916891810, 0.1568533229389436, 0.1111905172266872, 0.0506142681451881};
 }
 
 ps::GCSOpt::GCSOpt(const std::vector<HPolyhedron> &regions,
@@ -94,7 +105,8 @@ ps::GCSOpt::GCSOpt(const std::vector<HPolyhedron> &regions,
                    int order, double h_min, double h_max,
                    double path_length_weight, double time_weight,
                    Eigen::VectorXd& vel_lb, Eigen::VectorXd& vel_ub,
-                   bool verbose)
+                   bool verbose,
+                   std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry)
         : verbose_(verbose),
           hpoly_regions_(regions),
           edges_bw_regions_(edges_between_regions),
@@ -106,6 +118,9 @@ ps::GCSOpt::GCSOpt(const std::vector<HPolyhedron> &regions,
           enable_time_cost_(false),
           enable_path_length_cost_(false),
           enable_path_velocity_constraint_(false),
+          compiled_solve_(true),
+          polyline_solve_(true),
+          solver_type_(GCSSolverType::kMosek),
           gcs_(std::make_shared<drake::geometry::optimization::GraphOfConvexSets>()) {
 
   drake::geometry::optimization::ConvexSets regions_cs;
@@ -141,6 +156,12 @@ ps::GCSOpt::GCSOpt(const std::vector<HPolyhedron> &regions,
   preprocess(regions_cs, edges_between_regions);
   end_time = std::chrono::high_resolution_clock::now();
   if (verbose_) std::cout << "Done setting up vars and preprocessing!!!" << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
+
+  if (verbose_) std::cout << "Computing region geometry" << std::endl;
+  start_time = std::chrono::high_resolution_clock::now();
+  computeRegionGeometry(std::move(region_geometry));
+  end_time = std::chrono::high_resolution_clock::now();
+  if (verbose_) std::cout << "Done computing region geometry!!!" << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
 }
 
 void ps::GCSOpt::FormulateAndSetCostsAndConstraints() {
@@ -152,6 +173,9 @@ void ps::GCSOpt::FormulateAndSetCostsAndConstraints() {
   if (verbose_) std::cout << "Formulating costs and constraints" << std::endl;
   auto start_time = std::chrono::high_resolution_clock::now();
   formulateCostsAndConstraints();
+  polyline_chain_ = order_ == 1 && !enable_time_cost_ && enable_path_length_cost_ &&
+                    path_length_cost_.size() == 1 && velocity_constraint_.empty() &&
+                    vertices_.front()->ambient_dimension() == 2*num_positions_;
   auto end_time = std::chrono::high_resolution_clock::now();
   if (verbose_) std::cout << "Done formulating costs and constraints!!!" << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
 
@@ -162,6 +186,11 @@ void ps::GCSOpt::FormulateAndSetCostsAndConstraints() {
   end_time = std::chrono::high_resolution_clock::now();
   if (verbose_) std::cout << "Done setting up  costs and constraints!!!" << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
 
+  if (compiled_solve_) {
+    CompileConicTemplate();
+  }
+
+  formulated_ = true;
 }
 
 ps::VertexId ps::GCSOpt::AddStart(Eigen::VectorXd &start) {
@@ -191,26 +220,17 @@ ps::VertexId ps::GCSOpt::AddStart(Eigen::VectorXd &start) {
           fmt::format("{}", "start")));
   vertex_id_to_vertex_[vertices_.back()->id().get_value()-1] = vertices_.back();
   start_vtx_ = vertices_.back();
-  start_vit_ = vertices_.end()-1;
 
   auto start_vertex = vertices_.back();
-  auto upstart = start_vertex->set().MaybeGetFeasiblePoint();
-  GCSVertex* start_region_vertex;
-  for (auto& v : vertices_) {
-    if (v->set().PointInSet(upstart.value())) {
-      start_region_vertex = v;
-      break;
-    }
-  }
+  addTerminalGeometry(start_vertex, start);
+  GCSVertex* start_region_vertex = findRegionVertex(start);
   // Connect start to start region
-  GCSEdge* uv_edge = gcs_->AddEdge(start_vertex, start_region_vertex);
-  edges_.emplace_back(uv_edge);
-  edge_id_to_edge_[edges_.back()->id().get_value()-1] = edges_.back();
-  start_eit_ = edges_.end()-1;
+  addEdge(gcs_->AddEdge(start_vertex, start_region_vertex));
+  addEdge(gcs_->AddEdge(start_region_vertex, start_vertex));
 
-  GCSEdge* vu_edge = gcs_->AddEdge(start_region_vertex, start_vertex);
-  edges_.emplace_back(vu_edge);
-  edge_id_to_edge_[edges_.back()->id().get_value()-1] = edges_.back();
+  if (formulated_) {
+    setupTerminalCostsAndConstraints(start_vertex);
+  }
 
   return start_vertex->id();
 }
@@ -242,26 +262,17 @@ ps::VertexId ps::GCSOpt::AddGoal(Eigen::VectorXd &goal) {
           fmt::format("{}", "goal")));
   vertex_id_to_vertex_[vertices_.back()->id().get_value()-1] = vertices_.back();
   goal_vtx_ = vertices_.back();
-  goal_vit_ = vertices_.end()-1;
 
   auto goal_vertex = vertices_.back();
-  auto upgoal = goal_vertex->set().MaybeGetFeasiblePoint();
-  GCSVertex* goal_region_vertex;
-  for (auto& v : vertices_) {
-    if (v->set().PointInSet(upgoal.value())) {
-      goal_region_vertex = v;
-      break;
-    }
-  }
+  addTerminalGeometry(goal_vertex, goal);
+  GCSVertex* goal_region_vertex = findRegionVertex(goal);
   // Connect goal region to goal
-  GCSEdge* uv_edge = gcs_->AddEdge(goal_region_vertex, goal_vertex);
-  edges_.emplace_back(uv_edge);
-  edge_id_to_edge_[edges_.back()->id().get_value()-1] = edges_.back();
-  goal_eit_ = edges_.end()-1;
+  addEdge(gcs_->AddEdge(goal_region_vertex, goal_vertex));
+  addEdge(gcs_->AddEdge(goal_vertex, goal_region_vertex));
 
-  GCSEdge* vu_edge = gcs_->AddEdge(goal_vertex, goal_region_vertex);
-  edges_.emplace_back(vu_edge);
-  edge_id_to_edge_[edges_.back()->id().get_value()-1] = edges_.back();
+  if (formulated_) {
+    setupTerminalCostsAndConstraints(goal_vertex);
+  }
 
   return goal_vertex->id();
 }
@@ -305,14 +316,7 @@ std::pair<drake::trajectories::CompositeTrajectory<double>,
                                                                      Eigen::VectorXd& initial_guess) {
   std::vector<EdgeId> path_eids;
   for (int i=0; i<path_vids.size()-1; ++i) {
-    int64_t uid = path_vids[i].get_value()-1;
-    int64_t vid = path_vids[i+1].get_value()-1;
-    for (auto& e : edges_) {
-      if (e->u().id().get_value()-1 == uid && e->v().id().get_value()-1 == vid) {
-        path_eids.push_back(e->id());
-        break;
-      }
-    }
+    path_eids.push_back(findEdge(path_vids[i].get_value()-1, path_vids[i+1].get_value()-1));
   }
   return Solve(path_vids, path_eids, initial_guess);
 }
@@ -336,7 +340,29 @@ ps::GCSOpt::Solve(std::vector<VertexId>& path_vids,
     std::runtime_error("Size of Path IDs has to be positive!!");
   }
 
+  if (isCancelled()) {
+    return {drake::trajectories::CompositeTrajectory<double>({}), drake::solvers::MathematicalProgramResult()};
+  }
+
+  if (polyline_solve_ && polyline_chain_ && initial_guess.size() == 0) {
+    auto soln = solvePolyline(path_vids);
+    if (soln) {
+      return *soln;
+    }
+  }
+
+  if (compiled_solve_ && conic_template_ && initial_guess.size() == 0) {
+    return solveCompiled(path_vids);
+  }
+
   drake::solvers::MathematicalProgram prog;
+  buildPathProgram(prog, path_vids, path_eids);
+  return solveProgram(prog, path_vids, initial_guess);
+}
+
+void ps::GCSOpt::buildPathProgram(drake::solvers::MathematicalProgram& prog,
+                                  std::vector<VertexId>& path_vids,
+                                  std::vector<EdgeId>& path_eids) {
 
   for (const auto& vid : path_vids) {
     if (vertex_id_to_vertex_.find(vid.get_value()-1) == vertex_id_to_vertex_.end()) {
@@ -344,7 +370,7 @@ ps::GCSOpt::Solve(std::vector<VertexId>& path_vids,
     }
     auto& dec_vars = vertex_id_to_vertex_[vid.get_value()-1]->x();
     prog.AddDecisionVariables(dec_vars);
-    for (auto& slack : slack_vars_) {
+    for (const auto& slack : vertex_id_to_slack_vars_[vid.get_value()-1]) {
       prog.AddDecisionVariables(slack);
     }
     for (const auto& cost : vertex_id_to_cost_binding_[vid.get_value()-1]) {
@@ -371,6 +397,13 @@ ps::GCSOpt::Solve(std::vector<VertexId>& path_vids,
     std::cout << "math program " << std::endl;
     std::cout << prog.to_string() << std::endl;
   }
+}
+
+std::pair<drake::trajectories::CompositeTrajectory<double>,
+        drake::solvers::MathematicalProgramResult>
+ps::GCSOpt::solveProgram(drake::solvers::MathematicalProgram& prog,
+                         std::vector<VertexId>& path_vids,
+                         Eigen::VectorXd& initial_guess) {
 
 /// Default is using SNOPT
 ////  drake::solvers::MathematicalProgramResult result = drake::solvers::Solve(prog);
@@ -388,42 +421,128 @@ ps::GCSOpt::Solve(std::vector<VertexId>& path_vids,
 //  }
 //  auto end_time = std::chrono::high_resolution_clock::now();
 
-/// Use MOSEK
+/// Use the selected conic solver
 //  RewriteForConvexSolver(&prog);
   auto start_time = std::chrono::high_resolution_clock::now();
-  auto mosek_solver = drake::solvers::MosekSolver();
   drake::solvers::MathematicalProgramResult result;
   if (initial_guess.size() == 0) {
-    result = mosek_solver.Solve(prog);
+    result = solveConic(prog, std::nullopt);
   } else if (initial_guess.size() < prog.num_vars()) {
     Eigen::VectorXd full_init_guess(prog.num_vars());
     full_init_guess.setZero();
     full_init_guess.head(initial_guess.size()) = initial_guess;
-    result = mosek_solver.Solve(prog, full_init_guess);
+    result = solveConic(prog, full_init_guess);
   } else {
-    result = mosek_solver.Solve(prog, initial_guess);
+    result = solveConic(prog, initial_guess);
   }
   auto end_time = std::chrono::high_resolution_clock::now();
 
   if (verbose_)  std::cout << "Solving alone took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
 
+  return extractTrajectory(result, path_vids);
+}
+
+bool ps::GCSOpt::isCancelled() const {
+  return cancel_token_ && cancel_token_->IsCancelled();
+}
+
+drake::solvers::SolverOptions ps::GCSOpt::solverOptions() const {
+  drake::solvers::SolverOptions options;
+  if (cancel_token_) {
+    /// No solver interface can interrupt a running solve, so the deadline becomes a time limit
+    const double remaining_time = cancel_token_->RemainingTime();
+    if (remaining_time < std::numeric_limits<double>::infinity()) {
+      /// The solvers want a positive limit
+      const double time_limit = std::max(remaining_time, 1e-3);
+      options.SetOption(drake::solvers::MosekSolver::id(), "MSK_DPAR_OPTIMIZER_MAX_TIME", time_limit);
+      options.SetOption(drake::solvers::IpoptSolver::id(), "max_wall_time", time_limit);
+      options.SetOption(drake::solvers::ClarabelSolver::id(), "time_limit", time_limit);
+      options.SetOption(drake::solvers::ScsSolver::id(), "time_limit_secs", time_limit);
+    }
+  }
+  return options;
+}
+
+drake::solvers::MathematicalProgramResult
+ps::GCSOpt::solveConic(const drake::solvers::MathematicalProgram& prog,
+                       const std::optional<Eigen::VectorXd>& initial_guess) const {
+  /// All of them report through MathematicalProgramResult, so extraction does not depend on the solver
+  drake::solvers::MathematicalProgramResult result;
+  switch (solver_type_) {
+    case GCSSolverType::kClarabel:
+      drake::solvers::ClarabelSolver().Solve(prog, initial_guess, solverOptions(), &result);
+      break;
+    case GCSSolverType::kScs:
+      drake::solvers::ScsSolver().Solve(prog, initial_guess, solverOptions(), &result);
+      break;
+    case GCSSolverType::kChainSocp:
+      /// Programs that were not compiled or that the chain solver gave up on
+      drake::solvers::ClarabelSolver().Solve(prog, initial_guess, solverOptions(), &result);
+      break;
+    default:
+      drake::solvers::MosekSolver().Solve(prog, initial_guess, solverOptions(), &result);
+  }
+  return result;
+}
+
+void ps::GCSOpt::SetSolverType(GCSSolverType solver_type) {
+  bool available = false;
+  switch (solver_type) {
+    case GCSSolverType::kMosek:
+      available = drake::solvers::MosekSolver::is_available();
+      break;
+    case GCSSolverType::kClarabel:
+      available = drake::solvers::ClarabelSolver::is_available();
+      break;
+    case GCSSolverType::kScs:
+      available = drake::solvers::ScsSolver::is_available();
+      break;
+    case GCSSolverType::kChainSocp:
+      available = drake::solvers::ClarabelSolver::is_available();
+      break;
+  }
+  if (!available) {
+    throw std::runtime_error("Solver " + std::to_string(static_cast<int>(solver_type)) + " is not available in this drake build!!");
+  }
+
+  solver_type_ = solver_type;
+  if (solver_type_ == GCSSolverType::kMosek) {
+    if (!mosek_license_) {
+      mosek_license_ = drake::solvers::MosekSolver::AcquireLicense();
+    }
+  } else {
+    mosek_license_.reset();
+  }
+}
+
+std::pair<drake::trajectories::CompositeTrajectory<double>,
+        drake::solvers::MathematicalProgramResult>
+ps::GCSOpt::extractTrajectory(const drake::solvers::MathematicalProgramResult& result,
+                              std::vector<VertexId>& path_vids) {
   if (!result.is_success()) {
     return {drake::trajectories::CompositeTrajectory<double>({}), result};
   }
 
+  std::vector<Eigen::VectorXd> path_x;
+  for (const auto& id : path_vids) {
+    path_x.emplace_back(result.GetSolution(vertex_id_to_vertex_[id.get_value()-1]->x()));
+  }
+  return {buildTrajectory(path_x), result};
+}
+
+drake::trajectories::CompositeTrajectory<double>
+ps::GCSOpt::buildTrajectory(const std::vector<Eigen::VectorXd>& path_x) const {
 // Extract the path from the edges.
   std::vector<drake::copyable_unique_ptr<drake::trajectories::Trajectory<double>>> bezier_curves;
-  for (const auto& id : path_vids) {
-    auto& vertex = vertex_id_to_vertex_[id.get_value()-1];
+  for (const auto& x : path_x) {
     const int num_control_points = order_ + 1;
     const drake::MatrixX<double> path_points =
-            Eigen::Map<drake::MatrixX<double>>(result.GetSolution(vertex->x()).data(),
-                                               num_positions_, num_control_points);
+            Eigen::Map<const drake::MatrixX<double>>(x.data(), num_positions_, num_control_points);
 
     double h;
     if (enable_time_cost_) {
 // Extract the duration from the solution.
-      h = result.GetSolution(vertex->x()).tail<1>().value();
+      h = x.tail<1>().value();
     } else {
       h = 1;
     }
@@ -439,9 +558,281 @@ ps::GCSOpt::Solve(std::vector<VertexId>& path_vids,
     }
   }
 
-  auto final_trajectory = drake::trajectories::CompositeTrajectory<double>(bezier_curves);
+  return drake::trajectories::CompositeTrajectory<double>(bezier_curves);
+}
+
+std::pair<drake::trajectories::CompositeTrajectory<double>,
+        drake::solvers::MathematicalProgramResult>
+ps::GCSOpt::solveCompiled(std::vector<VertexId>& path_vids) {
+  std::vector<int64_t> path;
+  path.reserve(path_vids.size());
+  for (const auto& vid : path_vids) {
+    path.push_back(vid.get_value()-1);
+  }
+  conic_template_->Assemble(path, conic_prob_);
+
+  if (solver_type_ == GCSSolverType::kChainSocp) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    const auto status = chain_solver_.Solve(conic_prob_, cancel_token_? cancel_token_->RemainingTime() : kInf);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    if (verbose_)  std::cout << "Chain SOCP solve took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9
+                             << "s in " << chain_solver_.GetIterations() << " iterations" << std::endl;
+
+    if (status == ChainSocpSolver::Status::kSolved) {
+      drake::solvers::MathematicalProgramResult result;
+      result.set_solver_id(drake::solvers::SolverId("ChainSocp"));
+      result.set_solution_result(drake::solvers::SolutionResult::kSolutionFound);
+      result.set_optimal_cost(chain_solver_.GetCost());
+
+      const Eigen::VectorXd& soln = chain_solver_.GetX();
+      std::vector<Eigen::VectorXd> path_x;
+      for (int i=0; i<path.size(); ++i) {
+        path_x.emplace_back(soln.segment(conic_prob_.col_offsets_[i], conic_template_->NumX(path[i])));
+      }
+      return {buildTrajectory(path_x), result};
+    }
+    if (status == ChainSocpSolver::Status::kTimeLimit) {
+      return {drake::trajectories::CompositeTrajectory<double>({}), drake::solvers::MathematicalProgramResult()};
+    }
+    /// Anything else goes to the general solver below
+  }
+
+  /// The solver interfaces only take a MathematicalProgram, so the assembled problem is handed
+  /// over as one flat set of variables and sparse constraints.
+  drake::solvers::MathematicalProgram prog;
+  auto x = prog.NewContinuousVariables(conic_prob_.num_vars_, "x");
+  prog.AddLinearCost(conic_prob_.C(), conic_prob_.c0_, x);
+
+  if (conic_prob_.NumEq() > 0) {
+    prog.AddLinearEqualityConstraint(conic_prob_.eq_.ToSparse(conic_prob_.num_vars_),
+                                     Eigen::Map<const Eigen::VectorXd>(conic_prob_.eq_.b_.data(), conic_prob_.NumEq()), x);
+  }
+  if (conic_prob_.NumIneq() > 0) {
+    prog.AddLinearConstraint(conic_prob_.ineq_.ToSparse(conic_prob_.num_vars_),
+                             Eigen::VectorXd::Constant(conic_prob_.NumIneq(), -kInf),
+                             Eigen::Map<const Eigen::VectorXd>(conic_prob_.ineq_.b_.data(), conic_prob_.NumIneq()), x);
+  }
+  const Eigen::Map<const Eigen::VectorXd> h(conic_prob_.soc_.b_.data(), conic_prob_.soc_.NumRows());
+  int row = 0;
+  for (size_t k=0; k<conic_prob_.soc_dims_.size(); ++k) {
+    /// The template keeps each cone restricted to the columns it touches
+    const int dim = conic_prob_.soc_dims_[k];
+    const int cols_begin = conic_prob_.soc_col_ptr_[k];
+    drake::VectorX<drake::symbolic::Variable> cone_vars(conic_prob_.soc_col_ptr_[k+1] - cols_begin);
+    for (int j=0; j<cone_vars.size(); ++j) {
+      cone_vars(j) = x(conic_prob_.soc_cols_[cols_begin+j]);
+    }
+    prog.AddLorentzConeConstraint(*conic_prob_.soc_A_[k], h.segment(row, dim), cone_vars);
+    row += dim;
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  drake::solvers::MathematicalProgramResult result = solveConic(prog, std::nullopt);
+  auto end_time = std::chrono::high_resolution_clock::now();
+
+  if (verbose_)  std::cout << "Solving compiled program took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
+
+  if (!result.is_success()) {
+    return {drake::trajectories::CompositeTrajectory<double>({}), result};
+  }
+
+  const Eigen::VectorXd soln = result.GetSolution(x);
+  std::vector<Eigen::VectorXd> path_x;
+  for (int i=0; i<path.size(); ++i) {
+    path_x.emplace_back(soln.segment(conic_prob_.col_offsets_[i], conic_template_->NumX(path[i])));
+  }
+  return {buildTrajectory(path_x), result};
+}
+
+std::optional<std::pair<drake::trajectories::CompositeTrajectory<double>,
+        drake::solvers::MathematicalProgramResult>>
+ps::GCSOpt::solvePolyline(std::vector<VertexId>& path_vids) {
+  polyline_solver_.Reset(num_positions_);
+  for (const auto& id : path_vids) {
+    const int64_t vid = id.get_value()-1;
+    const auto region = vertex_id_to_regions_.find(vid);
+    if (region != vertex_id_to_regions_.end()) {
+      polyline_solver_.AddPolytope(region->second.A(), region->second.b());
+      continue;
+    }
+    const auto terminal = terminal_geometry_.find(vid);
+    if (terminal == terminal_geometry_.end()) {
+      return std::nullopt;
+    }
+    polyline_solver_.AddPoint(terminal->second.center_);
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  const auto status = polyline_solver_.Solve(path_length_weight_(0, 0),
+                                             cancel_token_? cancel_token_->RemainingTime() : kInf);
+  auto end_time = std::chrono::high_resolution_clock::now();
+
+  if (verbose_)  std::cout << "Polyline solve took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9
+                           << "s" << (polyline_solver_.SolvedInClosedForm()? " in closed form" : "") << std::endl;
+
+  if (status == ShortestPolylineSolver::Status::kTimeLimit) {
+    return std::make_pair(drake::trajectories::CompositeTrajectory<double>({}), drake::solvers::MathematicalProgramResult());
+  }
+  /// Its set membership tolerance is tighter than the conic solvers', so infeasible chains
+  /// are left to them as well
+  if (status != ShortestPolylineSolver::Status::kSolved) {
+    return std::nullopt;
+  }
+
+  drake::solvers::MathematicalProgramResult result;
+  result.set_solver_id(drake::solvers::SolverId("ShortestPolyline"));
+  result.set_solution_result(drake::solvers::SolutionResult::kSolutionFound);
+  result.set_optimal_cost(polyline_solver_.GetCost());
+
+  /// The control points of vertex i are waypoints i and i+1
+  const Eigen::MatrixXd& waypoints = polyline_solver_.GetWaypoints();
+  std::vector<Eigen::VectorXd> path_x;
+  for (int i=0; i<path_vids.size(); ++i) {
+    path_x.emplace_back(2*num_positions_);
+    path_x.back() << waypoints.col(i), waypoints.col(i+1);
+  }
+  return std::make_pair(buildTrajectory(path_x), result);
+}
+
+void ps::GCSOpt::CompileConicTemplate() {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  auto conic_template = std::make_shared<GCSConicTemplate>();
+  auto is_terminal = [this](const GCSVertex& v) {
+    return &v == start_vtx_ || &v == goal_vtx_;
+  };
+  try {
+    /// Regions first, so that terminals added later are kept apart and reclaimed on CleanUp
+    for (int pass=0; pass<2; ++pass) {
+      const bool terminals = pass == 1;
+      for (const auto* v : vertices_) {
+        if (is_terminal(*v) != terminals) {
+          continue;
+        }
+        const int64_t vid = v->id().get_value()-1;
+        conic_template->AddVertex(v, vertex_id_to_cost_binding_[vid], vertex_id_to_constraint_binding_[vid]);
+      }
+      for (const auto* e : edges_) {
+        if ((is_terminal(e->u()) || is_terminal(e->v())) != terminals) {
+          continue;
+        }
+        conic_template->AddEdge(e, edge_id_to_constraint_binding_[e->id().get_value()-1]);
+      }
+      if (!terminals) {
+        conic_template->Seal();
+      }
+    }
+  } catch (const std::runtime_error& ex) {
+    if (verbose_) std::cout << "Could not compile conic template: " << ex.what() << std::endl;
+    conic_template_.reset();
+    return;
+  }
+  conic_template_ = conic_template;
+  auto end_time = std::chrono::high_resolution_clock::now();
+  if (verbose_) std::cout << "Compiled conic template in " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
+}
+
+std::pair<drake::trajectories::CompositeTrajectory<double>,
+        drake::solvers::MathematicalProgramResult>
+ps::GCSOpt::WarmSolve(std::vector<VertexId>& path_vids,
+                      const drake::trajectories::CompositeTrajectory<double>& parent_traj) {
+  if (path_vids.size() <= 0) {
+    throw std::runtime_error("Size of Path IDs has to be positive!!");
+  }
+
+  if (isCancelled()) {
+    return {drake::trajectories::CompositeTrajectory<double>({}), drake::solvers::MathematicalProgramResult()};
+  }
+
+  std::vector<EdgeId> path_eids;
+  for (int i=0; i<path_vids.size()-1; ++i) {
+    path_eids.push_back(findEdge(path_vids[i].get_value()-1, path_vids[i+1].get_value()-1));
+  }
+
+  drake::solvers::MathematicalProgram prog;
+  buildPathProgram(prog, path_vids, path_eids);
+
+  setWarmStart(prog, path_vids, parent_traj);
+
+  /// The conic interior point solvers (MOSEK, Clarabel, SCS) start from their own central point
+  /// and ignore primal guesses, so the warm solve goes through IPOPT. Drake hands it the Lorentz
+  /// cone costs in their smooth form (z0 >= 0, z0^2 - |z|^2 >= 0), which is fine away from the
+  /// cone apex; zero length segments sit on the apex and end up in the conic fallback below.
+  /// Primal warm starts only pay off with a small initial barrier parameter
+  drake::solvers::SolverOptions options = solverOptions();
+  options.SetOption(drake::solvers::IpoptSolver::id(), "mu_init", 1e-4);
+  options.SetOption(drake::solvers::IpoptSolver::id(), "bound_push", 1e-6);
+  options.SetOption(drake::solvers::IpoptSolver::id(), "bound_frac", 1e-6);
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  drake::solvers::MathematicalProgramResult result;
+  auto ipopt_solver = drake::solvers::IpoptSolver();
+  ipopt_solver.Solve(prog, prog.initial_guess(), options, &result);
+  auto end_time = std::chrono::high_resolution_clock::now();
+
+  if (verbose_)  std::cout << "Warm solve took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count()/1e9 << "s" << std::endl;
+
+  if (!result.is_success() && !isCancelled()) {
+    if (verbose_) std::cout << "Warm solve failed with " << result.get_solution_result() << ". Falling back to the conic solver" << std::endl;
+    Eigen::VectorXd no_guess;
+    return solveProgram(prog, path_vids, no_guess);
+  }
+  return extractTrajectory(result, path_vids);
+}
+
+void ps::GCSOpt::setWarmStart(drake::solvers::MathematicalProgram& prog,
+                              std::vector<VertexId>& path_vids,
+                              const drake::trajectories::CompositeTrajectory<double>& parent_traj) {
+  const int num_control_points = order_ + 1;
+  const int num_shared = std::min(static_cast<int>(path_vids.size())-1,
+                                  parent_traj.get_number_of_segments());
+
+  Eigen::VectorXd x_guess;
+  Eigen::VectorXd last_point;
+  double last_h = h_min_ > 0? h_min_ : 1.0;
+  for (int i=0; i<path_vids.size(); ++i) {
+    auto& vertex = vertex_id_to_vertex_[path_vids[i].get_value()-1];
+    x_guess.resize(vertex->x().size());
+    Eigen::Map<Eigen::MatrixXd> control_points(x_guess.data(), num_positions_, num_control_points);
+
+    const auto* segment = (i < num_shared)?
+                          dynamic_cast<const drake::trajectories::BezierCurve<double>*>(&parent_traj.segment(i)) :
+                          nullptr;
+    if (segment && segment->control_points().cols() == num_control_points) {
+      /// Shared prefix: reuse the parent's control points and time scaling
+      control_points = segment->control_points();
+      last_h = segment->end_time() - segment->start_time();
+    } else {
+      /// New region: walk from where the parent ended to a point inside the region
+      const Eigen::VectorXd& anchor = GetVertexGeometry(path_vids[i].get_value()-1).center_;
+      const Eigen::VectorXd from = last_point.size()? last_point : anchor;
+      for (int j=0; j<num_control_points; ++j) {
+        const double alpha = (num_control_points > 1)? static_cast<double>(j)/(num_control_points-1) : 1.0;
+        control_points.col(j) = (1.0-alpha)*from + alpha*anchor;
+      }
+    }
+    if (enable_time_cost_) {
+      x_guess.tail<1>()(0) = std::min(std::max(last_h, h_min_), h_max_);
+    }
+    last_point = control_points.col(num_control_points-1);
+    prog.SetInitialGuess(vertex->x(), x_guess);
+
+    /// Slacks of the conic rewrite are guessed tight, i.e. equal to the segment norms
+    for (const auto& binding : vertex_id_to_constraint_binding_[path_vids[i].get_value()-1]) {
+      const auto* lorentz = dynamic_cast<const drake::solvers::LorentzConeConstraint*>(binding.evaluator().get());
+      if (!lorentz) {
+        continue;
+      }
+      Eigen::VectorXd vals = prog.GetInitialGuess(binding.variables());
+      vals(0) = 0;
+      const Eigen::VectorXd z = lorentz->A_dense()*vals + lorentz->b();
+      prog.SetInitialGuess(binding.variables()(0), z.tail(z.size()-1).norm());
+    }
+  }
+}
 
-  return {final_trajectory, result};
+double ps::GCSOpt::RepresentativeDistance(int64_t vid, const Eigen::VectorXd& point) const {
+  return (GetVertexGeometry(vid).feasible_point_ - point).norm();
 }
 
 double ps::GCSOpt::CalculateCost(
@@ -452,27 +843,159 @@ double ps::GCSOpt::CalculateCost(
 
   if (!result.is_success()) {
     return INFINITY;
-  } else {
-    auto p0 = traj.value(traj.start_time());
-    double dist = 0;
-    for (double t=traj.start_time(); t<=traj.end_time(); t+=1e-1) {
-      auto pt = traj.value(t);
-      dist += (pt-p0).norm();
-      p0 = pt;
+  }
+
+  double cost = 0;
+  if (enable_path_length_cost_) {
+    cost += path_length_weight_(0,0)*PathLength(traj);
+  }
+  if (enable_time_cost_) {
+    cost += time_weight_*traj.end_time();
+  }
+  return cost;
+}
+
+double ps::GCSOpt::PathLength(const drake::trajectories::CompositeTrajectory<double>& traj) {
+  double length = 0;
+  for (int i=0; i<traj.get_number_of_segments(); ++i) {
+    const auto& segment = traj.segment(i);
+    const auto* bezier = dynamic_cast<const drake::trajectories::BezierCurve<double>*>(&segment);
+    if (!bezier) {
+      const double t0 = segment.start_time(), duration = segment.end_time() - t0;
+      for (int q=0; q<kNumQuadPoints; ++q) {
+        length += kQuadWeights[q]*duration*segment.EvalDerivative(t0 + kQuadNodes[q]*duration, 1).norm();
+      }
+      continue;
     }
 
-    return path_length_weight_(0,0)*dist + time_weight_*traj.end_time();
+    const auto& control_points = bezier->control_points();
+    const int degree = control_points.cols() - 1;
+    if (degree == 1) {
+      length += (control_points.col(1) - control_points.col(0)).norm();
+      continue;
+    }
+    /// In normalized time s the derivative is degree * sum_k (P_k+1 - P_k) b_k(s) with the
+    /// Bernstein polynomials b_k of degree-1, so the duration drops out. The rule is applied on
+    /// degree-1 pieces of [0, 1] to follow the turns of the curve.
+    const int num_pieces = degree - 1;
+    for (int q=0; q<num_pieces*kNumQuadPoints; ++q) {
+      const double s = (q/kNumQuadPoints + kQuadNodes[q%kNumQuadPoints])/num_pieces;
+      const double ratio = s/(1 - s);
+      const double b0 = std::pow(1 - s, degree - 1);
+      double speed_sq = 0;
+      for (int d=0; d<control_points.rows(); ++d) {
+        double b = b0, deriv = 0;
+        for (int k=0; k<degree; ++k) {
+          deriv += (control_points(d, k+1) - control_points(d, k))*b;
+          b *= ratio*(degree - 1 - k)/(k + 1);
+        }
+        speed_sq += deriv*deriv;
+      }
+      length += kQuadWeights[q%kNumQuadPoints]*degree*std::sqrt(speed_sq)/num_pieces;
+    }
   }
-  return INFINITY;
+  return length;
 }
 
 void ps::GCSOpt::CleanUp() {
-  gcs_->RemoveVertex(start_vtx_);
-  gcs_->RemoveVertex(goal_vtx_);
-  vertices_.erase(start_vit_);
-  vertices_.erase(goal_vit_);
-  edges_.erase(start_eit_);
-  edges_.erase(goal_eit_);
+  GCSVertex* start_vtx = start_vtx_;
+  GCSVertex* goal_vtx = goal_vtx_;
+  ReleaseTerminals();
+
+  for (GCSVertex* v : {start_vtx, goal_vtx}) {
+    if (!v) {
+      continue;
+    }
+    if (conic_template_) {
+      conic_template_->RemoveVertex(v->id().get_value()-1);
+    }
+    /// Also removes the terminal edges from the graph
+    gcs_->RemoveVertex(v);
+  }
+}
+
+void ps::GCSOpt::ReleaseTerminals() {
+  for (GCSVertex* v : {start_vtx_, goal_vtx_}) {
+    if (!v) {
+      continue;
+    }
+    const int64_t id = v->id().get_value()-1;
+
+    /// Terminal edges are the ones into or out of the terminal
+    auto is_terminal_edge = [&](const GCSEdge* e) {
+      return e->u().id() == v->id() || e->v().id() == v->id();
+    };
+    for (const auto* e : edges_) {
+      if (is_terminal_edge(e)) {
+        edge_id_to_edge_.erase(e->id().get_value()-1);
+        edge_id_to_cost_binding_.erase(e->id().get_value()-1);
+        edge_id_to_constraint_binding_.erase(e->id().get_value()-1);
+        if (e->v().id() == v->id()) {
+          auto& region_out_edges = vertex_id_to_out_edges_[e->u().id().get_value()-1];
+          region_out_edges.erase(std::remove(region_out_edges.begin(), region_out_edges.end(), e),
+                                 region_out_edges.end());
+        }
+      }
+    }
+    edges_.erase(std::remove_if(edges_.begin(), edges_.end(), is_terminal_edge), edges_.end());
+
+    vertices_.erase(std::remove(vertices_.begin(), vertices_.end(), v), vertices_.end());
+    vertex_id_to_vertex_.erase(id);
+    vertex_id_to_cost_binding_.erase(id);
+    vertex_id_to_constraint_binding_.erase(id);
+    vertex_id_to_slack_vars_.erase(id);
+    vertex_id_to_out_edges_.erase(id);
+    terminal_geometry_.erase(id);
+  }
+
+  start_vtx_ = nullptr;
+  goal_vtx_ = nullptr;
+}
+
+void ps::GCSOpt::AdoptTerminals(const GCSOpt& other) {
+  if (other.gcs_ != gcs_) {
+    throw std::runtime_error("Can only adopt terminals of an optimizer sharing the same graph!");
+  }
+  ReleaseTerminals();
+
+  for (GCSVertex* v : {other.start_vtx_, other.goal_vtx_}) {
+    if (!v) {
+      continue;
+    }
+    const int64_t id = v->id().get_value()-1;
+
+    vertices_.push_back(v);
+    vertex_id_to_vertex_[id] = v;
+    auto cit = other.vertex_id_to_cost_binding_.find(id);
+    if (cit != other.vertex_id_to_cost_binding_.end()) {
+      vertex_id_to_cost_binding_[id] = cit->second;
+    }
+    auto kit = other.vertex_id_to_constraint_binding_.find(id);
+    if (kit != other.vertex_id_to_constraint_binding_.end()) {
+      vertex_id_to_constraint_binding_[id] = kit->second;
+    }
+    auto sit = other.vertex_id_to_slack_vars_.find(id);
+    if (sit != other.vertex_id_to_slack_vars_.end()) {
+      vertex_id_to_slack_vars_[id] = sit->second;
+    }
+    terminal_geometry_[id] = other.terminal_geometry_.at(id);
+
+    for (auto* e : other.edges_) {
+      if (e->u().id() != v->id() && e->v().id() != v->id()) {
+        continue;
+      }
+      addEdge(e);
+      auto eit = other.edge_id_to_constraint_binding_.find(e->id().get_value()-1);
+      if (eit != other.edge_id_to_constraint_binding_.end()) {
+        edge_id_to_constraint_binding_[e->id().get_value()-1] = eit->second;
+      }
+    }
+  }
+
+  start_vtx_ = other.start_vtx_;
+  goal_vtx_ = other.goal_vtx_;
+  /// other drops the shared template if a terminal could not be compiled
+  conic_template_ = other.conic_template_;
 }
 
 void ps::GCSOpt::setupVars() {
@@ -545,12 +1068,91 @@ void ps::GCSOpt::preprocess(const drake::geometry::optimization::ConvexSets &reg
     // Add edge.
     GCSVertex* u = vertices_[u_index];
     GCSVertex* v = vertices_[v_index];
-    GCSEdge* uv_edge = gcs_->AddEdge(u, v);
+    addEdge(gcs_->AddEdge(u, v));
+  }
+
+}
+
+void ps::GCSOpt::computeRegionGeometry(std::shared_ptr<const std::vector<GCSVertexGeometry>> region_geometry) {
+  region_id_offset_ = vertices_[0]->id().get_value()-1;
+
+  if (region_geometry) {
+    if (region_geometry->size() != hpoly_regions_.size()) {
+      throw std::runtime_error("Region geometry has " + std::to_string(region_geometry->size()) +
+                               " entries for " + std::to_string(hpoly_regions_.size()) + " regions!");
+    }
+    region_geometry_ = std::move(region_geometry);
+    return;
+  }
+
+  auto geometry_vec = std::make_shared<std::vector<GCSVertexGeometry>>(hpoly_regions_.size());
+  for (size_t i = 0; i < hpoly_regions_.size(); ++i) {
+    const auto& region = hpoly_regions_[i];
+    auto& geometry = (*geometry_vec)[i];
+    geometry.center_ = region.ChebyshevCenter();
+    auto feasible_point = region.MaybeGetFeasiblePoint();
+    geometry.feasible_point_ = feasible_point? feasible_point.value() : geometry.center_;
+  }
+  region_geometry_ = geometry_vec;
+}
+
+void ps::GCSOpt::addTerminalGeometry(const GCSVertex* v, const Eigen::VectorXd& point) {
+  GCSVertexGeometry geometry;
+  geometry.center_ = point;
+  geometry.feasible_point_ = point;
+  terminal_geometry_[v->id().get_value()-1] = geometry;
+}
+
+ps::GCSVertex* ps::GCSOpt::findRegionVertex(const Eigen::VectorXd& point) const {
+  /// Regions are the first vertices
+  for (size_t i = 0; i < hpoly_regions_.size(); ++i) {
+    if (hpoly_regions_[i].PointInSet(point)) {
+      return vertices_[i];
+    }
+  }
+  throw std::runtime_error("Point is not inside any of the regions!");
+}
+
+void ps::GCSOpt::setupTerminalCostsAndConstraints(GCSVertex* v) {
+  const int64_t vid = v->id().get_value()-1;
+  addCosts(v);
+  addConstraints(v);
+  rewriteForConvexSolver(vid);
+
+  std::vector<const GCSEdge*> terminal_edges;
+  for (const auto* e : edges_) {
+    if (e->u().id() == v->id() || e->v().id() == v->id()) {
+      addConstraints(e);
+      terminal_edges.push_back(e);
+    }
+  }
 
-    edges_.emplace_back(uv_edge);
-    edge_id_to_edge_[edges_.back()->id().get_value()-1] = edges_.back();
+  if (conic_template_) {
+    try {
+      conic_template_->AddVertex(v, vertex_id_to_cost_binding_[vid], vertex_id_to_constraint_binding_[vid]);
+      for (const auto* e : terminal_edges) {
+        conic_template_->AddEdge(e, edge_id_to_constraint_binding_[e->id().get_value()-1]);
+      }
+    } catch (const std::runtime_error& ex) {
+      if (verbose_) std::cout << "Could not compile terminal into conic template: " << ex.what() << std::endl;
+      conic_template_.reset();
+    }
   }
+}
+
+void ps::GCSOpt::addEdge(GCSEdge* e) {
+  edges_.emplace_back(e);
+  edge_id_to_edge_[e->id().get_value()-1] = e;
+  vertex_id_to_out_edges_[e->u().id().get_value()-1].push_back(e);
+}
 
+ps::EdgeId ps::GCSOpt::findEdge(int64_t uid, int64_t vid) {
+  for (const auto* e : vertex_id_to_out_edges_[uid]) {
+    if (e->v().id().get_value()-1 == vid) {
+      return e->id();
+    }
+  }
+  throw std::runtime_error("No edge from vertex " + std::to_string(uid) + " to vertex " + std::to_string(vid) + "!!");
 }
 
 void ps::GCSOpt::formulateTimeCost() {
@@ -730,94 +1332,99 @@ void ps::GCSOpt::setupCostsAndConstraints() {
 operating with nonlinear constraints. This removes costs and adds variables and
 constraints as needed by the solvers. */
 void ps::GCSOpt::RewriteForConvexSolver() {
+  for (auto& vtx_costs : vertex_id_to_cost_binding_) {
+    rewriteForConvexSolver(vtx_costs.first);
+  }
+}
+
+void ps::GCSOpt::rewriteForConvexSolver(int64_t vid) {
   drake::solvers::MathematicalProgram prog;
 
   const double kInf = std::numeric_limits<double>::infinity();
-  for (auto& vtx_costs : vertex_id_to_cost_binding_) {
-    std::vector<CostBinding> new_costs;
-    for (auto& cst_bind : vtx_costs.second) {
-      const drake::solvers::Cost* cst = cst_bind.evaluator().get();
-
-      if (const auto* l2c = dynamic_cast<const drake::solvers::L2NormCost*>(cst)) {
-        const int m = l2c->A().rows();
-        const int n = l2c->A().cols();
-        auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
-        slack_vars_.emplace_back(slack);
-        auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
-        auto new_cost_binding =
-            drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
-        new_costs.emplace_back(new_cost_binding);
-        // |Ax+b|² ≤ slack, written as a Lorentz cone with z = [slack; Ax+b].
-        Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m + 1, n + 1);
-        A(0, 0) = 1;
-        A.bottomRightCorner(m, n) = l2c->A();
-        Eigen::VectorXd b(m + 1);
-        b << 0, l2c->b();
-        auto new_con = std::make_shared<drake::solvers::LorentzConeConstraint>(A, b);
-        auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {slack, cst_bind.variables()});
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(new_con_binding);
-      } else if (const auto* l1c = dynamic_cast<const drake::solvers::L1NormCost*>(cst)) {
-        const int m = l1c->A().rows();
-        const int n = l1c->A().cols();
-        auto slack = drake::symbolic::MakeVectorContinuousVariable(m, "slack");
-        slack_vars_.emplace_back(slack);
-        auto new_cost = std::make_shared<drake::solvers::LinearCost>(Eigen::VectorXd::Ones(m));
-        auto new_cost_binding =
-            drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
-        new_costs.emplace_back(new_cost_binding);
-        // Ax + b ≤ slack, written as [A,-I][x;slack] ≤ -b.
-        Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m, m + n);
-        A << l1c->A(), -Eigen::MatrixXd::Identity(m, m);
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(prog.AddLinearConstraint(A, Eigen::VectorXd::Constant(m, -kInf), -l1c->b(),
-                                  {cst_bind.variables(), slack}));
-        // -(Ax + b) ≤ slack, written as [A,I][x;slack] ≥ -b.
-        A.rightCols(m) = Eigen::MatrixXd::Identity(m, m);
-        auto new_con = std::make_shared<drake::solvers::LinearConstraint>(A, -l1c->b(), Eigen::VectorXd::Constant(m, kInf));
-        auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {cst_bind.variables(), slack});
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(new_con_binding);
-      } else if (const auto* linfc = dynamic_cast<const drake::solvers::LInfNormCost*>(cst)) {
-        const int m = linfc->A().rows();
-        const int n = linfc->A().cols();
-        auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
-        slack_vars_.emplace_back(slack);
-        auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
-        auto new_cost_binding =
-            drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
-        new_costs.emplace_back(new_cost_binding);
-        // ∀i, aᵢᵀx + bᵢ ≤ slack, written as [A,-1][x;slack] ≤ -b.
-        Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m, n + 1);
-        A << linfc->A(), Eigen::VectorXd::Constant(m, -1);
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(prog.AddLinearConstraint(A, Eigen::VectorXd::Constant(m, -kInf), -linfc->b(),
-                                  {cst_bind.variables(), slack}));
-        // ∀i, -(aᵢᵀx + bᵢ) ≤ slack, written as [A,1][x;slack] ≥ -b.
-        A.col(A.cols() - 1) = Eigen::VectorXd::Ones(m);
-        auto new_con = std::make_shared<drake::solvers::LinearConstraint>(A, -linfc->b(), Eigen::VectorXd::Constant(m, kInf));
-        auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {cst_bind.variables(), slack});
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(new_con_binding);
-      } else if (const auto* pqc = dynamic_cast<const drake::solvers::PerspectiveQuadraticCost*>(cst)) {
-        const int m = pqc->A().rows();
-        const int n = pqc->A().cols();
-        auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
-        slack_vars_.emplace_back(slack);
-        auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
-        auto new_cost_binding =
-            drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
-        new_costs.emplace_back(new_cost_binding);
-        // Written as rotated Lorentz cone with z = [slack; Ax+b].
-        Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m + 1, n + 1);
-        A(0, 0) = 1;
-        A.bottomRightCorner(m, n) = pqc->A();
-        Eigen::VectorXd b(m + 1);
-        b << 0, pqc->b();
-        auto new_con = std::make_shared<drake::solvers::RotatedLorentzConeConstraint>(A, b);
-        auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {slack, cst_bind.variables()});
-        vertex_id_to_constraint_binding_[vtx_costs.first].emplace_back(new_con_binding);
-      } else {
-        new_costs.emplace_back(cst_bind);
-      }
+  auto& costs = vertex_id_to_cost_binding_[vid];
+  std::vector<CostBinding> new_costs;
+  for (auto& cst_bind : costs) {
+    const drake::solvers::Cost* cst = cst_bind.evaluator().get();
+
+    if (const auto* l2c = dynamic_cast<const drake::solvers::L2NormCost*>(cst)) {
+      const int m = l2c->A().rows();
+      const int n = l2c->A().cols();
+      auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
+      vertex_id_to_slack_vars_[vid].emplace_back(slack);
+      auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
+      auto new_cost_binding =
+          drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
+      new_costs.emplace_back(new_cost_binding);
+      // |Ax+b|² ≤ slack, written as a Lorentz cone with z = [slack; Ax+b].
+      Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m + 1, n + 1);
+      A(0, 0) = 1;
+      A.bottomRightCorner(m, n) = l2c->A();
+      Eigen::VectorXd b(m + 1);
+      b << 0, l2c->b();
+      auto new_con = std::make_shared<drake::solvers::LorentzConeConstraint>(A, b);
+      auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {slack, cst_bind.variables()});
+      vertex_id_to_constraint_binding_[vid].emplace_back(new_con_binding);
+    } else if (const auto* l1c = dynamic_cast<const drake::solvers::L1NormCost*>(cst)) {
+      const int m = l1c->A().rows();
+      const int n = l1c->A().cols();
+      auto slack = drake::symbolic::MakeVectorContinuousVariable(m, "slack");
+      vertex_id_to_slack_vars_[vid].emplace_back(slack);
+      auto new_cost = std::make_shared<drake::solvers::LinearCost>(Eigen::VectorXd::Ones(m));
+      auto new_cost_binding =
+          drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
+      new_costs.emplace_back(new_cost_binding);
+      // Ax + b ≤ slack, written as [A,-I][x;slack] ≤ -b.
+      Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m, m + n);
+      A << l1c->A(), -Eigen::MatrixXd::Identity(m, m);
+      vertex_id_to_constraint_binding_[vid].emplace_back(prog.AddLinearConstraint(A, Eigen::VectorXd::Constant(m, -kInf), -l1c->b(),
+                                {cst_bind.variables(), slack}));
+      // -(Ax + b) ≤ slack, written as [A,I][x;slack] ≥ -b.
+      A.rightCols(m) = Eigen::MatrixXd::Identity(m, m);
+      auto new_con = std::make_shared<drake::solvers::LinearConstraint>(A, -l1c->b(), Eigen::VectorXd::Constant(m, kInf));
+      auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {cst_bind.variables(), slack});
+      vertex_id_to_constraint_binding_[vid].emplace_back(new_con_binding);
+    } else if (const auto* linfc = dynamic_cast<const drake::solvers::LInfNormCost*>(cst)) {
+      const int m = linfc->A().rows();
+      const int n = linfc->A().cols();
+      auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
+      vertex_id_to_slack_vars_[vid].emplace_back(slack);
+      auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
+      auto new_cost_binding =
+          drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
+      new_costs.emplace_back(new_cost_binding);
+      // ∀i, aᵢᵀx + bᵢ ≤ slack, written as [A,-1][x;slack] ≤ -b.
+      Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m, n + 1);
+      A << linfc->A(), Eigen::VectorXd::Constant(m, -1);
+      vertex_id_to_constraint_binding_[vid].emplace_back(prog.AddLinearConstraint(A, Eigen::VectorXd::Constant(m, -kInf), -linfc->b(),
+                                {cst_bind.variables(), slack}));
+      // ∀i, -(aᵢᵀx + bᵢ) ≤ slack, written as [A,1][x;slack] ≥ -b.
+      A.col(A.cols() - 1) = Eigen::VectorXd::Ones(m);
+      auto new_con = std::make_shared<drake::solvers::LinearConstraint>(A, -linfc->b(), Eigen::VectorXd::Constant(m, kInf));
+      auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {cst_bind.variables(), slack});
+      vertex_id_to_constraint_binding_[vid].emplace_back(new_con_binding);
+    } else if (const auto* pqc = dynamic_cast<const drake::solvers::PerspectiveQuadraticCost*>(cst)) {
+      const int m = pqc->A().rows();
+      const int n = pqc->A().cols();
+      auto slack = drake::symbolic::MakeVectorContinuousVariable(1, "slack");
+      vertex_id_to_slack_vars_[vid].emplace_back(slack);
+      auto new_cost = std::make_shared<drake::solvers::LinearCost>(drake::Vector1d::Ones());
+      auto new_cost_binding =
+          drake::solvers::Binding<drake::solvers::Cost>(new_cost, slack);
+      new_costs.emplace_back(new_cost_binding);
+      // Written as rotated Lorentz cone with z = [slack; Ax+b].
+      Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m + 1, n + 1);
+      A(0, 0) = 1;
+      A.bottomRightCorner(m, n) = pqc->A();
+      Eigen::VectorXd b(m + 1);
+      b << 0, pqc->b();
+      auto new_con = std::make_shared<drake::solvers::RotatedLorentzConeConstraint>(A, b);
+      auto new_con_binding = drake::solvers::Binding<drake::solvers::Constraint>(new_con, {slack, cst_bind.variables()});
+      vertex_id_to_constraint_binding_[vid].emplace_back(new_con_binding);
+    } else {
+      new_costs.emplace_back(cst_bind);
     }
-    vtx_costs.second = new_costs;
   }
+  costs = new_costs;
 }
 
 /* Most convex solvers require only support linear and quadratic costs when
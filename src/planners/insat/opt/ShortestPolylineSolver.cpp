@@ -0,0 +1,281 @@
+/*!
+ * \file ShortestPolylineSolver.cpp
+ * \brief Shortest polyline through a chain of polytopes
+*/
+
+#include <planners/insat/opt/ShortestPolylineSolver.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ps {
+
+  namespace {
+
+    /// Slack allowed on set membership, relative to the magnitude of the right hand side
+    const double kSetTol = 1e-9;
+
+  }
+
+  void ShortestPolylineSolver::Reset(int num_positions) {
+    num_positions_ = num_positions;
+    sets_.clear();
+  }
+
+  void ShortestPolylineSolver::AddPolytope(const Eigen::MatrixXd& A, const Eigen::VectorXd& b) {
+    ChainSet set;
+    set.A_ = &A;
+    set.b_ = &b;
+    sets_.push_back(set);
+  }
+
+  void ShortestPolylineSolver::AddPoint(const Eigen::VectorXd& point) {
+    ChainSet set;
+    set.point_ = &point;
+    sets_.push_back(set);
+  }
+
+  ShortestPolylineSolver::Status ShortestPolylineSolver::Solve(double weight, double time_limit) {
+    closed_form_ = false;
+    const int num_sets = sets_.size();
+    if (num_sets == 0) {
+      return Status::kFailed;
+    }
+    waypoints_.resize(num_positions_, num_sets+1);
+
+    if (!fixWaypoints()) {
+      return Status::kInfeasible;
+    }
+    if (solveStraightLine()) {
+      closed_form_ = true;
+      cost_ = weight*dir_.norm();
+      return Status::kSolved;
+    }
+
+    assemble(weight);
+    const auto status = socp_.Solve(prob_, time_limit);
+    if (status == ChainSocpSolver::Status::kTimeLimit) {
+      return Status::kTimeLimit;
+    }
+    if (status != ChainSocpSolver::Status::kSolved) {
+      return Status::kFailed;
+    }
+
+    /// Fixed waypoints keep their exact points
+    const Eigen::VectorXd& x = socp_.GetX();
+    cost_ = 0;
+    for (int j=0; j<=num_sets; ++j) {
+      if (fixed_[j] < 0) {
+        waypoints_.col(j) = x.segment(prob_.col_offsets_[j], num_positions_);
+      }
+      if (j > 0) {
+        cost_ += (waypoints_.col(j) - waypoints_.col(j-1)).norm();
+      }
+    }
+    cost_ *= weight;
+    return Status::kSolved;
+  }
+
+  bool ShortestPolylineSolver::fixWaypoints() {
+    const int num_sets = sets_.size();
+    fixed_.assign(num_sets+1, -1);
+    for (int i=0; i<num_sets; ++i) {
+      if (!sets_[i].point_) {
+        continue;
+      }
+      for (int j=i; j<=i+1; ++j) {
+        if (fixed_[j] >= 0 && !contains(sets_[fixed_[j]], *sets_[i].point_)) {
+          return false;
+        }
+        fixed_[j] = i;
+        waypoints_.col(j) = *sets_[i].point_;
+      }
+    }
+
+    /// A fixed waypoint also has to be in the polytopes of its segments
+    for (int j=0; j<=num_sets; ++j) {
+      if (fixed_[j] < 0) {
+        continue;
+      }
+      if ((j > 0 && !contains(sets_[j-1], waypoints_.col(j))) ||
+          (j < num_sets && !contains(sets_[j], waypoints_.col(j)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ShortestPolylineSolver::solveStraightLine() {
+    const int num_sets = sets_.size();
+    if (fixed_[0] < 0 || fixed_[num_sets] < 0) {
+      return false;
+    }
+
+    /// Waypoint j sits at q_0 + s_j dir with 0 <= s_1 <= ... <= s_N-1 <= 1. Each waypoint
+    /// takes the smallest s its two sets allow, which finds such a sequence if there is one.
+    const Eigen::VectorXd& origin = *sets_[fixed_[0]].point_;
+    dir_ = waypoints_.col(num_sets) - origin;
+    double s_prev = 0;
+    for (int j=1; j<num_sets; ++j) {
+      double lo = 0, hi = 1;
+      if (!lineInterval(sets_[j-1], origin, dir_, lo, hi) || !lineInterval(sets_[j], origin, dir_, lo, hi)) {
+        return false;
+      }
+      double s = std::max(s_prev, lo);
+      if (s > 1 + kSetTol) {
+        return false;
+      }
+      s = std::min(s, 1.0);
+      if (fixed_[j] < 0) {
+        waypoints_.col(j) = origin + s*dir_;
+      } else {
+        /// A fixed waypoint stays at its point, so the ones after it are ordered from there. One
+        /// behind the previous waypoint turns the line back.
+        const double dir_sq = dir_.squaredNorm();
+        s = (dir_sq > 0)? (waypoints_.col(j) - origin).dot(dir_)/dir_sq : 0;
+        if (s < s_prev - kSetTol) {
+          return false;
+        }
+      }
+      if (!contains(sets_[j-1], waypoints_.col(j)) || !contains(sets_[j], waypoints_.col(j))) {
+        return false;
+      }
+      s_prev = s;
+    }
+    return true;
+  }
+
+  bool ShortestPolylineSolver::lineInterval(const ChainSet& set, const Eigen::VectorXd& origin,
+                                            const Eigen::VectorXd& dir, double& lo, double& hi) const {
+    if (set.point_) {
+      const double dir_sq = dir.squaredNorm();
+      const double s = (dir_sq > 0)? (*set.point_ - origin).dot(dir)/dir_sq : 0;
+      if ((origin + s*dir - *set.point_).norm() > kSetTol*std::max(1.0, set.point_->norm())) {
+        return false;
+      }
+      lo = std::max(lo, s);
+      hi = std::min(hi, s);
+      return true;
+    }
+
+    const Eigen::MatrixXd& A = *set.A_;
+    const Eigen::VectorXd& b = *set.b_;
+    for (int r=0; r<A.rows(); ++r) {
+      const double rate = A.row(r).dot(dir);
+      const double slack = b(r) - A.row(r).dot(origin);
+      if (rate > 0) {
+        hi = std::min(hi, slack/rate);
+      } else if (rate < 0) {
+        lo = std::max(lo, slack/rate);
+      } else if (slack < -kSetTol*std::max(1.0, std::abs(b(r)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ShortestPolylineSolver::contains(const ChainSet& set, const Eigen::VectorXd& p) const {
+    if (set.point_) {
+      return (p - *set.point_).norm() <= kSetTol*std::max(1.0, set.point_->norm());
+    }
+    const Eigen::MatrixXd& A = *set.A_;
+    const Eigen::VectorXd& b = *set.b_;
+    for (int r=0; r<A.rows(); ++r) {
+      if (A.row(r).dot(p) - b(r) > kSetTol*std::max(1.0, std::abs(b(r)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void ShortestPolylineSolver::assemble(double weight) {
+    const int num_sets = sets_.size();
+    const int np = num_positions_;
+
+    /// Segments between two fixed waypoints have a constant length and get no t_i. A cone at
+    /// its apex makes the interior point method stall.
+    auto constant_length = [this](int i) {
+      return fixed_[i] >= 0 && fixed_[i+1] >= 0;
+    };
+
+    prob_.col_offsets_.resize(num_sets+1);
+    int num_vars = 0;
+    for (int j=0; j<=num_sets; ++j) {
+      prob_.col_offsets_[j] = num_vars;
+      num_vars += (j < num_sets && !constant_length(j))? np+1 : np;
+    }
+    prob_.num_vars_ = num_vars;
+    prob_.c_.assign(num_vars, 0);
+    prob_.c0_ = 0;
+    for (int i=0; i<num_sets; ++i) {
+      if (constant_length(i)) {
+        prob_.c0_ += weight*(waypoints_.col(i+1) - waypoints_.col(i)).norm();
+      } else {
+        prob_.c_[prob_.col_offsets_[i]+np] = weight;
+      }
+    }
+
+    prob_.eq_.Truncate(0);
+    prob_.ineq_.Truncate(0);
+    prob_.soc_.Truncate(0);
+    prob_.soc_dims_.clear();
+    /// Entries of the row being built, added to rows by end_row
+    std::vector<int> cols;
+    std::vector<double> vals;
+    auto add_entry = [&](int col, double val) {
+      cols.push_back(col);
+      vals.push_back(val);
+    };
+    auto end_row = [&](ConicRows& rows, double b) {
+      rows.AddRow(cols, vals, b);
+      cols.clear();
+      vals.clear();
+    };
+
+    /// q_j = p for the fixed waypoints
+    for (int j=0; j<=num_sets; ++j) {
+      if (fixed_[j] < 0) {
+        continue;
+      }
+      for (int k=0; k<np; ++k) {
+        add_entry(prob_.col_offsets_[j]+k, 1);
+        end_row(prob_.eq_, waypoints_(k, j));
+      }
+    }
+
+    /// A q_j <= b for the polytopes of both segments at a free waypoint
+    for (int j=0; j<=num_sets; ++j) {
+      if (fixed_[j] >= 0) {
+        continue;
+      }
+      for (int i=std::max(0, j-1); i<=std::min(j, num_sets-1); ++i) {
+        const Eigen::MatrixXd& A = *sets_[i].A_;
+        const Eigen::VectorXd& b = *sets_[i].b_;
+        for (int r=0; r<A.rows(); ++r) {
+          for (int k=0; k<np; ++k) {
+            if (A(r, k) != 0) {
+              add_entry(prob_.col_offsets_[j]+k, A(r, k));
+            }
+          }
+          end_row(prob_.ineq_, b(r));
+        }
+      }
+    }
+
+    /// (t_i, q_i+1 - q_i) in the second order cone
+    for (int i=0; i<num_sets; ++i) {
+      if (constant_length(i)) {
+        continue;
+      }
+      add_entry(prob_.col_offsets_[i]+np, -1);
+      end_row(prob_.soc_, 0);
+      for (int k=0; k<np; ++k) {
+        add_entry(prob_.col_offsets_[i]+k, 1);
+        add_entry(prob_.col_offsets_[i+1]+k, -1);
+        end_row(prob_.soc_, 0);
+      }
+      prob_.soc_dims_.push_back(np+1);
+    }
+  }
+
+}
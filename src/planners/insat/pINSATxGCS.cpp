@@ -3,6 +3,8 @@
 #include <planners/insat/pINSATxGCS.hpp>
 
 #define INDEPENDENCE_CHECK 0
+#define NUM_STATE_LOCKS 64
+#define MAX_PENDING_PER_WORKER 2
 
 using namespace std;
 using namespace ps;
@@ -10,7 +12,8 @@ using namespace ps;
 pINSATxGCS::pINSATxGCS(ParamsType planner_params):
         GepasePlanner(planner_params),
         INSATxGCS(planner_params),
-        Planner(planner_params)
+        Planner(planner_params),
+        state_locks_(NUM_STATE_LOCKS)
 {
 
 }
@@ -58,35 +61,20 @@ bool pINSATxGCS::Plan()
 
         if (INDEPENDENCE_CHECK)
         {
-          // Independence check of curr_edge with edges in BE
+          // Independence check of curr_edge with edges in BE and edges in OPEN that are in front of curr_edge
+          independence_states_.clear();
           for (auto& being_expanded_state : being_expanded_states_)
           {
-            if (being_expanded_state != curr_edge_ptr->lowD_parent_state_ptr_)
-            {
-              auto h_diff = computeHeuristic(being_expanded_state, curr_edge_ptr->lowD_parent_state_ptr_);
-              if (curr_edge_ptr->lowD_parent_state_ptr_->GetGValue() > being_expanded_state->GetGValue() + heuristic_w_*h_diff)
-              {
-                curr_edge_ptr = NULL;
-                break;
-              }
-            }
+            independence_states_.emplace_back(being_expanded_state);
+          }
+          for (auto& popped_edge_ptr : popped_edges)
+          {
+            independence_states_.emplace_back(popped_edge_ptr->lowD_parent_state_ptr_);
           }
 
-          if (curr_edge_ptr)
+          if (!independence_checker_.IsIndependent(curr_edge_ptr->lowD_parent_state_ptr_, independence_states_))
           {
-            // Independence check of curr_edge with edges in OPEN that are in front of curr_edge
-            for (auto& popped_edge_ptr : popped_edges)
-            {
-              if (popped_edge_ptr->lowD_parent_state_ptr_ != curr_edge_ptr->lowD_parent_state_ptr_)
-              {
-                auto h_diff = computeHeuristic(popped_edge_ptr->lowD_parent_state_ptr_, curr_edge_ptr->lowD_parent_state_ptr_);
-                if (curr_edge_ptr->lowD_parent_state_ptr_->GetGValue() > popped_edge_ptr->lowD_parent_state_ptr_->GetGValue() + heuristic_w_*h_diff)
-                {
-                  curr_edge_ptr = NULL;
-                  break;
-                }
-              }
-            }
+            curr_edge_ptr = NULL;
           }
         }
       }
@@ -126,12 +114,17 @@ bool pINSATxGCS::Plan()
         // cout << "Goal Reached!" << endl;
         // cout << "--------------------------------------------------------" << endl;            
 
-        // Construct path
+        // Construct path once the workers, which update g-values and parents outside lock_, are done
         goal_state_ptr_ = curr_edge_ptr->lowD_parent_state_ptr_;
-        constructPlan(goal_state_ptr_);
         terminate_ = true;
         recheck_flag_ = true;
         lock_.unlock();
+        if (pool_)
+        {
+          cancel_token_.Cancel();
+          pool_->WaitAll();
+        }
+        constructPlan(goal_state_ptr_);
         exit();
 
         return true;
@@ -139,53 +132,39 @@ bool pINSATxGCS::Plan()
 
     }
 
-    // Insert the state in BE and mark it closed if the edge being expanded is dummy edge
+    // Insert the state in BE and mark it closed if the edge being expanded is dummy edge.
+    // Workers check and update the state under its lock, so it is closed under it as well,
+    // which has to be taken before lock_.
     if (curr_edge_ptr->action_ptr_ == dummy_action_ptr_)
     {
+      auto state_ptr = curr_edge_ptr->lowD_parent_state_ptr_;
+      lock_.unlock();
+      lock_guard<LockType> state_locker(stateLock(state_ptr));
+      lock_.lock();
+
+      // A worker may have improved the state and reopened it while lock_ was released
+      if (edge_open_list_.contains(curr_edge_ptr))
+      {
+        edge_open_list_.erase(curr_edge_ptr);
+      }
       planner_stats_.num_state_expansions_++;
-      curr_edge_ptr->lowD_parent_state_ptr_->SetVisited();
-      curr_edge_ptr->lowD_parent_state_ptr_->SetBeingExpanded();
-      being_expanded_states_.push(curr_edge_ptr->lowD_parent_state_ptr_);
+      state_ptr->SetVisited();
+      state_ptr->SetBeingExpanded();
+      being_expanded_states_.push(state_ptr);
     }
 
     lock_.unlock();
 
-    int thread_id = 0;
-    bool edge_expansion_assigned = false;
-
     if (num_threads_ == 1)
     {
       expand(curr_edge_ptr, 0);
     }
     else
     {
-      while (!edge_expansion_assigned)
-      {
-        unique_lock<mutex> locker(lock_vec_[thread_id]);
-        bool status = edge_expansion_status_[thread_id];
-        locker.unlock();
-
-        if (!status)
-        {
-          int num_threads_current = edge_expansion_futures_.size();
-          if (thread_id >= num_threads_current)
-          {
-            if (VERBOSE) cout << "Spawning edge expansion thread " << thread_id << endl;
-            edge_expansion_futures_.emplace_back(async(launch::async, &pINSATxGCS::expandEdgeLoop, this, thread_id));
-          }
-          locker.lock();
-          edge_expansion_vec_[thread_id] = curr_edge_ptr;
-          edge_expansion_status_[thread_id] = 1;
-          edge_expansion_assigned = true;
-          locker.unlock();
-          cv_vec_[thread_id].notify_one();
-        }
-        else
-        {
-          thread_id = thread_id == num_threads_-2 ? 0 : thread_id+1;
-        }
-
-      }
+      // Edges queue up so that idle workers can steal them. The queue is kept short, so that
+      // edges are still taken from the open list in priority order.
+      pool_->Submit([this, curr_edge_ptr](int thread_id){expand(curr_edge_ptr, thread_id);});
+      pool_->WaitForPendingBelow(MAX_PENDING_PER_WORKER*pool_->NumWorkers());
     }
 
     lock_.lock();
@@ -214,20 +193,40 @@ void pINSATxGCS::initialize()
   // Reset state
   planner_stats_ = PlannerStats();
   planner_stats_.num_jobs_per_thread_.resize(num_threads_, 0);
+  thread_stats_.assign(num_threads_, ThreadStats());
+  // Warm solves use IPOPT, whose linear solver is not thread safe
+  warm_start_ = planner_params_["warm_start"] && (num_threads_ == 1);
+  if (planner_params_["warm_start"] && !warm_start_)
+  {
+    cout << "Warm start is disabled with more than one thread" << endl;
+  }
+
+  IndependenceChecker::BatchHeuristicType batch_heuristic;
+  if (batch_binary_heuristic_generator_)
+  {
+    batch_heuristic = [this](const vector<StatePtrType>& state_ptrs, const StatePtrType& state_ptr, vector<double>& h_vals)
+    {
+      computeHeuristics(state_ptrs, state_ptr, h_vals);
+    };
+  }
+  independence_checker_ = IndependenceChecker([this](const StatePtrType& state_ptr_1, const StatePtrType& state_ptr_2)
+                                              {
+                                                return computeHeuristic(state_ptr_1, state_ptr_2);
+                                              },
+                                              batch_heuristic, heuristic_w_);
 
   terminate_ = false;
   recheck_flag_ = true;
 
-  edge_expansion_vec_.clear();
-  edge_expansion_vec_.resize(num_threads_-1, NULL);
-
-  edge_expansion_status_.clear();
-  edge_expansion_status_.resize(num_threads_-1, 0);
-
-  vector<condition_variable> cv_vec(num_threads_-1);
-  cv_vec_.swap(cv_vec);
-
-  edge_expansion_futures_.clear();
+  // A persistent pool is kept from the previous query, along with its started threads
+  if ((num_threads_ > 1) && !pool_)
+  {
+    pool_ = makeWorkerPool(num_threads_-1);
+  }
+  if (pool_)
+  {
+    pinSearchThread(*pool_);
+  }
 
   // Insert proxy edge with start state
   start_state_ptr_->SetGValue(0);
@@ -236,225 +235,201 @@ void pINSATxGCS::initialize()
   auto edge_ptr = new InsatEdge(start_state_ptr_, dummy_action_ptr_);
   edge_ptr->expansion_priority_ = heuristic_w_*computeHeuristic(start_state_ptr_);
 
-  edge_map_.insert(make_pair(getEdgeKey(edge_ptr), edge_ptr));
+  concurrent_edge_map_.Insert(getEdgeKey(edge_ptr), edge_ptr);
   edge_open_list_.push(edge_ptr);
 
   constructInsatActions();
 
 }
 
-void pINSATxGCS::expandEdgeLoop(int thread_id)
-{
-  while (!terminate_)
-  {
-    unique_lock<mutex> locker(lock_vec_[thread_id]);
-    cv_vec_[thread_id].wait(locker, [this, thread_id](){return (edge_expansion_status_[thread_id] == 1);});
-    locker.unlock();
-
-    if (terminate_)
-      break;
-
-    expand(edge_expansion_vec_[thread_id], thread_id);
-
-    locker.lock();
-    edge_expansion_vec_[thread_id] = NULL;
-    edge_expansion_status_[thread_id] = 0;
-    locker.unlock();
-
-  }
-}
-
 void pINSATxGCS::expand(InsatEdgePtrType edge_ptr, int thread_id)
 {
   planner_stats_.num_jobs_per_thread_[thread_id] +=1;
   auto t_start = chrono::steady_clock::now();
-  lock_.lock();
-  auto t_lock_e = chrono::steady_clock::now();
-  planner_stats_.lock_time_ += 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_lock_e-t_start).count();
-
+  auto state_ptr = edge_ptr->lowD_parent_state_ptr_;
 
   // Proxy edge, add the real edges to Eopen
   if (edge_ptr->action_ptr_ == dummy_action_ptr_)
   {
-    auto state_ptr = edge_ptr->lowD_parent_state_ptr_;
-
     state_ptr->SetAncestors(getStateAncestors(state_ptr));
 
+    vector<InsatEdgePtrType> expensive_edges;
+    vector<InsatEdgePtrType> cheap_edges;
     for (auto& action_ptr: insat_actions_ptrs_)
     {
       if (action_ptr->CheckPreconditions(state_ptr->GetStateVars()))
       {
         auto edge_ptr_next = new InsatEdge(state_ptr, action_ptr);
-        edge_map_.insert(make_pair(getEdgeKey(edge_ptr_next), edge_ptr_next));
         edge_ptr_next->expansion_priority_ = edge_ptr->expansion_priority_;
-        state_ptr->num_successors_+=1;
-
         if (action_ptr->IsExpensive())
         {
-          if (VERBOSE) edge_ptr_next->Print("Pushing to open: ");
-
-          edge_open_list_.push(edge_ptr_next);
-          notifyMainThread();
+          expensive_edges.emplace_back(edge_ptr_next);
         }
         else
         {
-          expandEdge(edge_ptr_next, thread_id);
+          cheap_edges.emplace_back(edge_ptr_next);
         }
       }
     }
 
-  }
-  else // Real edge, evaluate and add proxy edges for child 
-  {
-    expandEdge(edge_ptr, thread_id);
-  }
+    for (auto& edge_ptr_next : expensive_edges)
+    {
+      concurrent_edge_map_.Insert(getEdgeKey(edge_ptr_next), edge_ptr_next);
+    }
+    for (auto& edge_ptr_next : cheap_edges)
+    {
+      concurrent_edge_map_.Insert(getEdgeKey(edge_ptr_next), edge_ptr_next);
+    }
 
+    // All successors are counted before any of them can finish, so that the state leaves BE
+    // only after the last one
+    state_ptr->num_successors_ += expensive_edges.size() + cheap_edges.size();
 
-  if (edge_ptr->lowD_parent_state_ptr_->num_expanded_successors_ == edge_ptr->lowD_parent_state_ptr_->num_successors_)
-  {
-    edge_ptr->lowD_parent_state_ptr_->UnsetBeingExpanded();
-    if (being_expanded_states_.contains(edge_ptr->lowD_parent_state_ptr_))
+    if (!expensive_edges.empty())
     {
-      being_expanded_states_.erase(edge_ptr->lowD_parent_state_ptr_);
+      auto open_locker = acquire(lock_, thread_id);
+      for (auto& edge_ptr_next : expensive_edges)
+      {
+        if (VERBOSE) edge_ptr_next->Print("Pushing to open: ");
+        edge_open_list_.push(edge_ptr_next);
+      }
       notifyMainThread();
     }
-  }
 
-  if (edge_ptr->lowD_parent_state_ptr_->num_expanded_successors_ > edge_ptr->lowD_parent_state_ptr_->num_successors_)
-  {
-    edge_ptr->lowD_parent_state_ptr_->Print();
-    throw runtime_error("Number of expanded edges cannot be greater than number of successors");
+    for (auto& edge_ptr_next : cheap_edges)
+    {
+      expandEdge(edge_ptr_next, thread_id);
+    }
+
+    if (state_ptr->num_successors_ == 0)
+    {
+      releaseBeingExpanded(state_ptr, thread_id);
+    }
   }
-  else
+  else // Real edge, evaluate and add proxy edges for child
   {
-    if (VERBOSE) edge_ptr->Print("Expansion completed ");
+    expandEdge(edge_ptr, thread_id);
   }
 
-  auto t_end_expansion = chrono::steady_clock::now();
-  planner_stats_.cumulative_expansions_time_ += 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_end_expansion-t_start).count();
+  if (VERBOSE) edge_ptr->Print("Expansion completed ");
 
-  lock_.unlock();
+  auto t_end_expansion = chrono::steady_clock::now();
+  thread_stats_[thread_id].expansions_time_ += 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_end_expansion-t_start).count();
 }
 
 void pINSATxGCS::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
 {
 
   auto action_ptr = insat_edge_ptr->action_ptr_;
+  auto parent_state_ptr = insat_edge_ptr->lowD_parent_state_ptr_;
   if (VERBOSE) insat_edge_ptr->Print("Expanding ");
-  lock_.unlock();
-  // Evaluate the edge
-  auto t_start = chrono::steady_clock::now();
-  auto action_successor = action_ptr->GetSuccessor(insat_edge_ptr->lowD_parent_state_ptr_->GetStateVars(), thread_id);
-  auto t_end = chrono::steady_clock::now();
-  //********************
-
-  auto t_lock_s = chrono::steady_clock::now();
-  lock_.lock();
-  auto t_lock_e = chrono::steady_clock::now();
-  planner_stats_.lock_time_ += 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_lock_e-t_lock_s).count();
 
-  planner_stats_.num_evaluated_edges_++; // Only the edges controllers that satisfied pre-conditions and args are in the open list
+  // Evaluate the edge
+  auto action_successor = action_ptr->GetSuccessor(parent_state_ptr->GetStateVars(), thread_id);
+  thread_stats_[thread_id].num_evaluated_edges_++; // Only the edges controllers that satisfied pre-conditions and args are in the open list
 
   if (action_successor.success_)
   {
     auto successor_state_ptr = constructInsatState(action_successor.successor_state_vars_costs_.back().first);
-    // double cost = action_successor.successor_state_vars_costs_.back().second;                
 
-    // Set successor and cost in expanded edge
+    // Set successor in expanded edge
     insat_edge_ptr->child_state_ptr_ = successor_state_ptr;
-    // insat_edge_ptr->SetCost(cost);
 
     if (!successor_state_ptr->IsVisited())
     {
-      TrajType traj;
-      double cost = 0;
-      double inc_cost = 0;
-      InsatStatePtrType best_anc;
-      auto ancestors = insat_edge_ptr->lowD_parent_state_ptr_->GetAncestors();
-
-      lock_.unlock();
+      auto ancestors = parent_state_ptr->GetAncestors();
+      InsatEdgePtrType parent_edge_ptr;
+      {
+        auto parent_locker = acquire(stateLock(parent_state_ptr), thread_id);
+        parent_edge_ptr = parent_state_ptr->GetIncomingInsatEdgePtr();
+      }
+      CompactGCSTraj::Ptr parent_traj;
+      if (parent_edge_ptr)
+      {
+        parent_traj = parent_edge_ptr->GetCompactTraj();
+      }
 
       std::vector<StateVarsType> anc_states;
       for (auto& anc: ancestors)
       {
         anc_states.emplace_back(anc->GetStateVars());
       }
-      traj = action_ptr->optimize(anc_states, successor_state_ptr->GetStateVars(), thread_id);
-
-      lock_.lock();
 
-      if (!traj.isValid())
+      // Once the plan is cancelled the solve is skipped and only the bookkeeping runs
+      TrajType traj;
+      if (!cancel_token_.IsCancelled())
       {
-        return;
+        if (warm_start_ && parent_traj && parent_traj->IsValid())
+        {
+          traj = action_ptr->optimize(parent_traj->Expand(), anc_states, successor_state_ptr->GetStateVars(), thread_id);
+        }
+        else
+        {
+          traj = action_ptr->optimize(anc_states, successor_state_ptr->GetStateVars(), thread_id);
+        }
       }
 
-      cost = action_ptr->getCost(traj);
-      double new_g_val = cost;
-      inc_cost = insat_edge_ptr->lowD_parent_state_ptr_->GetIncomingInsatEdgePtr()?
-                 action_ptr->getCost(traj) - action_ptr->getCost(insat_edge_ptr->lowD_parent_state_ptr_->GetIncomingInsatEdgePtr()->GetTraj()):
-                 action_ptr->getCost(traj);
-
-      if (successor_state_ptr->GetGValue() > new_g_val)
+      if (traj.isValid())
       {
-        best_anc = ancestors[0];
+        double cost = action_ptr->getCost(traj);
+        double new_g_val = cost;
+        double inc_cost = parent_traj? cost - parent_traj->Cost() : cost;
 
-        double h_val = successor_state_ptr->GetHValue();
-        if (h_val == -1)
+        auto state_locker = acquire(stateLock(successor_state_ptr), thread_id);
+        if (!successor_state_ptr->IsVisited() && successor_state_ptr->GetGValue() > new_g_val)
         {
-          h_val = computeHeuristic(successor_state_ptr);
-          successor_state_ptr->SetHValue(h_val);
-        }
-
-        if (h_val != DINF)
-        {
-          h_val_min_ = h_val < h_val_min_ ? h_val : h_val_min_;
-          successor_state_ptr->SetGValue(new_g_val); //
-          successor_state_ptr->SetFValue(new_g_val + heuristic_w_*h_val); //
-          successor_state_ptr->SetIncomingInsatEdgePtr(insat_edge_ptr);
-
-          auto edge_ptr = new Edge(insat_edge_ptr->lowD_parent_state_ptr_, action_ptr, successor_state_ptr);
-          edge_ptr->SetCost(inc_cost);
-          successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
-
-          insat_edge_ptr->SetTraj(traj);
-          insat_edge_ptr->SetTrajCost(cost);
-          insat_edge_ptr->SetCost(cost);
-          if (isGoalState(successor_state_ptr))
+          double h_val = successor_state_ptr->GetHValue();
+          if (h_val == -1)
           {
-            insat_edge_ptr->SetTrajCost(0);
-            insat_edge_ptr->SetCost(0);
-            successor_state_ptr->SetFValue(0.0);
+            h_val = computeHeuristic(successor_state_ptr);
+            successor_state_ptr->SetHValue(h_val);
           }
 
-          insat_edge_ptr->fullD_parent_state_ptr_ = best_anc;
-          // Insert poxy edge
-          auto edge_temp = Edge(successor_state_ptr, dummy_action_ptr_);
-          auto edge_key = getEdgeKey(&edge_temp);
-          auto it_edge = edge_map_.find(edge_key);
-          InsatEdgePtrType proxy_edge_ptr;
-
-          if (it_edge == edge_map_.end())
-          {
-            proxy_edge_ptr = new InsatEdge(successor_state_ptr, dummy_action_ptr_);
-            edge_map_.insert(std::make_pair(edge_key, proxy_edge_ptr));
-          }
-          else
+          if (h_val != DINF)
           {
-            proxy_edge_ptr = dynamic_cast<InsatEdgePtrType>(it_edge->second);
-          }
+            successor_state_ptr->SetGValue(new_g_val); //
+            successor_state_ptr->SetFValue(new_g_val + heuristic_w_*h_val); //
+            successor_state_ptr->SetIncomingInsatEdgePtr(insat_edge_ptr);
+
+            auto edge_ptr = new Edge(parent_state_ptr, action_ptr, successor_state_ptr);
+            edge_ptr->SetCost(inc_cost);
+            successor_state_ptr->SetIncomingEdgePtr(edge_ptr);
+
+            insat_edge_ptr->SetTraj(traj, cost, parent_traj);
+            insat_edge_ptr->SetTrajCost(cost);
+            insat_edge_ptr->SetCost(cost);
+            if (isGoalState(successor_state_ptr))
+            {
+              insat_edge_ptr->SetTrajCost(0);
+              insat_edge_ptr->SetCost(0);
+              successor_state_ptr->SetFValue(0.0);
+            }
 
-          proxy_edge_ptr->expansion_priority_ = new_g_val + heuristic_w_*h_val;
+            insat_edge_ptr->fullD_parent_state_ptr_ = ancestors[0];
 
-          if (edge_open_list_.contains(proxy_edge_ptr))
-          {
-            edge_open_list_.decrease(proxy_edge_ptr);
-          }
-          else
-          {
-            edge_open_list_.push(proxy_edge_ptr);
-          }
+            // Insert poxy edge
+            auto edge_temp = Edge(successor_state_ptr, dummy_action_ptr_);
+            auto edge_key = getEdgeKey(&edge_temp);
+            auto proxy_edge_ptr = dynamic_cast<InsatEdgePtrType>(concurrent_edge_map_.FindOrInsert(edge_key,
+                [&](){return new InsatEdge(successor_state_ptr, dummy_action_ptr_);}));
 
-          notifyMainThread();
+            // The state lock is still held, so concurrent improvements reach the open list in order
+            // and the main thread can not close the state in between
+            auto open_locker = acquire(lock_, thread_id);
+            h_val_min_ = h_val < h_val_min_ ? h_val : h_val_min_;
+            proxy_edge_ptr->expansion_priority_ = new_g_val + heuristic_w_*h_val;
+
+            if (edge_open_list_.contains(proxy_edge_ptr))
+            {
+              edge_open_list_.decrease(proxy_edge_ptr);
+            }
+            else
+            {
+              edge_open_list_.push(proxy_edge_ptr);
+            }
+
+            notifyMainThread();
+          }
         }
       }
     }
@@ -464,35 +439,74 @@ void pINSATxGCS::expandEdge(InsatEdgePtrType insat_edge_ptr, int thread_id)
     if (VERBOSE) insat_edge_ptr->Print("No successors for");
   }
 
-  insat_edge_ptr->lowD_parent_state_ptr_->num_expanded_successors_ += 1;
+  finishSuccessor(parent_state_ptr, thread_id);
+}
+
+void pINSATxGCS::finishSuccessor(InsatStatePtrType state_ptr, int thread_id)
+{
+  int num_expanded_successors = ++state_ptr->num_expanded_successors_;
+
+  if (num_expanded_successors > state_ptr->num_successors_)
+  {
+    state_ptr->Print();
+    throw runtime_error("Number of expanded edges cannot be greater than number of successors");
+  }
 
+  if (num_expanded_successors == state_ptr->num_successors_)
+  {
+    releaseBeingExpanded(state_ptr, thread_id);
+  }
 }
 
-void pINSATxGCS::exit()
+void pINSATxGCS::releaseBeingExpanded(InsatStatePtrType state_ptr, int thread_id)
 {
-  for (int thread_id = 0; thread_id < num_threads_-1; ++thread_id)
+  auto open_locker = acquire(lock_, thread_id);
+  state_ptr->UnsetBeingExpanded();
+  if (being_expanded_states_.contains(state_ptr))
   {
-    unique_lock<mutex> locker(lock_vec_[thread_id]);
-    edge_expansion_status_[thread_id] = 1;
-    locker.unlock();
-    cv_vec_[thread_id].notify_one();
+    being_expanded_states_.erase(state_ptr);
+    notifyMainThread();
   }
+}
 
-  planner_stats_.num_threads_spawned_ = edge_expansion_futures_.size()+1;
-  bool all_expansion_threads_terminated = false;
-  while (!all_expansion_threads_terminated)
+unique_lock<LockType> pINSATxGCS::acquire(LockType& lock, int thread_id)
+{
+  auto t_lock_s = chrono::steady_clock::now();
+  unique_lock<LockType> locker(lock);
+  auto t_lock_e = chrono::steady_clock::now();
+  thread_stats_[thread_id].lock_time_ += 1e-9*chrono::duration_cast<chrono::nanoseconds>(t_lock_e-t_lock_s).count();
+  return locker;
+}
+
+LockType& pINSATxGCS::stateLock(const InsatStatePtrType& state_ptr)
+{
+  return state_locks_[state_ptr->GetStateID() % state_locks_.size()];
+}
+
+void pINSATxGCS::exit()
+{
+  // Let the in-flight expansions finish before the states are released. Cancelling first
+  // makes the queued ones skip their solves.
+  planner_stats_.num_threads_spawned_ = 1;
+  if (pool_)
   {
-    all_expansion_threads_terminated = true;
-    for (auto& fut : edge_expansion_futures_)
+    cancel_token_.Cancel();
+    pool_->WaitAll();
+    planner_stats_.num_threads_spawned_ += pool_->NumWorkersStarted();
+    recordWorkerPlacement(*pool_);
+    pool_->UnpinCallingThread();
+    if (!planner_params_["persistent_pool"])
     {
-      if (!isFutureReady(fut))
-      {
-        all_expansion_threads_terminated = false;
-        break;
-      }
+      pool_.reset();
     }
   }
-  edge_expansion_futures_.clear();
+
+  for (auto& thread_stats : thread_stats_)
+  {
+    planner_stats_.lock_time_ += thread_stats.lock_time_;
+    planner_stats_.cumulative_expansions_time_ += thread_stats.expansions_time_;
+    planner_stats_.num_evaluated_edges_ += thread_stats.num_evaluated_edges_;
+  }
 
   // Clear open list
   while (!edge_open_list_.empty())
@@ -503,27 +517,13 @@ void pINSATxGCS::exit()
   // Clear BE
   being_expanded_states_.clear();
 
-  for (auto& state_it : insat_state_map_)
-  {
-    if (state_it.second)
-    {
-      delete state_it.second;
-      state_it.second = NULL;
-    }
-  }
-  insat_state_map_.clear();
+  insat_state_store_.Reset();
 
   // Planner::exit();
-  for (auto& edge_it : edge_map_)
-  {
-    if (edge_it.second)
-    {
-      delete edge_it.second;
-      edge_it.second = NULL;
-    }
-  }
-  edge_map_.clear();
+  concurrent_edge_map_.ForEach([](size_t key, EdgePtrType edge_ptr){delete edge_ptr;});
+  concurrent_edge_map_.Clear();
 
   State::ResetStateIDCounter();
   Edge::ResetStateIDCounter();
+  cancel_token_.Reset();
 }
@@ -0,0 +1,79 @@
+#include <planners/insat/opt/ChainSocpSolver.hpp>
+
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+namespace
+{
+  /// Shortest path from (0, 0) to (3, 4) through a middle point with y <= y_max. The vertices
+  /// are x0 (cols 0-1), x1 and t1 (cols 2-4) and x2 and t2 (cols 5-7), and t_i >= |x_i - x_{i-1}|.
+  ConicProblem polylineProblem(double y_max)
+  {
+    ConicProblem prob;
+    prob.num_vars_ = 8;
+    prob.col_offsets_ = {0, 2, 5};
+    prob.c_.assign(prob.num_vars_, 0);
+    prob.c_[4] = 1;
+    prob.c_[7] = 1;
+
+    prob.eq_.AddRow({0}, {1}, 0);
+    prob.eq_.AddRow({1}, {1}, 0);
+    prob.eq_.AddRow({5}, {1}, 3);
+    prob.eq_.AddRow({6}, {1}, 4);
+
+    prob.ineq_.AddRow({3}, {1}, y_max);
+
+    /// s = (t, x_i - x_{i-1}) = -G x with h = 0
+    prob.soc_dims_ = {3, 3};
+    for (const int c : {2, 5})
+    {
+      const int prev = (c == 2)? 0 : 2;
+      prob.soc_.AddRow({c+2}, {-1}, 0);
+      prob.soc_.AddRow({prev, c}, {1, -1}, 0);
+      prob.soc_.AddRow({prev+1, c+1}, {1, -1}, 0);
+    }
+    return prob;
+  }
+}
+
+TEST(ChainSocpSolver, SolvesPolyline)
+{
+  /// The middle point is pushed below the line, so the optimum reflects the start across
+  /// y = y_max. The point converges slower than the cost.
+  ChainSocpSolver solver;
+  ASSERT_EQ(solver.Solve(polylineProblem(-1)), ChainSocpSolver::Status::kSolved);
+  EXPECT_NEAR(solver.GetCost(), std::sqrt(45.0), 1e-6);
+  EXPECT_NEAR(solver.GetX()(2), 0.5, 1e-3);
+  EXPECT_NEAR(solver.GetX()(3), -1, 1e-3);
+
+  /// Workspaces are reused by the next solve
+  ASSERT_EQ(solver.Solve(polylineProblem(-2)), ChainSocpSolver::Status::kSolved);
+  EXPECT_NEAR(solver.GetCost(), std::sqrt(73.0), 1e-6);
+  EXPECT_NEAR(solver.GetX()(2), 0.75, 1e-3);
+  EXPECT_NEAR(solver.GetX()(5), 3, 1e-3);
+  EXPECT_NEAR(solver.GetX()(6), 4, 1e-3);
+}
+
+TEST(ChainSocpSolver, RejectsRowsSkippingAVertex)
+{
+  auto prob = polylineProblem(-1);
+  /// x0 + x2 = 3 couples the first and the last vertex
+  prob.eq_.AddRow({0, 5}, {1, 1}, 3);
+
+  ChainSocpSolver solver;
+  EXPECT_EQ(solver.Solve(prob), ChainSocpSolver::Status::kUnsupported);
+}
+
+TEST(ChainSocpSolver, ReportsSingularStart)
+{
+  auto prob = polylineProblem(-1);
+  /// Without regularization an equality row stated twice makes the KKT system singular
+  prob.eq_.AddRow({0}, {1}, 0);
+
+  ChainSocpSolver solver;
+  solver.GetSettings().reg_ = 0;
+  EXPECT_EQ(solver.Solve(prob), ChainSocpSolver::Status::kNumericalError);
+  EXPECT_EQ(solver.GetIterations(), 0);
+}
@@ -0,0 +1,91 @@
+#include <common/insat/CompactGCSTraj.hpp>
+
+#include <drake/common/trajectories/bezier_curve.h>
+#include <gtest/gtest.h>
+
+using namespace ps;
+using drake::trajectories::BezierCurve;
+using drake::trajectories::Trajectory;
+
+namespace
+{
+  /// Solved trajectory of consecutive Bezier segments, each lasting one second
+  GCSTraj bezierTraj(const std::vector<MatDf>& control_points)
+  {
+    std::vector<drake::copyable_unique_ptr<Trajectory<double>>> segments;
+    for (size_t i = 0; i < control_points.size(); ++i)
+    {
+      segments.emplace_back(std::make_unique<BezierCurve<double>>(i, i+1, control_points[i]));
+    }
+    drake::solvers::MathematicalProgramResult result;
+    result.set_solution_result(drake::solvers::SolutionResult::kSolutionFound);
+    result.set_optimal_cost(2);
+    return GCSTraj(GCSTraj::TrajInstanceType(segments), result);
+  }
+
+  /// Segment of the diagonal from (x0, x0) to (x1, x1)
+  MatDf line(double x0, double x1)
+  {
+    MatDf cp(2, 2);
+    cp << x0, x1,
+          x0, x1;
+    return cp;
+  }
+}
+
+TEST(CompactGCSTraj, SharesLeadingSegmentsWithThePrefix)
+{
+  const auto parent = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 2)}), 3);
+  EXPECT_EQ(parent->NumSegments(), 2);
+  EXPECT_EQ(parent->NumOwnedSegments(), 2);
+
+  const auto child = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 2), line(2, 4)}), 5, parent);
+  EXPECT_EQ(child->NumSegments(), 3);
+  EXPECT_EQ(child->NumOwnedSegments(), 1);
+  EXPECT_EQ(child->Cost(), 5);
+  EXPECT_TRUE(child->IsValid());
+  for (int i = 0; i < 2; ++i)
+  {
+    EXPECT_EQ(child->ControlPoints(i).data(), parent->ControlPoints(i).data());
+    EXPECT_EQ(child->Duration(i), 1);
+  }
+  EXPECT_EQ(child->ControlPoints(2), line(2, 4));
+
+  /// A differing segment ends the shared part
+  const auto sibling = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 3)}), 4, parent);
+  EXPECT_EQ(sibling->NumOwnedSegments(), 1);
+  EXPECT_NE(sibling->ControlPoints(1).data(), parent->ControlPoints(1).data());
+}
+
+TEST(CompactGCSTraj, SharesAcrossGenerations)
+{
+  const auto root = CompactGCSTraj::Compress(bezierTraj({line(0, 1)}), 1);
+  const auto child = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 2)}), 2, root);
+  const auto grandchild = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 2), line(2, 3)}), 3, child);
+  EXPECT_EQ(grandchild->NumOwnedSegments(), 1);
+  EXPECT_EQ(grandchild->ControlPoints(0).data(), root->ControlPoints(0).data());
+  EXPECT_EQ(grandchild->ControlPoints(1).data(), child->ControlPoints(1).data());
+
+  /// Only the root's segment is kept when the child's one changed
+  const auto other = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 3), line(3, 4)}), 4, child);
+  EXPECT_EQ(other->NumOwnedSegments(), 2);
+  EXPECT_EQ(other->ControlPoints(0).data(), root->ControlPoints(0).data());
+  const auto traj = other->Expand();
+  ASSERT_EQ(traj.traj_.get_number_of_segments(), 3);
+  EXPECT_TRUE(traj.traj_.value(2.5).isApprox(Eigen::Vector2d(3.5, 3.5)));
+}
+
+TEST(CompactGCSTraj, OutlivesThePrefixAndExpands)
+{
+  auto parent = CompactGCSTraj::Compress(bezierTraj({line(0, 1)}), 1);
+  const auto child = CompactGCSTraj::Compress(bezierTraj({line(0, 1), line(1, 2)}), 2, parent);
+  parent.reset();
+
+  const auto traj = child->Expand();
+  EXPECT_TRUE(traj.isValid());
+  EXPECT_EQ(traj.result_.get_optimal_cost(), 2);
+  ASSERT_EQ(traj.traj_.get_number_of_segments(), 2);
+  EXPECT_EQ(traj.traj_.end_time(), 2);
+  EXPECT_TRUE(traj.traj_.value(1.5).isApprox(Eigen::Vector2d(1.5, 1.5)));
+  EXPECT_EQ(traj.disc_traj_.size(), 0);
+}
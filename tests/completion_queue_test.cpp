@@ -0,0 +1,54 @@
+#include <common/CompletionQueue.hpp>
+#include <common/WorkStealingPool.hpp>
+
+#include <stdexcept>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+TEST(CompletionQueue, DrainsPoolResultsByTag)
+{
+  const size_t num_requests = 64;
+  WorkStealingPool pool(4);
+  CompletionQueue<size_t> queue;
+  for (size_t tag = 0; tag < num_requests; ++tag)
+  {
+    queue.Expect();
+    pool.Submit([&queue, tag](int){ queue.Push(tag, tag*tag); });
+  }
+
+  std::vector<int> num_seen(num_requests, 0);
+  CompletionQueue<size_t>::Completion completion;
+  while (queue.Next(completion))
+  {
+    ASSERT_LT(completion.tag_, num_requests);
+    EXPECT_EQ(completion.Get(), completion.tag_*completion.tag_);
+    ++num_seen[completion.tag_];
+  }
+  for (size_t tag = 0; tag < num_requests; ++tag)
+  {
+    EXPECT_EQ(num_seen[tag], 1);
+  }
+  EXPECT_EQ(queue.NumOutstanding(), 0);
+  pool.WaitAll();
+}
+
+TEST(CompletionQueue, GetRethrowsErrors)
+{
+  CompletionQueue<int> queue;
+  queue.Expect();
+  queue.Expect();
+  queue.PushError(1, std::make_exception_ptr(std::runtime_error("failed")));
+  queue.Push(2, 7);
+
+  CompletionQueue<int>::Completion completion;
+  ASSERT_TRUE(queue.TryNext(completion));
+  EXPECT_EQ(completion.tag_, 1u);
+  EXPECT_THROW(completion.Get(), std::runtime_error);
+  ASSERT_TRUE(queue.Next(completion));
+  EXPECT_EQ(completion.Get(), 7);
+
+  /// Nothing outstanding, so Next does not block
+  EXPECT_FALSE(queue.Next(completion));
+  EXPECT_FALSE(queue.TryNext(completion));
+}
@@ -0,0 +1,98 @@
+#include <common/ConcurrentHashMap.hpp>
+
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+TEST(ConcurrentHashMap, FindsInsertedValues)
+{
+  ConcurrentHashMap<int> map(2, 4);
+  std::vector<int> values(100);
+  for (size_t k = 0; k < values.size(); ++k)
+  {
+    EXPECT_EQ(map.Insert(k, &values[k]), &values[k]);
+  }
+  EXPECT_EQ(map.Size(), values.size());
+  for (size_t k = 0; k < values.size(); ++k)
+  {
+    EXPECT_EQ(map.Find(k), &values[k]);
+  }
+  EXPECT_EQ(map.Find(values.size()), nullptr);
+
+  /// A present key keeps its value and make is not called
+  int other = 0;
+  EXPECT_EQ(map.Insert(3, &other), &values[3]);
+  EXPECT_EQ(map.FindOrInsert(3, []() -> int* { ADD_FAILURE(); return nullptr; }), &values[3]);
+}
+
+TEST(ConcurrentHashMap, ClearAdvancesEpoch)
+{
+  ConcurrentHashMap<int> map(1, 2);
+  std::vector<int> first(50), second(50);
+  for (size_t k = 0; k < first.size(); ++k)
+  {
+    map.Insert(k, &first[k]);
+  }
+
+  map.Clear();
+  EXPECT_TRUE(map.Empty());
+  for (size_t k = 0; k < first.size(); ++k)
+  {
+    EXPECT_EQ(map.Find(k), nullptr);
+  }
+  size_t num_visited = 0;
+  map.ForEach([&](size_t, int*){ ++num_visited; });
+  EXPECT_EQ(num_visited, 0u);
+
+  /// Slots stamped with the old epoch are reused, only half of the keys come back
+  for (size_t k = 0; k < second.size(); k += 2)
+  {
+    EXPECT_EQ(map.Insert(k, &second[k]), &second[k]);
+  }
+  EXPECT_EQ(map.Size(), second.size()/2);
+  for (size_t k = 0; k < second.size(); ++k)
+  {
+    EXPECT_EQ(map.Find(k), (k % 2 == 0)? &second[k] : nullptr);
+  }
+  map.ForEach([&](size_t key, int* value){ EXPECT_EQ(value, &second[key]); });
+}
+
+TEST(ConcurrentHashMap, ConcurrentInsertsCreateEachKeyOnce)
+{
+  const int num_threads = 8;
+  const size_t num_keys = 4096;
+  ConcurrentHashMap<size_t> map(2, 2);
+  std::vector<size_t> values(num_keys);
+  std::vector<std::atomic<int>> num_made(num_keys);
+  for (int round = 0; round < 3; ++round)
+  {
+    for (auto& n : num_made)
+    {
+      n = 0;
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+      threads.emplace_back([&, t]()
+      {
+        for (size_t i = 0; i < num_keys; ++i)
+        {
+          const size_t k = (i*(t+1)) % num_keys;
+          size_t* value = map.FindOrInsert(k, [&](){ num_made[k]++; return &values[k]; });
+          EXPECT_EQ(value, &values[k]);
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    for (size_t k = 0; k < num_keys; ++k)
+    {
+      EXPECT_EQ(num_made[k], 1);
+    }
+    EXPECT_EQ(map.Size(), num_keys);
+    map.Clear();
+  }
+}
@@ -0,0 +1,88 @@
+#include <common/insat/InsatStateStore.hpp>
+
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+TEST(InsatStateStore, DenseAndOverflowIdsFindTheSameState)
+{
+  InsatStateStore store;
+  store.SetDenseRange(100, 10);
+
+  auto dense = store.GetOrCreate(105, {105});
+  auto below = store.GetOrCreate(3, {3});
+  auto above = store.GetOrCreate(110, {110});
+  EXPECT_EQ(store.GetOrCreate(105, {0}), dense);
+  EXPECT_EQ(store.GetOrCreate(3, {0}), below);
+  EXPECT_EQ(store.GetOrCreate(110, {0}), above);
+  EXPECT_EQ(dense->GetStateVars()[0], 105);
+  EXPECT_EQ(above->GetStateVars()[0], 110);
+
+  /// Hashed keys live apart from ids
+  auto hashed = store.GetOrCreateHashed(105, {7});
+  EXPECT_NE(hashed, dense);
+  EXPECT_EQ(store.Size(), 4u);
+}
+
+TEST(InsatStateStore, ResetRecyclesStates)
+{
+  InsatStateStore store;
+  store.SetDenseRange(0, 4);
+  auto first = store.GetOrCreate(2, {2});
+  auto sparse = store.GetOrCreate(9, {9});
+  first->SetGValue(1.0);
+  first->SetVisited();
+
+  store.Reset();
+  EXPECT_EQ(store.Size(), 0u);
+
+  /// The storage of the first state comes back reset, for whatever id asks first
+  auto second = store.GetOrCreate(1, {1});
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second->GetStateVars()[0], 1);
+  EXPECT_FALSE(second->IsVisited());
+  EXPECT_EQ(second->GetGValue(), DINF);
+
+  auto again = store.GetOrCreate(2, {2});
+  EXPECT_NE(again, second);
+  EXPECT_EQ(again, sparse);
+  EXPECT_EQ(again->GetStateVars()[0], 2);
+  EXPECT_EQ(store.Size(), 2u);
+}
+
+TEST(InsatStateStore, ConcurrentCreationMakesOneStatePerId)
+{
+  const int num_threads = 8;
+  const size_t num_ids = 512;
+  InsatStateStore store;
+  store.SetDenseRange(0, num_ids/2);
+
+  std::vector<std::vector<InsatStatePtrType>> seen(num_threads, std::vector<InsatStatePtrType>(num_ids));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      for (size_t i = 0; i < num_ids; ++i)
+      {
+        const size_t id = (i + 37*t) % num_ids;
+        seen[t][id] = store.GetOrCreate(id, {static_cast<double>(id)});
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(store.Size(), num_ids);
+  for (size_t id = 0; id < num_ids; ++id)
+  {
+    EXPECT_EQ(seen[0][id]->GetStateVars()[0], id);
+    for (int t = 1; t < num_threads; ++t)
+    {
+      EXPECT_EQ(seen[t][id], seen[0][id]);
+    }
+  }
+}
@@ -0,0 +1,146 @@
+#include <planners/insat/opt/LBGraphFile.hpp>
+
+#include <cstdio>
+#include <limits>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+namespace
+{
+  /// Two GCS vertices with a line of three LB nodes, in 2D
+  LBGraphCSR makeGraph()
+  {
+    LBGraphCSR csr;
+    csr.state_dim_ = 2;
+    csr.adj_offsets_ = {0, 1, 3, 4};
+    csr.adj_ids_ = {1, 0, 2, 1};
+    csr.adj_costs_ = {1.0, 1.0, 2.0, 2.0};
+    csr.states_ = {0, 0, 1, 0, 3, 0};
+    csr.old_edges_ = {0, 1, 1, 0};
+    csr.old_edge_offsets_ = {0, 1, 2};
+    csr.old_edge_ids_ = {1, 1};
+    csr.old_ids_ = {0, 1};
+    csr.old_id_offsets_ = {0, 2, 3};
+    csr.old_id_ids_ = {0, 1, 2};
+    return csr;
+  }
+
+  LBGFileHeader header(const std::vector<char>& buffer)
+  {
+    LBGFileHeader h;
+    std::memcpy(&h, buffer.data(), sizeof(h));
+    return h;
+  }
+
+  template <typename T>
+  void patch(std::vector<char>& buffer, int section, size_t i, T value)
+  {
+    std::memcpy(buffer.data() + header(buffer).section_offsets_[section] + i*sizeof(T), &value, sizeof(T));
+  }
+
+  void patchHeader(std::vector<char>& buffer, const LBGFileHeader& h)
+  {
+    std::memcpy(buffer.data(), &h, sizeof(h));
+  }
+}
+
+TEST(LBGraphView, ReadsEncodedGraph)
+{
+  LBGraphView view;
+  ASSERT_TRUE(view.Adopt(makeGraph().Encode()));
+  EXPECT_EQ(view.NumNodes(), 3u);
+  EXPECT_EQ(view.NumEdges(), 4u);
+  EXPECT_EQ(view.StateDim(), 2);
+  EXPECT_EQ(view.AdjBegin(1), 1u);
+  EXPECT_EQ(view.AdjEnd(1), 3u);
+  EXPECT_EQ(view.AdjIds()[2], 2);
+  EXPECT_DOUBLE_EQ(view.State(2)[0], 3.0);
+  EXPECT_EQ(view.OldEdgesFrom(1), std::make_pair(size_t(1), size_t(2)));
+  EXPECT_EQ(view.OldIdEnd(1), 3u);
+}
+
+TEST(LBGraphView, RejectsTruncatedBuffer)
+{
+  auto buffer = makeGraph().Encode();
+  buffer.resize(buffer.size()-4);
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(buffer));
+  EXPECT_FALSE(view.IsOpen());
+}
+
+TEST(LBGraphView, RejectsBadMagic)
+{
+  auto buffer = makeGraph().Encode();
+  buffer[0] = 'X';
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(buffer));
+}
+
+TEST(LBGraphView, RejectsDecreasingAdjOffsets)
+{
+  /// The last offset still matches the edge count
+  auto buffer = makeGraph().Encode();
+  patch<uint64_t>(buffer, 0, 1, 4);
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(buffer));
+}
+
+TEST(LBGraphView, RejectsNonZeroFirstOffset)
+{
+  auto buffer = makeGraph().Encode();
+  patch<uint64_t>(buffer, 8, 0, 1);
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(buffer));
+}
+
+TEST(LBGraphView, RejectsOutOfRangeNodeIds)
+{
+  auto adj = makeGraph().Encode();
+  patch<int32_t>(adj, 1, 0, 3);
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(adj));
+
+  auto old_ids = makeGraph().Encode();
+  patch<int32_t>(old_ids, 9, 2, -1);
+  EXPECT_FALSE(view.Adopt(old_ids));
+}
+
+TEST(LBGraphView, RejectsOverflowingStateCount)
+{
+  /// num_nodes*state_dim wraps around to a small number of bytes
+  auto buffer = makeGraph().Encode();
+  auto h = header(buffer);
+  h.state_dim_ = 1u << 31;
+  h.num_nodes_ = uint64_t(1) << 33;
+  patchHeader(buffer, h);
+  LBGraphView view;
+  EXPECT_FALSE(view.Adopt(buffer));
+
+  h = header(makeGraph().Encode());
+  h.num_nodes_ = std::numeric_limits<uint64_t>::max();
+  buffer = makeGraph().Encode();
+  patchHeader(buffer, h);
+  EXPECT_FALSE(view.Adopt(buffer));
+}
+
+TEST(LBGraphView, OpensWrittenFileAndRejectsCorruptOne)
+{
+  const std::string fname = ::testing::TempDir() + "lbg_file_test.lbg";
+  ASSERT_TRUE(makeGraph().Write(fname));
+  ASSERT_TRUE(LBGraphView::IsLBGFile(fname));
+  LBGraphView view;
+  ASSERT_TRUE(view.Open(fname));
+  EXPECT_EQ(view.NumNodes(), 3u);
+
+  auto buffer = makeGraph().Encode();
+  patch<uint64_t>(buffer, 5, 1, 5);
+  {
+    std::ofstream out_file(fname, std::ios::binary | std::ios::trunc);
+    out_file.write(buffer.data(), buffer.size());
+  }
+  EXPECT_FALSE(view.Open(fname));
+  std::remove(fname.c_str());
+
+  EXPECT_FALSE(view.Open(fname));
+}
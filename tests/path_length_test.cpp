@@ -0,0 +1,66 @@
+#include <planners/insat/opt/GCSOpt.hpp>
+
+#include <cmath>
+#include <drake/common/trajectories/bezier_curve.h>
+#include <gtest/gtest.h>
+
+using namespace ps;
+using drake::trajectories::BezierCurve;
+using drake::trajectories::CompositeTrajectory;
+using drake::trajectories::Trajectory;
+
+namespace
+{
+  /// Consecutive Bezier segments of the given duration
+  CompositeTrajectory<double> composite(const std::vector<Eigen::MatrixXd>& control_points, double duration)
+  {
+    std::vector<drake::copyable_unique_ptr<Trajectory<double>>> segments;
+    double t = 0;
+    for (const auto& cp : control_points)
+    {
+      segments.emplace_back(std::make_unique<BezierCurve<double>>(t, t+duration, cp));
+      t += duration;
+    }
+    return CompositeTrajectory<double>(segments);
+  }
+
+  double sampledLength(const CompositeTrajectory<double>& traj, int num_samples)
+  {
+    double length = 0;
+    const double dt = (traj.end_time() - traj.start_time())/num_samples;
+    for (int i = 0; i < num_samples; ++i)
+    {
+      length += (traj.value(traj.start_time() + (i+1)*dt) - traj.value(traj.start_time() + i*dt)).norm();
+    }
+    return length;
+  }
+}
+
+TEST(PathLength, OrderOneIsExact)
+{
+  Eigen::MatrixXd first(2, 2), second(2, 2);
+  first << 0, 3,
+           0, 4;
+  second << 3, 3,
+            4, 6;
+  EXPECT_DOUBLE_EQ(GCSOpt::PathLength(composite({first, second}, 0.5)), 7);
+  EXPECT_EQ(GCSOpt::PathLength(composite({}, 1)), 0);
+}
+
+TEST(PathLength, CurvedSegmentsMatchTheirLength)
+{
+  /// The quadratic turns sharply, its length is sqrt(5) + asinh(2)/2. The quadrature is accurate
+  /// to about 1e-5 there. The length does not depend on the durations.
+  Eigen::MatrixXd quadratic(2, 3), cubic(3, 4);
+  quadratic << 0, 1, 2,
+               0, 2, 0;
+  cubic << 0, 1, 2, 3,
+           0, 1, -1, 0,
+           0, 0.5, 0.5, 1;
+  for (const double duration : {0.3, 2.0})
+  {
+    EXPECT_NEAR(GCSOpt::PathLength(composite({quadratic}, duration)), std::sqrt(5.0) + std::asinh(2.0)/2, 1e-4);
+    const auto cubic_traj = composite({cubic, cubic}, duration);
+    EXPECT_NEAR(GCSOpt::PathLength(cubic_traj), sampledLength(cubic_traj, 100000), 1e-4);
+  }
+}
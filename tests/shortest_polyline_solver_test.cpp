@@ -0,0 +1,96 @@
+#include <planners/insat/opt/ShortestPolylineSolver.hpp>
+
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace ps;
+
+namespace
+{
+  /// {p : lo <= p <= hi} as A p <= b
+  struct Box
+  {
+    Box(const Eigen::Vector2d& lo, const Eigen::Vector2d& hi) : A_(4, 2), b_(4)
+    {
+      A_ << Eigen::Matrix2d::Identity(), -Eigen::Matrix2d::Identity();
+      b_ << hi, -lo;
+    }
+
+    Eigen::MatrixXd A_;
+    Eigen::VectorXd b_;
+  };
+}
+
+TEST(ShortestPolylineSolver, StraightLineInClosedForm)
+{
+  const Eigen::VectorXd start = Eigen::Vector2d(0, 0), goal = Eigen::Vector2d(3, 4);
+  const Box first({-1, -1}, {2, 3}), second({1, 1}, {4, 5});
+
+  ShortestPolylineSolver solver;
+  solver.Reset(2);
+  solver.AddPoint(start);
+  solver.AddPolytope(first.A_, first.b_);
+  solver.AddPolytope(second.A_, second.b_);
+  solver.AddPoint(goal);
+  ASSERT_EQ(solver.Solve(2), ShortestPolylineSolver::Status::kSolved);
+  EXPECT_TRUE(solver.SolvedInClosedForm());
+  EXPECT_NEAR(solver.GetCost(), 10, 1e-9);
+
+  /// The waypoint between the boxes is on the line and in both of them
+  const Eigen::Vector2d q = solver.GetWaypoints().col(2);
+  EXPECT_NEAR(q(0)*4 - q(1)*3, 0, 1e-9);
+  EXPECT_TRUE((q.array() >= 1 - 1e-9).all() && (q.array() <= 2 + 1e-9).all());
+}
+
+TEST(ShortestPolylineSolver, BendsAroundPolytopes)
+{
+  /// The line from start to goal leaves the boxes, the path turns at their shared corner (2, 2)
+  const Eigen::VectorXd start = Eigen::Vector2d(0, 0), goal = Eigen::Vector2d(4, 0);
+  const Box first({-1, -1}, {2, 3}), second({2, 2}, {5, 3}), third({1, -1}, {5, 3});
+
+  ShortestPolylineSolver solver;
+  solver.Reset(2);
+  solver.AddPoint(start);
+  solver.AddPolytope(first.A_, first.b_);
+  solver.AddPolytope(second.A_, second.b_);
+  solver.AddPolytope(third.A_, third.b_);
+  solver.AddPoint(goal);
+  ASSERT_EQ(solver.Solve(1), ShortestPolylineSolver::Status::kSolved);
+  EXPECT_FALSE(solver.SolvedInClosedForm());
+  EXPECT_NEAR(solver.GetCost(), 4*std::sqrt(2.0), 1e-6);
+}
+
+TEST(ShortestPolylineSolver, FixedWaypointBehindTheLineIsNotStraight)
+{
+  /// The second box pushes the path to x >= 2 before the fixed waypoint at x = 1 sends it back.
+  /// All waypoints are on the line from start to goal, but the polyline is 2 + 1 + 3 long.
+  const Eigen::VectorXd start = Eigen::Vector2d(0, 0), middle = Eigen::Vector2d(1, 0),
+                        goal = Eigen::Vector2d(4, 0);
+  const Box wide({0, -1}, {4, 1}), ahead({2, -1}, {4, 1});
+
+  ShortestPolylineSolver solver;
+  solver.Reset(2);
+  solver.AddPoint(start);
+  solver.AddPolytope(wide.A_, wide.b_);
+  solver.AddPolytope(ahead.A_, ahead.b_);
+  solver.AddPolytope(wide.A_, wide.b_);
+  solver.AddPoint(middle);
+  solver.AddPolytope(wide.A_, wide.b_);
+  solver.AddPoint(goal);
+  ASSERT_EQ(solver.Solve(1), ShortestPolylineSolver::Status::kSolved);
+  EXPECT_FALSE(solver.SolvedInClosedForm());
+  EXPECT_NEAR(solver.GetCost(), 6, 1e-6);
+}
+
+TEST(ShortestPolylineSolver, RejectsPointsOutsideTheirPolytopes)
+{
+  const Eigen::VectorXd start = Eigen::Vector2d(0, 0), goal = Eigen::Vector2d(9, 9);
+  const Box box({-1, -1}, {2, 2});
+
+  ShortestPolylineSolver solver;
+  solver.Reset(2);
+  solver.AddPoint(start);
+  solver.AddPolytope(box.A_, box.b_);
+  solver.AddPoint(goal);
+  EXPECT_EQ(solver.Solve(1), ShortestPolylineSolver::Status::kInfeasible);
+}